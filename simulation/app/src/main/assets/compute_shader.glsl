@@ -1,21 +1,131 @@
 #version 320 es
-layout(local_size_x = 256) in;
+#ifndef LOCAL_SIZE_X
+#define LOCAL_SIZE_X 256
+#endif
+layout(local_size_x = LOCAL_SIZE_X) in;
 
 // Uniforms for dimensions and time step
 uniform int width;
 uniform int height;
 uniform int depth;
 uniform float global_time_in_step;
+uniform uint active_particles; // only the first slots are simulated, 0 for all
 uniform float one_day_simulation_period;
 uniform float dt;
 uniform float max_width;
 uniform float max_height;
 uniform float max_depth;
+uniform vec3 grid_origin; // grid coordinates of the low corner of the simulated volume (halo of a window)
+uniform vec3 grid_extent; // cells spanned by the simulated volume (the window)
+uniform bool stretched_grid; // some axis of the grid is looked up in its coordinates, see `GridAxis`
+uniform ivec3 axis_nodes; // nodes of every stretched axis
+uniform ivec3 axis_bins; // lookup bins of every axis, 0 for a uniform axis
+uniform ivec3 axis_offset; // offset of every stretched axis in `gridAxes`
+uniform vec3 axis_low; // coordinate of the low side of the simulated volume per stretched axis
+uniform vec3 axis_high; // coordinate of the high side of the simulated volume per stretched axis
+
+// Uniforms for particle recycling
+uniform bool recycle_clamped;
+uniform bool recycle_region;
+uniform vec3 region_min;
+uniform vec3 region_max;
+uniform float max_age; // <= 0 disables reclaiming by age
+uniform bool recycle_absorbed; // reclaim particles leaving through an absorbing boundary
+
+// Boundary of the simulated volume per axis, shared with `DomainBoundary`
+const int BOUNDARY_CLAMP = 0;
+const int BOUNDARY_PERIODIC = 1;
+const int BOUNDARY_REFLECT = 2;
+const int BOUNDARY_ABSORB = 3;
+uniform ivec3 domain_boundary;
+
+// Uniforms for coastline handling
+uniform bool use_land_mask;
+uniform float land_stop; // 1 to stop particles at the coast, 0 to reflect them
+
+// Constants of the particle models, shared with `Physics` (see physics_constants.h)
+layout(std140, binding = 0) uniform PhysicsConstants {
+    float b;    // drag coefficient
+    float m;    // mass of the particle
+    float rho;  // density of the fluid
+    float V;    // volume of the particle
+    float g;    // gravity
+    float C;    // displacement coefficient
+    int model;  // Physics::Model
+    float padding;
+} physics;
+
+const int MODEL_PARTICLES_SIMPLE = 0;
+const int MODEL_PARTICLES = 1;
+const int MODEL_PARTICLES_ADVECTION = 2;
+
+const float PARKED_POSITION = 1.0e6f; // position of free particle slots
 
 layout(std430, binding = 0) buffer Particles {
-    float particles[]; // x, y, z positions of particles
+    vec4 particles[]; // x, y, z positions and age of particles
+};
+
+layout(std430, binding = 9) buffer ParticleState {
+    vec4 particleState[]; // velocity and acceleration of particles (two vec4 per particle, inertial models only)
+};
+
+layout(std430, binding = 5) buffer FreeList {
+    int freeCount;
+    uint freeIndices[]; // indices of free particle slots (stack)
+};
+
+layout(std430, binding = 7) readonly buffer LandMask {
+    vec4 landMask[]; // normalized coastline normal (xyz) and signed distance to land (w) per cell
+};
+
+layout(std430, binding = 11) readonly buffer GridAxes {
+    float gridAxes[]; // coordinates of the nodes of every stretched axis, followed by the node at the start of every bin
 };
 
+// Node index of a position along a stretched axis, like `GridAxis::toIndex`. The bins are no wider than the smallest
+// spacing unless their number is capped, then a bin spans several nodes and the lookup steps over all of them
+float axisIndex(int axis, float t) {
+    int offset = axis_offset[axis];
+    int nodes = axis_nodes[axis];
+    int bins = axis_bins[axis];
+    float coordinate = mix(axis_low[axis], axis_high[axis], t);
+    int node = int(gridAxes[offset + nodes + clamp(int(t * float(bins)), 0, bins - 1)]);
+    while (node < nodes - 2 && coordinate >= gridAxes[offset + node + 1]) node++;
+    float low = gridAxes[offset + node];
+    return float(node) + (coordinate - low) / (gridAxes[offset + node + 1] - low);
+}
+
+// Transform position to grid indices as floating point
+vec3 toGrid(vec3 position) {
+    vec3 t = (position / vec3(max_width, max_height, max_depth) + 1.0f) / 2.0f;
+    vec3 fGrid = grid_origin + t * grid_extent;
+    if (stretched_grid) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (axis_bins[axis] > 0) fGrid[axis] = axisIndex(axis, t[axis]);
+        }
+    }
+    return fGrid;
+}
+
+#ifdef USE_FIELD_TEXTURE
+precision highp sampler3D;
+
+// Velocity of the previous and next time step, one texel per grid cell
+uniform sampler3D field0;
+uniform sampler3D field1;
+
+vec3 getVelocity(vec3 position) {
+    // Texel centers lie at (index + 0.5) / size, the texture units do the trilinear interpolation
+    vec3 size = vec3(width, height, depth);
+    vec3 uvw = (toGrid(position) + 0.5f) / size;
+
+    vec3 v0 = textureLod(field0, uvw, 0.0f).xyz;
+    vec3 v1 = textureLod(field1, uvw, 0.0f).xyz;
+
+    // Linear interpolation based on time step
+    return mix(v0, v1, global_time_in_step / one_day_simulation_period);
+}
+#else
 layout(std430, binding = 1) buffer VectorField0 {
     float vectorData0[]; // vector field data
 };
@@ -24,6 +134,33 @@ layout(std430, binding = 2) buffer VectorField1 {
     float vectorData1[]; // vector field data
 };
 
+#ifdef USE_SPARSE_FIELD
+layout(std430, binding = 10) readonly buffer BrickTable {
+    int brickTable[]; // index of the stored brick for every brick of the grid, -1 for bricks of land only
+};
+
+const int BRICK_SIZE = 8; // cells of a brick along every axis, shared with `VectorFieldHandler::BRICK_SIZE`
+
+// Index of a cell among the cells of the stored bricks, -1 if its brick is land only
+int brickCell(int x, int y, int z) {
+    ivec3 bricks = (ivec3(width, height, depth) + BRICK_SIZE - 1) / BRICK_SIZE;
+    int brick = brickTable[((z / BRICK_SIZE) * bricks.y + y / BRICK_SIZE) * bricks.x + x / BRICK_SIZE];
+    if (brick < 0) return -1;
+    return brick * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE + ((z % BRICK_SIZE) * BRICK_SIZE + y % BRICK_SIZE) * BRICK_SIZE + x % BRICK_SIZE;
+}
+
+// Helper functions to get the velocity vector of a cell, zero in bricks of land only
+vec3 computeVelocity0(int x, int y, int z) {
+    int cell = brickCell(x, y, z);
+    if (cell < 0) return vec3(0.0f);
+    return vec3(vectorData0[cell * 3], vectorData0[cell * 3 + 1], vectorData0[cell * 3 + 2]);
+}
+vec3 computeVelocity1(int x, int y, int z) {
+    int cell = brickCell(x, y, z);
+    if (cell < 0) return vec3(0.0f);
+    return vec3(vectorData1[cell * 3], vectorData1[cell * 3 + 1], vectorData1[cell * 3 + 2]);
+}
+#else
 // Helper functions to calculate velocity vector at a given index
 vec3 computeVelocity0(int x, int y, int z) {
     int idx = z * width * height + y * width + x;
@@ -41,32 +178,33 @@ vec3 computeVelocity1(int x, int y, int z) {
         vectorData1[idx * 6 + 5] - vectorData1[idx * 6 + 2]
     );
 }
+#endif
 
 // Helper functions to interpolate velocity vectors
-vec3 interpolateV0(int baseGridX, int baseGridY, int baseGridZ, float w_x, float w_y, float w_z) {
+vec3 interpolateV0(int baseGridX, int baseGridY, int baseGridZ, int nextGridX, int nextGridY, int nextGridZ, float w_x, float w_y, float w_z) {
     vec3 v0 = mix(
         mix(
             mix(
                 computeVelocity0(baseGridX, baseGridY, baseGridZ),
-                computeVelocity0(baseGridX + 1, baseGridY, baseGridZ),
+                computeVelocity0(nextGridX, baseGridY, baseGridZ),
                 w_x
             ),
             mix(
-                computeVelocity0(baseGridX, baseGridY + 1, baseGridZ),
-                computeVelocity0(baseGridX + 1, baseGridY + 1, baseGridZ),
+                computeVelocity0(baseGridX, nextGridY, baseGridZ),
+                computeVelocity0(nextGridX, nextGridY, baseGridZ),
                 w_x
             ),
             w_y
         ),
         mix(
             mix(
-                computeVelocity0(baseGridX, baseGridY, baseGridZ + 1),
-                computeVelocity0(baseGridX + 1, baseGridY, baseGridZ + 1),
+                computeVelocity0(baseGridX, baseGridY, nextGridZ),
+                computeVelocity0(nextGridX, baseGridY, nextGridZ),
                 w_x
             ),
             mix(
-                computeVelocity0(baseGridX, baseGridY + 1, baseGridZ + 1),
-                computeVelocity0(baseGridX + 1, baseGridY + 1, baseGridZ + 1),
+                computeVelocity0(baseGridX, nextGridY, nextGridZ),
+                computeVelocity0(nextGridX, nextGridY, nextGridZ),
                 w_x
             ),
             w_y
@@ -75,30 +213,30 @@ vec3 interpolateV0(int baseGridX, int baseGridY, int baseGridZ, float w_x, float
     );
     return v0;
 }
-vec3 interpolateV1(int baseGridX, int baseGridY, int baseGridZ, float w_x, float w_y, float w_z) {
+vec3 interpolateV1(int baseGridX, int baseGridY, int baseGridZ, int nextGridX, int nextGridY, int nextGridZ, float w_x, float w_y, float w_z) {
     vec3 v1 = mix(
         mix(
             mix(
                 computeVelocity1(baseGridX, baseGridY, baseGridZ),
-                computeVelocity1(baseGridX + 1, baseGridY, baseGridZ),
+                computeVelocity1(nextGridX, baseGridY, baseGridZ),
                 w_x
             ),
             mix(
-                computeVelocity1(baseGridX, baseGridY + 1, baseGridZ),
-                computeVelocity1(baseGridX + 1, baseGridY + 1, baseGridZ),
+                computeVelocity1(baseGridX, nextGridY, baseGridZ),
+                computeVelocity1(nextGridX, nextGridY, baseGridZ),
                 w_x
             ),
             w_y
         ),
         mix(
             mix(
-                computeVelocity1(baseGridX, baseGridY, baseGridZ + 1),
-                computeVelocity1(baseGridX + 1, baseGridY, baseGridZ + 1),
+                computeVelocity1(baseGridX, baseGridY, nextGridZ),
+                computeVelocity1(nextGridX, baseGridY, nextGridZ),
                 w_x
             ),
             mix(
-                computeVelocity1(baseGridX, baseGridY + 1, baseGridZ + 1),
-                computeVelocity1(baseGridX + 1, baseGridY + 1, baseGridZ + 1),
+                computeVelocity1(baseGridX, nextGridY, nextGridZ),
+                computeVelocity1(nextGridX, nextGridY, nextGridZ),
                 w_x
             ),
             w_y
@@ -111,38 +249,117 @@ vec3 interpolateV1(int baseGridX, int baseGridY, int baseGridZ, float w_x, float
 
 vec3 getVelocity(vec3 position) {
     // Transform position to grid indices as floating point
-    float fGridX = ((position.x / max_width + 1.0f) / 2.0f * float(width));
-    float fGridY = ((position.y / max_height + 1.0f) / 2.0f * float(height));
-    float fGridZ = ((position.z / max_depth + 1.0f) / 2.0f * float(depth));
-
-    // Calculate base indices by casting to int
-    int baseGridX = int(fGridX);
-    int baseGridY = int(fGridY);
-    int baseGridZ = int(fGridZ);
+    vec3 fGrid = toGrid(position);
+    float fGridX = fGrid.x;
+    float fGridY = fGrid.y;
+    float fGridZ = fGrid.z;
 
-    // Ensure base indices are within bounds
-    baseGridX = clamp(baseGridX, 0, width - 2);
-    baseGridY = clamp(baseGridY, 0, height - 2);
-    baseGridZ = clamp(baseGridZ, 0, depth - 2);
+    // Base indices within bounds, the last cell of a periodic axis is interpolated with the first one
+    // (mirrors `VectorFieldHandler::cornerCells`)
+    ivec3 size = ivec3(width, height, depth);
+    ivec3 wrap = ivec3(equal(domain_boundary, ivec3(BOUNDARY_PERIODIC)));
+    ivec3 base = clamp(ivec3(floor(vec3(fGridX, fGridY, fGridZ))), -wrap, size - 2 + wrap);
 
     // Compute interpolation weights
-    float w_x = fGridX - float(baseGridX);
-    float w_y = fGridY - float(baseGridY);
-    float w_z = fGridZ - float(baseGridZ);
+    float w_x = fGridX - float(base.x);
+    float w_y = fGridY - float(base.y);
+    float w_z = fGridZ - float(base.z);
+
+    // Corner indices, wrapped on periodic axes
+    ivec3 next = base + 1 - ivec3(greaterThanEqual(base + 1, size)) * size;
+    base += ivec3(lessThan(base, ivec3(0))) * size;
 
     // Interpolate velocity vectors in space
-    vec3 v0 = interpolateV0(baseGridX, baseGridY, baseGridZ, w_x, w_y, w_z);
-    vec3 v1 = interpolateV1(baseGridX, baseGridY, baseGridZ, w_x, w_y, w_z);
+    vec3 v0 = interpolateV0(base.x, base.y, base.z, next.x, next.y, next.z, w_x, w_y, w_z);
+    vec3 v1 = interpolateV1(base.x, base.y, base.z, next.x, next.y, next.z, w_x, w_y, w_z);
 
     // Linear interpolation based on time step
     return mix(v0, v1, global_time_in_step / one_day_simulation_period);
 }
+#endif
+
+vec4 sampleLandMask(vec3 position) {
+    // Corners as in `getVelocity`, wrapped on periodic axes so a coastline across the seam is seen
+    // (mirrors `LandMask::sample`)
+    vec3 fGrid = toGrid(position);
+    ivec3 size = ivec3(width, height, depth);
+    ivec3 wrap = ivec3(equal(domain_boundary, ivec3(BOUNDARY_PERIODIC)));
+    ivec3 base = clamp(ivec3(floor(fGrid)), -wrap, max(size - 2 + wrap, -wrap));
+    vec3 w = clamp(fGrid - vec3(base), 0.0f, 1.0f);
+    ivec3 top = min(base + 1 - ivec3(greaterThanEqual(base + 1, size)) * size, size - 1);
+    base += ivec3(lessThan(base, ivec3(0))) * size;
+
+    int z0 = base.z * width * height;
+    int z1 = top.z * width * height;
+    vec4 c0 = mix(mix(landMask[z0 + base.y * width + base.x], landMask[z0 + base.y * width + top.x], w.x),
+                  mix(landMask[z0 + top.y * width + base.x], landMask[z0 + top.y * width + top.x], w.x), w.y);
+    vec4 c1 = mix(mix(landMask[z1 + base.y * width + base.x], landMask[z1 + base.y * width + top.x], w.x),
+                  mix(landMask[z1 + top.y * width + base.x], landMask[z1 + top.y * width + top.x], w.x), w.y);
+    return mix(c0, c1, w.z);
+}
 
+// Stops or reflects particles advected onto land, sea particles get a zero correction without branching
+vec3 resolveLand(vec3 position, vec3 previous) {
+    vec4 s = sampleLandMask(position);
+    float inLand = float(s.w < 0.0f);
+    vec3 normal = s.xyz / max(length(s.xyz), 1.0e-6f);
+    vec3 reflected = position + (1.0f - land_stop) * 2.0f * max(-s.w, 0.0f) * normal;
+    return mix(reflected, previous, land_stop * inLand);
+}
 
+// Binds a position to the simulated volume per axis, mirrors `DomainBoundaries::bind`
 vec3 bindPosition(vec3 position) {
-    return vec3(clamp(position.x, -max_width, max_width),
-    clamp(position.y, -max_height, max_height),
-    clamp(position.z, -max_depth, max_depth));
+    vec3 extent = vec3(max_width, max_height, max_depth);
+    vec3 offset = position + extent;
+    vec3 clamped = clamp(position, -extent, extent);
+    vec3 wrapped = offset - 2.0f * extent * floor(offset / (2.0f * extent)) - extent;
+    vec3 folded = offset - 4.0f * extent * floor(offset / (4.0f * extent));
+    vec3 reflected = extent - abs(folded - 2.0f * extent);
+    return mix(mix(clamped, wrapped, equal(domain_boundary, ivec3(BOUNDARY_PERIODIC))),
+               reflected, equal(domain_boundary, ivec3(BOUNDARY_REFLECT)));
+}
+
+// Whether a bound position was moved along an axis of the given boundary
+bool movedAlong(vec3 bound, vec3 position, int boundary) {
+    return any(bvec3(ivec3(notEqual(bound, position)) * ivec3(equal(domain_boundary, ivec3(boundary)))));
+}
+
+// Acceleration of an inertial particle, mirrors `Physics::dvdt`
+vec3 dvdt(vec3 position, vec3 velocity, vec3 acceleration) {
+    vec3 velField = getVelocity(position);
+    if (physics.model == MODEL_PARTICLES_SIMPLE) {
+        // Drag force
+        return -physics.b / physics.m * (velocity - velField);
+    }
+
+    // Centripetal, buoyant, drag, gravity, drag, and added mass force
+    vec3 Fd = -physics.b * (velocity - velField);
+    vec3 Fc = vec3(0.0f);
+    if (any(greaterThanEqual(abs(acceleration), vec3(0.0001f))) && any(greaterThanEqual(abs(velocity), vec3(0.0001f)))) {
+        float speed = length(velocity);
+        float R = speed * speed * speed / length(cross(velocity, acceleration));
+        Fc = physics.m * dot(velocity, velocity) / R * normalize(acceleration);  // + -> inwards
+    }
+    vec3 Fb = physics.rho * physics.V * physics.g * vec3(0.0f, 0.0f, 1.0f);
+    vec3 Fg = physics.m * physics.g * vec3(0.0f, 0.0f, -1.0f);
+    vec3 Fm = -physics.C * physics.rho * physics.V * acceleration;
+    return (Fd + Fc + Fb + Fg + Fm) / physics.m;
+}
+
+// Runge-Kutta 4 step of an inertial particle, mirrors `Physics::rk4Step`
+void rk4Step(inout vec3 position, inout vec3 velocity, inout vec3 acceleration, float dt) {
+    vec3 a1 = dvdt(position, velocity, acceleration);
+    vec3 v1 = velocity;
+    vec3 a2 = dvdt(position + 0.5f * v1 * dt, velocity + 0.5f * a1 * dt, acceleration);
+    vec3 v2 = velocity + 0.5f * a1 * dt;
+    vec3 a3 = dvdt(position + 0.5f * v2 * dt, velocity + 0.5f * a2 * dt, acceleration);
+    vec3 v3 = velocity + 0.5f * a2 * dt;
+    vec3 a4 = dvdt(position + v3 * dt, velocity + a3 * dt, acceleration);
+    vec3 v4 = velocity + a3 * dt;
+
+    acceleration = (a1 + 2.0f * a2 + 2.0f * a3 + a4) / 6.0f;
+    velocity += dt * (a1 + 2.0f * a2 + 2.0f * a3 + a4) / 6.0f;
+    position += dt * (v1 + 2.0f * v2 + 2.0f * v3 + v4) / 6.0f;
 }
 
 vec3 advectionStep(vec3 position, float dt) {
@@ -158,16 +375,46 @@ vec3 advectionStep(vec3 position, float dt) {
 }
 
 void main() {
-    int id = int(gl_GlobalInvocationID.x) * 3;
-    if (id >= particles.length()) return;
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= uint(particles.length())) return;
+    if (active_particles > 0u && id >= active_particles) return;
 
-    vec3 position = vec3(particles[id], particles[id + 1], particles[id + 2]);
-    position = advectionStep(position, dt);
-    position = bindPosition(position);
+    vec4 particle = particles[id];
+    if (particle.x >= PARKED_POSITION) return; // free slot
 
-    // Write back updated position
-    particles[id] = position.x;
-    particles[id + 1] = position.y;
-    particles[id + 2] = position.z;
-}
+    vec3 previous = particle.xyz;
+    vec3 position = previous;
+    bool inertial = physics.model != MODEL_PARTICLES_ADVECTION;
+    if (inertial) {
+        vec3 velocity = particleState[2u * id].xyz;
+        vec3 acceleration = particleState[2u * id + 1u].xyz;
+        rk4Step(position, velocity, acceleration, dt);
+        particleState[2u * id] = vec4(velocity, 0.0f);
+        particleState[2u * id + 1u] = vec4(acceleration, 0.0f);
+    } else {
+        position = advectionStep(previous, dt);
+    }
+    if (use_land_mask) {
+        position = resolveLand(position, previous);
+    }
+    vec3 bound = bindPosition(position);
+    float age = particle.w + dt;
+
+    // Reclaim the slot by pushing it onto the free list
+    bool outside = any(lessThan(bound, region_min)) || any(greaterThan(bound, region_max));
+    bool expired = max_age > 0.0f && age > max_age;
+    bool clamped = movedAlong(bound, position, BOUNDARY_CLAMP);
+    bool absorbed = movedAlong(bound, position, BOUNDARY_ABSORB);
+    if ((recycle_clamped && clamped) || (recycle_absorbed && absorbed) || (recycle_region && outside) || expired) {
+        freeIndices[atomicAdd(freeCount, 1)] = id;
+        particles[id] = vec4(vec3(PARKED_POSITION), 0.0f);
+        if (inertial) {
+            particleState[2u * id] = vec4(0.0f);
+            particleState[2u * id + 1u] = vec4(0.0f);
+        }
+        return;
+    }
 
+    // Write back updated position and age in a single 16-byte store
+    particles[id] = vec4(bound, age);
+}
@@ -0,0 +1,34 @@
+#version 320 es
+layout(local_size_x = 256) in;
+
+// Uniforms for grid dimensions and simulation domain
+uniform int grid_width;
+uniform int grid_height;
+uniform int grid_depth;
+uniform float max_width;
+uniform float max_height;
+uniform float max_depth;
+
+const float PARKED_POSITION = 1.0e6f; // position of free particle slots
+
+layout(std430, binding = 0) readonly buffer Particles {
+    vec4 particles[]; // x, y, z positions and age of particles
+};
+
+layout(std430, binding = 4) buffer DensityCounts {
+    uint counts[]; // number of particles per grid cell
+};
+
+void main() {
+    int id = int(gl_GlobalInvocationID.x);
+    if (id >= particles.length()) return;
+
+    vec3 position = particles[id].xyz;
+    if (position.x >= PARKED_POSITION) return; // free slot
+
+    // Transform position to grid indices, particles on the upper boundary belong to the last cell
+    ivec3 cell = ivec3((position / vec3(max_width, max_height, max_depth) + 1.0f) / 2.0f * vec3(grid_width, grid_height, grid_depth));
+    cell = clamp(cell, ivec3(0), ivec3(grid_width, grid_height, grid_depth) - 1);
+
+    atomicAdd(counts[cell.z * grid_width * grid_height + cell.y * grid_width + cell.x], 1u);
+}
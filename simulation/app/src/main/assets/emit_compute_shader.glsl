@@ -0,0 +1,68 @@
+#version 320 es
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) buffer Particles {
+    vec4 particles[]; // x, y, z positions and age of particles
+};
+
+layout(std430, binding = 5) buffer FreeList {
+    int freeCount;
+    uint freeIndices[]; // indices of free particle slots (stack)
+};
+
+layout(std430, binding = 6) readonly buffer Emitted {
+    float emitted[]; // x, y, z positions of newly emitted particles
+};
+
+layout(std430, binding = 8) buffer DispatchArgs {
+    uint numGroupsX; // indirect dispatch of the particle compute shader
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint numSlots; // number of particle slots in use (high-water mark)
+};
+
+// Constants of the particle models, only the model is needed here (see physics_constants.h)
+layout(std140, binding = 0) uniform PhysicsConstants {
+    float b;
+    float m;
+    float rho;
+    float V;
+    float g;
+    float C;
+    int model;
+    float padding;
+} physics;
+
+layout(std430, binding = 9) buffer ParticleState {
+    vec4 particleState[]; // velocity and acceleration of particles (two vec4 per particle, inertial models only)
+};
+
+uniform uint advect_local_size; // workgroup size of the particle compute shader
+
+void main() {
+    int id = int(gl_GlobalInvocationID.x) * 3;
+    if (id >= emitted.length()) return;
+
+    // Pop a free slot, undo the pop if the free list ran empty
+    uint slot;
+    int top = atomicAdd(freeCount, -1);
+    if (top > 0) {
+        slot = freeIndices[top - 1];
+    } else {
+        atomicAdd(freeCount, 1);
+
+        // Append behind the used slots while the buffer has capacity, and grow the particle dispatch to cover it
+        slot = atomicAdd(numSlots, 1u);
+        if (slot >= uint(particles.length())) {
+            atomicAdd(numSlots, 0xFFFFFFFFu);
+            return;
+        }
+        atomicMax(numGroupsX, slot / advect_local_size + 1u);
+    }
+
+    particles[slot] = vec4(emitted[id], emitted[id + 1], emitted[id + 2], 0.0f);
+    if (physics.model != 2) { // Inertial models keep a velocity and acceleration per particle
+        particleState[2u * slot] = vec4(0.0f);
+        particleState[2u * slot + 1u] = vec4(0.0f);
+    }
+}
@@ -0,0 +1,69 @@
+#version 320 es
+layout(local_size_x = 256) in;
+
+// Uniforms for lattice dimensions and integration horizon
+uniform int lattice_width;
+uniform int lattice_height;
+uniform int lattice_depth;
+uniform vec3 spacing;
+uniform float horizon;
+
+layout(std430, binding = 0) buffer FlowMap {
+    vec4 flowMap[]; // x, y, z advected positions (and age) of lattice points
+};
+
+layout(std430, binding = 3) buffer FTLEField {
+    float ftle[]; // FTLE value per lattice point
+};
+
+vec3 flowAt(int x, int y, int z) {
+    return flowMap[z * lattice_width * lattice_height + y * lattice_width + x].xyz;
+}
+
+// Central differences in the interior, one-sided differences on the lattice boundary
+vec3 derivative(ivec3 cell, int axis, int size, float h) {
+    if (size < 2) {
+        vec3 unit = vec3(0.0f);
+        unit[axis] = 1.0f;
+        return unit;
+    }
+    ivec3 lo = cell;
+    ivec3 hi = cell;
+    lo[axis] = max(lo[axis] - 1, 0);
+    hi[axis] = min(hi[axis] + 1, size - 1);
+    return (flowAt(hi.x, hi.y, hi.z) - flowAt(lo.x, lo.y, lo.z)) / (float(hi[axis] - lo[axis]) * h);
+}
+
+// Closed form of the largest eigenvalue of a symmetric matrix (O. K. Smith, 1961)
+float largestEigenvalue(mat3 C) {
+    float p1 = C[0][1] * C[0][1] + C[0][2] * C[0][2] + C[1][2] * C[1][2];
+    if (p1 == 0.0f) {
+        return max(C[0][0], max(C[1][1], C[2][2]));
+    }
+
+    float q = (C[0][0] + C[1][1] + C[2][2]) / 3.0f;
+    float p2 = (C[0][0] - q) * (C[0][0] - q) + (C[1][1] - q) * (C[1][1] - q) + (C[2][2] - q) * (C[2][2] - q) + 2.0f * p1;
+    float p = sqrt(p2 / 6.0f);
+    mat3 B = (C - q * mat3(1.0f)) / p;
+    float r = clamp(determinant(B) / 2.0f, -1.0f, 1.0f);
+    float phi = acos(r) / 3.0f;
+
+    return q + 2.0f * p * cos(phi);
+}
+
+void main() {
+    int id = int(gl_GlobalInvocationID.x);
+    if (id >= ftle.length()) return;
+
+    ivec3 cell = ivec3(id % lattice_width, (id / lattice_width) % lattice_height, id / (lattice_width * lattice_height));
+
+    // Columns of the flow map gradient
+    mat3 F = mat3(
+        derivative(cell, 0, lattice_width, spacing.x),
+        derivative(cell, 1, lattice_height, spacing.y),
+        derivative(cell, 2, lattice_depth, spacing.z)
+    );
+    mat3 C = transpose(F) * F;  // Right Cauchy-Green deformation tensor
+
+    ftle[id] = log(sqrt(max(largestEigenvalue(C), 1e-12f))) / horizon;
+}
@@ -0,0 +1,46 @@
+#version 320 es
+layout(local_size_x = 256) in;
+
+// Uniforms for the random stream and simulation domain
+uniform uint seed;
+uniform float max_width;
+uniform float max_height;
+uniform float max_depth;
+
+layout(std430, binding = 0) buffer Particles {
+    vec4 particles[]; // x, y, z positions and age of particles
+};
+
+// Counter-based random number generator (Philox2x32-10), bit-identical to `philox2x32` in counter_rng.h
+uvec2 philox2x32(uvec2 counter, uint key) {
+    for (int i = 0; i < 10; i++) {
+        uint hi;
+        uint lo;
+        umulExtended(0xD256D193u, counter.x, hi, lo);
+        counter = uvec2(hi ^ key ^ counter.y, lo);
+        key += 0x9E3779B9u;
+    }
+    return counter;
+}
+
+float toUnitFloat(uint x) {
+    return float(x >> 8u) * (1.0f / 16777216.0f);
+}
+
+vec4 counterRandom(uint index, uint key) {
+    uvec2 r0 = philox2x32(uvec2(index, 0u), key);
+    uvec2 r1 = philox2x32(uvec2(index, 1u), key);
+    return vec4(toUnitFloat(r0.x), toUnitFloat(r0.y), toUnitFloat(r1.x), toUnitFloat(r1.y));
+}
+
+void main() {
+    int id = int(gl_GlobalInvocationID.x);
+    if (id >= particles.length()) return;
+
+    // Uniform distribution over the 3D space, same as `ParticlesHandler::seedParticle`
+    vec4 r = counterRandom(gl_GlobalInvocationID.x, seed);
+    particles[id] = vec4(max_width * (2.0f * r.x - 1.0f),
+                         max_height * (2.0f * r.y - 1.0f),
+                         max_depth * (2.0f * r.z - 1.0f),
+                         0.0f);
+}
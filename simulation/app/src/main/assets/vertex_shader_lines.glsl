@@ -0,0 +1,35 @@
+#version 320 es
+
+#define PI 3.14159265
+
+// One instance per vector, both end points are attributes of every vertex of the line
+layout(location = 0) in vec3 vStart;
+layout(location = 1) in vec3 vEnd;
+
+flat out vec4 col;
+
+uniform mat4 mvpTransform; // projection * view * model, pre-multiplied once per frame
+
+vec3 angleToRGB(float angle) {
+    float normalized = mod(angle / (2.0 * PI), 1.0);
+    float r = 0.5 + 0.3 * sin(normalized * 2.0 * PI + 0.0);            // Red component
+    float g = 0.5 + 0.3 * sin(normalized * 2.0 * PI + 2.0 * PI / 3.0); // Green component
+    float b = 0.5 + 0.3 * sin(normalized * 2.0 * PI + 4.0 * PI / 3.0); // Blue component
+    float saturation = 0.75;  // Reduce saturation for less intense colors
+    vec3 color = vec3(r, g, b);
+    vec3 gray = vec3(0.5);  // Gray level for desaturation effect
+    color = mix(gray, color, saturation);
+    return color;
+}
+
+void main() {
+    // Get angle
+    vec3 v = normalize(vEnd - vStart);
+    float angle = atan(v.y, v.x);
+
+    // Get color
+    col = vec4(angleToRGB(angle), 1.0);
+
+    // Vertex 0 is the start, vertex 1 the end of the line
+    gl_Position = mvpTransform * vec4(gl_VertexID == 0 ? vStart : vEnd, 1.0);
+}
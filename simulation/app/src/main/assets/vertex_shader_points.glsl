@@ -0,0 +1,14 @@
+#version 320 es
+
+layout(location = 0) in vec3 vPosition;
+
+flat out vec4 col;
+
+uniform float uPointSize;
+uniform mat4 mvpTransform; // projection * view * model, pre-multiplied once per frame
+
+void main() {
+    gl_PointSize = uPointSize;
+    gl_Position = mvpTransform * vec4(vPosition, 1.0);
+    col = vec4(1.0, 0.0, 0.0, 1.0);
+}
@@ -13,7 +13,7 @@
 #include <functional>
 
 #include "android_logging.h"
-#include "ThreadPool.h"
+#include "executor.h"
 
 /**
  * @class EGLContextManager
@@ -34,9 +34,15 @@ public:
 
     /**
      * @brief Synchronizes the EGL context between threads
-     * @param threadPool A pointer to the ThreadPool to synchronize the context with
+     * @param executor A pointer to the executor whose background lane is synchronized
      */
-    void syncEGLContext(ThreadPool *threadPool);
+    void syncEGLContext(Executor *executor);
+
+    /**
+     * @brief Makes the shared context current on the background lane of an executor, so that it can upload GL data
+     * @param executor A pointer to the executor with a single background lane to make the context current on
+     */
+    void makeCurrentOnThread(Executor *executor);
 
     std::atomic<GLsync> globalFence{nullptr};  // Atomic GLsync object for global fence synchronization.
 
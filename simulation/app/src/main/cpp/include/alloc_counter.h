@@ -0,0 +1,37 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_ALLOC_COUNTER_H
+#define LAGRANGIAN_FLUID_SIMULATION_ALLOC_COUNTER_H
+
+#include <cstddef>
+
+/**
+ * @class AllocationCounter
+ * @brief This class exposes the number of heap allocations made through the global operator new.
+ *
+ * The counting operators are only replaced when `COUNT_ALLOCATIONS` is set, otherwise both counters stay zero.
+ * Take the difference of two readings to get the allocations of a code section, e.g., of loading one time step.
+ */
+class AllocationCounter {
+public:
+    /**
+     * @brief Gets the number of allocations since the start of the application.
+     *
+     * @return The number of allocations.
+     */
+    static size_t count();
+
+    /**
+     * @brief Gets the number of allocated bytes since the start of the application.
+     *
+     * @return The number of allocated bytes.
+     */
+    static size_t bytes();
+
+    /**
+     * @brief Checks whether allocations are counted, i.e., whether `COUNT_ALLOCATIONS` is set.
+     *
+     * @return True if allocations are counted, false otherwise.
+     */
+    static bool enabled();
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_ALLOC_COUNTER_H
@@ -6,11 +6,20 @@
 #ifndef ANDROID_LOGGING_H
 #define ANDROID_LOGGING_H
 
+#if HEADLESS
+#include <cstdio>
+
+// Host builds (see `batch_runner.cpp`) log to stderr, keeping stdout for the reports
+#define LOG_STDERR(level, tag, ...) do { std::fprintf(stderr, "%s/%s: ", level, tag); std::fprintf(stderr, __VA_ARGS__); std::fputc('\n', stderr); } while (0)
+#define LOGE(tag, ...) LOG_STDERR("E", tag, __VA_ARGS__)
+#define LOGI(tag, ...) LOG_STDERR("I", tag, __VA_ARGS__)
+#else
 #include <android/log.h>
 
 // Simple logging macros
 #define LOGE(tag, ...) __android_log_print(ANDROID_LOG_ERROR, tag, __VA_ARGS__)
 #define LOGI(tag, ...) __android_log_print(ANDROID_LOG_INFO, tag, __VA_ARGS__)
+#endif
 
 
 #endif // ANDROID_LOGGING_H
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_APP_CONFIG_H
+#define LAGRANGIAN_FLUID_SIMULATION_APP_CONFIG_H
+
+#include <string>
+
+#include "consts.h"
+#include "android_logging.h"
+#include "field_window.h"
+#include "domain_boundary.h"
+
+/**
+ * @struct AppConfig
+ * @brief Settings read at startup from a `KEY=VALUE` file in the files directory of the app.
+ *
+ * The defaults are the compile-time settings of `config.txt`, so a missing file or key keeps the built behavior.
+ * Supported keys:
+ * - `MODE`: `sequential`, `parallel`, or `compute_shaders`.
+ * - `PRESET`: `double_gyre`, `perlin`, or `double_gyre_alt`.
+ * - `REDUCE_FIELD_GRAPHICS`: `0` or `1`.
+ * - `MODE_SWITCH_INTERVAL`: Seconds after which the next mode is switched to, `0` to never switch.
+ * - `WINDOW`: Region of interest of the dataset in cells, `x0:x1,y0:y1,z0:z1` (see `FieldWindow::parse`).
+ * - `FOCUS`: Region sampled at the full resolution in cells, in the format of `WINDOW`, coarser farther away.
+ * - `FIELD_STRIDE`: Cells per block along x and y of a coarser field, `1` for the full resolution.
+ * - `FIELD_DECIMATION`: `stride` (every n-th cell) or `average` (mean of every block).
+ * - `FIELD_MEMORY_BUDGET`: Megabytes the three resident time steps may take, `0` for no budget.
+ * - `GRID_COORDINATES`: `1` to sample stretched grids in the coordinates of the dataset, `0` to map them linearly.
+ * - `DOMAIN_BOUNDARY`: `clamp`, `periodic`, `reflect`, or `absorb` per axis, e.g., `periodic,clamp,clamp` (see
+ *   `DomainBoundaries::parse`).
+ */
+struct AppConfig {
+    /**
+     * @enum Preset
+     * @brief The physics preset.
+     */
+    enum class Preset {
+        doubleGyre,     // Double gyre regular scaling
+        perlin,         // Perlin noise
+        doubleGyreAlt   // Double gyre alternative scaling
+    };
+
+    Mode mode;
+    Preset preset;
+    bool reduceFieldGraphics;
+    float modeSwitchInterval = 0.0f;
+    FieldWindow window;  // Full dataset by default
+    FieldWindow focus;  // Full resolution everywhere by default
+    int fieldStride = 1;
+    bool averageField = false;  // Block-average instead of strided reads
+    size_t fieldMemoryBudget = 0;  // In bytes
+    bool gridCoordinates = true;  // Read the coordinate variables of the dataset
+    DomainBoundaries domainBoundaries;  // Clamping along all axes by default
+
+    /**
+     * @brief Creates the config of the compile-time settings.
+     *
+     * @return The config.
+     */
+    static AppConfig defaults();
+
+    /**
+     * @brief Loads the config from a file, keys missing from the file keep their defaults.
+     *
+     * @param filePath The path of the file.
+     * @return The config.
+     */
+    static AppConfig load(const std::string& filePath);
+
+    /**
+     * @brief Gets the name of a mode, as used in the config file.
+     *
+     * @param mode The mode.
+     * @return The name of the mode.
+     */
+    static const char* modeName(Mode mode);
+
+    /**
+     * @brief Gets the name of a preset, as used in the config file.
+     *
+     * @param preset The preset.
+     * @return The name of the preset.
+     */
+    static const char* presetName(Preset preset);
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_APP_CONFIG_H
@@ -0,0 +1,229 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_BATCH_RUNNER_H
+#define LAGRANGIAN_FLUID_SIMULATION_BATCH_RUNNER_H
+
+#include "particles_handler.h"
+#include "physics.h"
+#include "vector_field_handler.h"
+#include "executor.h"
+#include "field_window.h"
+#include "domain_boundary.h"
+#include "consts.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+
+/**
+ * @struct BatchOptions
+ * @brief The settings of a headless run, see `BatchRunner::parseArguments` for the command-line flags.
+ */
+struct BatchOptions {
+    std::string fieldDir;  // Directory of the u, v, and w files of all time steps
+    std::string seedsFile;  // Positions file (lat, lon, depth), empty to seed by `initType`
+    ParticlesHandler::InitType initType = ParticlesHandler::InitType::uniform;
+    int numParticles = NUM_PARTICLES;
+    uint32_t seed = 112358;
+    Physics::Model model = Physics::Model::particles_advection;
+    Mode mode = Mode::parallel;  // Only the CPU modes run headless
+    float dt = 0.05f;
+    float period = 50.0f;  // Simulation time between two time steps of the field
+    float duration = 500.0f;  // Simulation time to run for
+    size_t threads = 0;  // Number of workers, 0 for one per core
+    bool reflectAtCoast = false;
+    FieldWindow window;  // Region of interest of the dataset, full by default
+    int expandMargin = 0;  // Cells the window grows by when particles reach its border, 0 to keep it
+    FieldWindow focus;  // Region sampled at the full resolution, full by default
+    int stride = 1;  // Cells per block along x and y of a coarser field, 1 for the full resolution
+    bool average = false;  // Block-average the field instead of reading every n-th cell
+    size_t memoryBudget = 0;  // Bytes the three resident time steps may take, 0 for no budget
+    bool sparse = false;  // Store only the bricks of the field holding sea
+    bool linearGrid = false;  // Ignore the coordinate variables and map all axes linearly
+    DomainBoundaries boundaries;  // What happens to particles leaving the volume, clamping by default
+    std::string output;  // Prefix of the output files, empty to not write any
+    int saveEvery = 0;  // Steps between trajectory records, 0 to only write the endpoints
+};
+
+/**
+ * @struct BatchTiming
+ * @brief Where the time of a headless run went, in milliseconds.
+ */
+struct BatchTiming {
+    float setup = 0.0f;  // Listing the files, loading the first time steps, and seeding
+    float advect = 0.0f;  // Stepping the particles
+    float loadWait = 0.0f;  // Waiting for a time step that was not prefetched in time
+    float output = 0.0f;  // Writing the trajectories and endpoints
+    float outputWait = 0.0f;  // Waiting for a trajectory record that was not written in time
+    float total = 0.0f;
+    size_t steps = 0;
+    size_t particles = 0;
+    size_t expansions = 0;  // Times the window was grown
+    std::vector<float> busyTimes;  // Busy time of every worker
+};
+
+/**
+ * @class BatchRunner
+ * @brief Runs the particle simulation without any graphics, as fast as the CPU modes allow.
+ *
+ * The runner drives the same `VectorFieldHandler`, `Physics`, and `ParticlesHandler` as the app: the first time steps
+ * are loaded up front, the next one is prefetched on the background lane of the executor, and the time advances and
+ * rolls over to the next time step exactly like `check_update` in the app. Time steps cycle like in the app when the
+ * duration exceeds the loaded files.
+ */
+class BatchRunner {
+public:
+    /**
+     * @brief Callback receiving the particle positions and ages (`PARTICLE_STRIDE` floats per particle) after a step.
+     */
+    using Observer = std::function<void(size_t step, const std::vector<float>& positions)>;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param options The settings of the run.
+     */
+    BatchRunner(const BatchOptions& options);
+
+    /**
+     * @brief Destructor waiting for a pending time step load.
+     */
+    ~BatchRunner();
+
+    /**
+     * @brief Parses the command-line flags into the options. Prints the usage on `--help` or an invalid flag.
+     *
+     * @param argc The number of arguments.
+     * @param argv The arguments.
+     * @param options The options to fill, keeping the defaults of flags that are not given.
+     * @return True if the arguments are valid, false otherwise.
+     */
+    static bool parseArguments(int argc, char** argv, BatchOptions& options);
+
+    /**
+     * @brief Prints the command-line flags.
+     *
+     * @param program The name of the program.
+     */
+    static void printUsage(const char* program);
+
+    /**
+     * @brief Loads the field and seeds the particles, then steps them for the duration and writes the outputs.
+     *
+     * @param observer Called with the initial positions (step 0) and after every step, may be empty.
+     * @return True if the run completed, false otherwise.
+     */
+    bool run(const Observer& observer = nullptr);
+
+    /**
+     * @brief Getter for the timing of the last run.
+     *
+     * @return The timing.
+     */
+    const BatchTiming& getTiming() { return timing; }
+
+    /**
+     * @brief Prints the timing of the last run.
+     *
+     * @param stream The stream to print to.
+     */
+    void printReport(FILE* stream);
+
+private:
+    /**
+     * @brief Lists the field files and splits them into the u, v, and w files of every time step.
+     *
+     * @return True if at least one time step was found, false otherwise.
+     */
+    bool listFieldFiles();
+
+    /**
+     * @brief Loads a time step into the next slot of the vector field handler.
+     *
+     * @param frame The index of the time step.
+     */
+    void loadStep(size_t frame);
+
+    /**
+     * @brief Advances the simulation time, and rolls over to the next time step at the end of the current one.
+     */
+    void advanceTime();
+
+    /**
+     * @brief Waits for the pending time step load, if any.
+     */
+    void waitForLoad();
+
+    /**
+     * @brief Waits for the pending trajectory record, if any.
+     */
+    void waitForOutput();
+
+    /**
+     * @brief Grows the window at the sides where live particles reached its border (only with `expandMargin`).
+     */
+    void checkWindow();
+
+    /**
+     * @brief Grows the window, reloads the loaded time steps for it, and moves the particles into its volume.
+     *
+     * @param low The number of cells to add below the window per axis.
+     * @param high The number of cells to add above the window per axis.
+     */
+    void expandWindow(const glm::ivec3& low, const glm::ivec3& high);
+
+    /**
+     * @brief Gathers the particle positions in the simulated volume of the full dataset, also when loading a window,
+     * so that the outputs of different (or growing) windows share the same coordinates.
+     *
+     * @return The positions and ages (`PARTICLE_STRIDE` floats per particle).
+     */
+    const std::vector<float>& gatherOutputPositions();
+
+    /**
+     * @brief Creates the trajectory file with an unlimited time dimension.
+     *
+     * @return True if the file was created, false otherwise.
+     */
+    bool openTrajectories();
+
+    /**
+     * @brief Appends the current particle positions as a record of the trajectory file.
+     * The positions are copied and written on the background lane, so that all netCDF calls during the stepping
+     * run on the same thread as the time step loading.
+     *
+     * @param step The current step.
+     */
+    void writeTrajectoryRecord(size_t step);
+
+    /**
+     * @brief Writes the final particle positions to the endpoints file.
+     */
+    void writeEndpoints();
+
+    BatchOptions options;
+    BatchTiming timing;
+
+    std::vector<std::string> uFiles;
+    std::vector<std::string> vFiles;
+    std::vector<std::string> wFiles;
+    size_t currentFrame = 0;  // Time step loaded last
+    std::vector<size_t> slotFrames;  // Time step in every slot of the vector field handler, rotated alike
+    std::future<void> pendingLoad;
+    std::future<void> pendingOutput;
+
+    std::unique_ptr<Executor> executor;
+    std::unique_ptr<VectorFieldHandler> vectorFieldHandler;
+    std::unique_ptr<Physics> physics;
+    std::unique_ptr<ParticlesHandler> particlesHandler;
+
+    std::unique_ptr<netCDF::NcFile> trajectories;
+    size_t numRecords = 0;
+    std::vector<float> outputPositions;  // Reused buffer of the positions in the volume of the dataset
+    std::vector<float> recordPositions;  // Copy of the positions of the trajectory record being written
+    std::vector<float> component;  // Reused buffer of one coordinate of all particles
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_BATCH_RUNNER_H
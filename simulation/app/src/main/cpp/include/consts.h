@@ -16,6 +16,22 @@
 // Number of particles (only used when not specifying positions from file)
 #define NUM_PARTICLES 250000
 
+// Floats per particle in the particle buffers: xyz position and a spare lane holding the age,
+// so that every particle is a single aligned 16-byte vec4 on the GPU
+#define PARTICLE_STRIDE 4
+
+// Floats per particle in the GPU particle state buffer: velocity and acceleration, each padded to a vec4
+#define PARTICLE_STATE_STRIDE 8
+
+// Frame time in milliseconds held by the frame governor (only with ADAPTIVE_FRAME_BUDGET)
+#define TARGET_FRAME_TIME 33.3f
+
+// Default number of invocations per workgroup of the particle compute shader
+#define DEFAULT_LOCAL_SIZE 256
+
+// Position of free (recycled) particle slots, far outside of the rendered volume
+#define PARKED_POSITION 1.0e6f
+
 // Number of simulation time between time steps (two files interpolation) == 1 day
 extern float one_day_simulation_period;
 
@@ -30,5 +46,20 @@ enum class Mode {
 };
 extern Mode mode;
 
+// Representation of the vector field in the compute shader
+enum class FieldStorage {
+    buffers,  // SSBOs of the field vertices, interpolated in the shader
+    textures, // 3D textures, interpolated by the texture units
+    bricks    // SSBOs of the velocities of the bricks holding sea, found through a brick table
+};
+extern FieldStorage fieldStorage;
+
+// Stage applying the view transformations to particles and vector field lines
+enum class RenderPath {
+    vertexTransform,  // Pre-multiplied MVP in the vertex shaders, no geometry stage
+    geometryShaders   // Pass-through vertex shader and transforming geometry shaders (kept for comparison)
+};
+extern RenderPath renderPath;
+
 
 #endif //LAGRANGIAN_FLUID_SIMULATION_CONSTS_H
@@ -0,0 +1,53 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_COUNTER_RNG_H
+#define LAGRANGIAN_FLUID_SIMULATION_COUNTER_RNG_H
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+/**
+ * @brief Counter-based random number generator (Philox2x32-10, Salmon et al., 2011).
+ *
+ * The output depends only on the counter and the key, so every particle can draw its own random stream
+ * from its index and a global seed without any shared state. The same function is implemented in
+ * `seed_compute_shader.glsl`, and both produce bit-identical results.
+ *
+ * @param counter The counter, e.g., (particle index, stream index).
+ * @param key The key, e.g., the global seed.
+ * @return Two independent uniformly distributed 32-bit random numbers.
+ */
+inline glm::uvec2 philox2x32(glm::uvec2 counter, uint32_t key) {
+    for (int i = 0; i < 10; i++) {
+        uint64_t product = (uint64_t) 0xD256D193u * counter.x;
+        uint32_t hi = (uint32_t) (product >> 32);
+        uint32_t lo = (uint32_t) product;
+        counter = glm::uvec2(hi ^ key ^ counter.y, lo);
+        key += 0x9E3779B9u;
+    }
+    return counter;
+}
+
+/**
+ * @brief Converts a random 32-bit number into a float in [0, 1) using its 24 most significant bits.
+ *
+ * @param x The random number.
+ * @return The float in [0, 1).
+ */
+inline float toUnitFloat(uint32_t x) {
+    return (float) (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Draws four uniformly distributed floats in [0, 1) for the given index.
+ *
+ * @param index The index of the random stream (e.g., particle index).
+ * @param seed The global seed.
+ * @return The four floats in [0, 1).
+ */
+inline glm::vec4 counterRandom(uint32_t index, uint32_t seed) {
+    glm::uvec2 r0 = philox2x32(glm::uvec2(index, 0u), seed);
+    glm::uvec2 r1 = philox2x32(glm::uvec2(index, 1u), seed);
+    return glm::vec4(toUnitFloat(r0.x), toUnitFloat(r0.y), toUnitFloat(r1.x), toUnitFloat(r1.y));
+}
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_COUNTER_RNG_H
@@ -0,0 +1,86 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_CPU_TOPOLOGY_H
+#define LAGRANGIAN_FLUID_SIMULATION_CPU_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @class CpuTopology
+ * @brief This class describes the cores of the device, read from the Linux sysfs CPU tree.
+ *
+ * On big.LITTLE devices the cores differ in speed, which `std::thread::hardware_concurrency()` does not tell.
+ * The relative speed of a core is its `cpu_capacity` (0-1024), or its maximum frequency if the kernel does not
+ * expose capacities. The root of the tree is a parameter, so that a faked tree can be used on any Linux machine.
+ */
+class CpuTopology {
+public:
+    /**
+     * @struct Core
+     * @brief A single online core.
+     */
+    struct Core {
+        int id;  // Index of the core, as used for the affinity mask
+        int cluster;  // Cluster of the core, cores of a cluster share their frequency
+        long capacity;  // Relative speed, 0 if unknown
+        long maxFrequency;  // Maximum frequency in kHz, 0 if unknown
+    };
+
+    /**
+     * @brief Reads the topology from the given sysfs CPU tree.
+     * Falls back to `hardware_concurrency()` equal cores if the tree cannot be read.
+     *
+     * @param root The root of the tree, e.g., `/sys/devices/system/cpu`.
+     * @return The topology.
+     */
+    static CpuTopology discover(const std::string& root = "/sys/devices/system/cpu");
+
+    /**
+     * @brief Creates a topology of equal cores.
+     *
+     * @param numCores The number of cores.
+     * @return The topology.
+     */
+    static CpuTopology uniform(size_t numCores);
+
+    /**
+     * @brief Getter for the cores, sorted from the fastest to the slowest.
+     *
+     * @return A reference to the cores.
+     */
+    const std::vector<Core>& getCores() const { return cores; }
+
+    /**
+     * @brief Gets the relative speed of a core, normalized so that the slowest core has weight 1.
+     *
+     * @param i The index of the core in `getCores()`.
+     * @return The weight of the core.
+     */
+    float getWeight(size_t i) const;
+
+    /**
+     * @brief Checks if the cores differ in speed.
+     *
+     * @return True if the cores differ in speed, false otherwise.
+     */
+    bool isHeterogeneous() const;
+
+    /**
+     * @brief Describes the topology for the log, e.g., "4x1024 (cluster 1), 4x325 (cluster 0)".
+     *
+     * @return The description.
+     */
+    std::string describe() const;
+
+private:
+    /**
+     * @brief Gets the raw speed of a core, its capacity or else its maximum frequency.
+     *
+     * @param core The core.
+     * @return The speed, 0 if unknown.
+     */
+    static long speed(const Core& core);
+
+    std::vector<Core> cores;
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_CPU_TOPOLOGY_H
@@ -0,0 +1,143 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_DENSITY_HANDLER_H
+#define LAGRANGIAN_FLUID_SIMULATION_DENSITY_HANDLER_H
+
+#include "glm/glm.hpp"
+#include "mainview.h"
+#include "executor.h"
+#include "consts.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <future>
+
+/**
+ * @class DensityHandler
+ * @brief This class estimates the particle concentration on a regular 3D grid over the simulation domain.
+ *
+ * On the CPU, every thread bins its chunk of particles into a private histogram, the histograms are then
+ * merged in a parallel reduction over the grid cells. On the GPU, the particles are binned by the density
+ * compute shader with atomic adds. The counts can optionally be smoothed with a separable binomial kernel.
+ */
+class DensityHandler {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param width The number of grid cells in the X axis.
+     * @param height The number of grid cells in the Y axis.
+     * @param depth The number of grid cells in the Z axis.
+     * @param interval The number of simulation steps between two density estimations.
+     * @param smoothingPasses The number of smoothing passes applied to the counts (0 = no smoothing).
+     */
+    DensityHandler(int width = 64, int height = 64, int depth = 8, int interval = 10, int smoothingPasses = 0);
+
+    /**
+     * @brief Checks whether the density should be estimated in this step, i.e., every `interval` steps.
+     *
+     * @return True if the density is due, false otherwise.
+     */
+    bool isDue();
+
+    /**
+     * @brief Estimates the density from the particle positions on the CPU.
+     *
+     * @param particlesPos A reference to the flat vector of particle positions (`PARTICLE_STRIDE` floats per particle).
+     * @param executor The executor to use.
+     * @param threadCount The number of threads to split the particles between.
+     */
+    void computeDensity(const std::vector<float>& particlesPos, Executor& executor, size_t threadCount);
+
+    /**
+     * @brief Estimates the density from the particle buffer using the compute shaders.
+     *
+     * @param mainview The view owning the particle buffer.
+     * @param executor The executor to use for the smoothing.
+     * @param threadCount The number of threads to use for the smoothing.
+     */
+    void computeDensity(Mainview& mainview, Executor& executor, size_t threadCount);
+
+    /**
+     * @brief Appends the current density volume as a new time record into a NetCDF file.
+     * The volume is copied and written by a background task, so the caller does not wait for the file.
+     * If the previous record is still being written, waits for it first to keep the records in order.
+     *
+     * @param filePath The path of the file to write to (created if it does not exist).
+     * @param executor The executor to run the write on.
+     */
+    void exportToFile(const std::string& filePath, Executor& executor);
+
+    /**
+     * @brief Getter for the density volume (x-fastest, then y, then z).
+     * Each value is the fraction of particles in the cell.
+     *
+     * @return A reference to the flat vector of densities.
+     */
+    std::vector<float>& getDensity() { return density; };
+
+    /**
+     * @brief Getter for the grid width.
+     *
+     * @return The number of grid cells in the X axis.
+     */
+    int getWidth() { return width; };
+
+    /**
+     * @brief Getter for the grid height.
+     *
+     * @return The number of grid cells in the Y axis.
+     */
+    int getHeight() { return height; };
+
+    /**
+     * @brief Getter for the grid depth.
+     *
+     * @return The number of grid cells in the Z axis.
+     */
+    int getDepth() { return depth; };
+
+private:
+    /**
+     * @brief Bins the particles in the range [start, end) into the given histogram.
+     */
+    void binRange(const std::vector<float>& particlesPos, size_t start, size_t end, std::vector<uint32_t>& histogram);
+
+    /**
+     * @brief Normalizes the merged counts into the density volume and applies the smoothing passes.
+     *
+     * @param numParticles The number of binned particles, i.e., the sum of the counts.
+     */
+    void finalize(size_t numParticles, Executor& executor, size_t threadCount);
+
+    /**
+     * @brief Applies one pass of the [1, 2, 1] / 4 kernel along the given axis.
+     */
+    void smoothAxis(int axis, Executor& executor, size_t threadCount);
+
+    /**
+     * @brief Appends the copied density volume as a new time record into a NetCDF file.
+     *
+     * @param filePath The path of the file to write to (created if it does not exist).
+     */
+    void writeRecord(const std::string& filePath);
+
+    // Grid dimensions
+    int width;
+    int height;
+    int depth;
+
+    int interval;
+    int stepCounter;
+    int smoothingPasses;
+
+    std::vector<std::vector<uint32_t>> privateHistograms;  // One per thread
+    std::vector<uint32_t> counts;  // Merged counts
+    std::vector<float> density;
+    std::vector<float> smoothingBuffer;
+
+    std::vector<float> exportBuffer;  // Copy of the density being written by the background task
+    std::future<void> pendingExport;
+    size_t numRecords;  // Number of time records written by `exportToFile`
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_DENSITY_HANDLER_H
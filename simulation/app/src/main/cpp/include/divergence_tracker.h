@@ -0,0 +1,115 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_DIVERGENCE_TRACKER_H
+#define LAGRANGIAN_FLUID_SIMULATION_DIVERGENCE_TRACKER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "consts.h"
+
+/**
+ * @struct Divergence
+ * @brief The position divergence of a candidate from the reference at one step, in simulation units.
+ */
+struct Divergence {
+    size_t step = 0;
+    float maxError = 0.0f;  // Largest distance of a particle from its reference position
+    float rmsError = 0.0f;  // Root mean square distance over the compared particles
+    size_t compared = 0;  // Particles alive in both runs
+    size_t mismatched = 0;  // Particles alive in only one of the runs (reclaimed differently)
+};
+
+/**
+ * @class DivergenceTracker
+ * @brief Compares the particle positions of a candidate run against the recorded positions of a reference run.
+ *
+ * The reference positions are recorded at the sampled steps first, and the candidate is compared at the same steps
+ * afterwards. The recorded steps are spooled to a temporary file and read back one at a time, so only a single step
+ * of the reference is held in memory. Reclaimed particles (parked at `PARKED_POSITION`) are not compared, but a
+ * particle reclaimed in only one of the runs counts as a mismatch.
+ */
+class DivergenceTracker {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param every The number of steps between the sampled steps, step 0 is always sampled.
+     */
+    DivergenceTracker(size_t every = 10);
+
+    /**
+     * @brief Destructor removing the spooled reference.
+     */
+    ~DivergenceTracker();
+
+    DivergenceTracker(const DivergenceTracker&) = delete;
+    DivergenceTracker& operator=(const DivergenceTracker&) = delete;
+
+    /**
+     * @brief Checks if a step is sampled.
+     *
+     * @param step The step.
+     * @return True if the step is sampled, false otherwise.
+     */
+    bool isSampled(size_t step) { return step % every == 0; }
+
+    /**
+     * @brief Records the reference positions of a sampled step by appending them to the spool file.
+     *
+     * @param step The step.
+     * @param positions The positions and ages (`PARTICLE_STRIDE` floats per particle).
+     */
+    void recordReference(size_t step, const std::vector<float>& positions);
+
+    /**
+     * @brief Compares the candidate positions of a sampled step against the reference, and keeps the result.
+     *
+     * @param step The step.
+     * @param positions The positions and ages (`PARTICLE_STRIDE` floats per particle).
+     * @return The divergence, with every particle mismatched if the step or particle count differs from the reference.
+     */
+    Divergence compare(size_t step, const std::vector<float>& positions);
+
+    /**
+     * @brief Getter for the divergences of all compared steps.
+     *
+     * @return The divergences, in the order of the steps.
+     */
+    const std::vector<Divergence>& getDivergences() { return divergences; }
+
+    /**
+     * @brief Checks the compared steps against the tolerances.
+     *
+     * @param maxTolerance The largest allowed distance of a particle from its reference position.
+     * @param rmsTolerance The largest allowed root mean square distance of a step.
+     * @return True if no step exceeds a tolerance or has mismatched particles, and every step was compared.
+     */
+    bool withinTolerance(float maxTolerance, float rmsTolerance);
+
+private:
+    /**
+     * @struct Record
+     * @brief Where the reference positions of a step are in the spool file.
+     */
+    struct Record {
+        long offset;
+        size_t size;  // Number of floats
+    };
+
+    /**
+     * @brief Reads the reference positions of a step back from the spool file.
+     *
+     * @param step The step.
+     * @return True if the step was recorded and read, false otherwise.
+     */
+    bool readReference(size_t step);
+
+    size_t every;
+    FILE* spool;  // Temporary file of the reference positions, removed when closed
+    std::map<size_t, Record> reference;  // Records of the sampled steps
+    std::vector<float> expected;  // Reused buffer of the reference positions of the compared step
+    std::vector<Divergence> divergences;
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_DIVERGENCE_TRACKER_H
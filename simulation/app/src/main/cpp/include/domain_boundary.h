@@ -0,0 +1,103 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_DOMAIN_BOUNDARY_H
+#define LAGRANGIAN_FLUID_SIMULATION_DOMAIN_BOUNDARY_H
+
+#include "glm/glm.hpp"
+#include "consts.h"
+
+#include <array>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @enum DomainBoundary
+ * @brief What happens to a particle that leaves the simulated volume along an axis. The values are shared with the
+ * `BOUNDARY_*` constants of the compute shader.
+ */
+enum class DomainBoundary {
+    clamp,     // Held at the border (and reclaimed with `RecyclePolicy::clamped`)
+    periodic,  // Wrapped to the opposite border, e.g., for global longitudes
+    reflect,   // Mirrored back into the volume at the border
+    absorb     // Removed, its slot is reclaimed for the emitters
+};
+
+/**
+ * @struct DomainBoundaries
+ * @brief The boundary of the simulated volume per axis: x (lon), y (lat), and z (depth).
+ *
+ * A periodic axis also wraps the sampling of the field, so the loaded grid must span the full period along it (e.g.,
+ * all longitudes of a global dataset, without a window along x).
+ */
+struct DomainBoundaries {
+    std::array<DomainBoundary, 3> axes = {DomainBoundary::clamp, DomainBoundary::clamp, DomainBoundary::clamp};
+
+    /**
+     * @brief Binds a position to the simulated volume, like `bindPosition` of the compute shader.
+     *
+     * @param position The position to bind, in simulation units.
+     * @param clamped Set to true if the position was clamped along a clamping axis, false otherwise.
+     * @param absorbed Set to true if the position left the volume along an absorbing axis, false otherwise.
+     */
+    void bind(glm::vec3& position, bool& clamped, bool& absorbed) const {
+        static const glm::vec3 extent(FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH);
+        clamped = false;
+        absorbed = false;
+        for (int axis = 0; axis < 3; axis++) {
+            float low = -extent[axis];
+            float high = extent[axis];
+            float unbound = position[axis];
+            switch (axes[axis]) {
+                case DomainBoundary::periodic: {
+                    float offset = unbound - low;
+                    position[axis] = low + offset - 2.0f * high * std::floor(offset / (2.0f * high));
+                    break;
+                }
+                case DomainBoundary::reflect: {
+                    // Triangle wave of period 4 * extent, so that also long steps end up inside
+                    float offset = unbound - low;
+                    float folded = offset - 4.0f * high * std::floor(offset / (4.0f * high));
+                    position[axis] = low + 2.0f * high - std::abs(folded - 2.0f * high);
+                    break;
+                }
+                default:
+                    position[axis] = std::clamp(unbound, low, high);
+                    clamped |= axes[axis] == DomainBoundary::clamp && position[axis] != unbound;
+                    absorbed |= axes[axis] == DomainBoundary::absorb && position[axis] != unbound;
+                    break;
+            }
+        }
+    }
+
+    /**
+     * @brief Checks if an axis is periodic.
+     *
+     * @param axis The axis, 0 for x.
+     * @return True if the axis wraps, false otherwise.
+     */
+    bool isPeriodic(int axis) const { return axes[axis] == DomainBoundary::periodic; }
+
+    /**
+     * @brief Gets the boundaries as integers for the compute shader.
+     *
+     * @return The `BOUNDARY_*` constant per axis.
+     */
+    glm::ivec3 toShader() const { return glm::ivec3((int) axes[0], (int) axes[1], (int) axes[2]); }
+
+    /**
+     * @brief Parses the boundaries of the form `periodic,clamp,clamp` (x, y, z), or a single one for all axes.
+     *
+     * @param text The text to parse, each one `clamp`, `periodic`, `reflect`, or `absorb`.
+     * @param boundaries The boundaries to fill.
+     * @return True if the text is valid, false otherwise.
+     */
+    static bool parse(const std::string& text, DomainBoundaries& boundaries);
+
+    /**
+     * @brief Describes the boundaries for logging.
+     *
+     * @return The boundaries in the format of `parse`.
+     */
+    std::string describe() const;
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_DOMAIN_BOUNDARY_H
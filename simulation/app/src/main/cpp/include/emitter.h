@@ -0,0 +1,116 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_EMITTER_H
+#define LAGRANGIAN_FLUID_SIMULATION_EMITTER_H
+
+#include "glm/glm.hpp"
+#include "particle.h"
+#include "consts.h"
+#include "counter_rng.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @class Emitter
+ * @brief This class represents a continuous source of particles.
+ */
+class Emitter {
+public:
+    /**
+     * @enum Type
+     * @brief The shape of the emitter.
+     */
+    enum class Type {
+        point,  // All particles are emitted at a single point
+        line,   // Particles are emitted uniformly along a segment
+        box,    // Particles are emitted uniformly in an axis-aligned box
+        file    // Particles are emitted in order from positions loaded from a file
+    };
+
+    /**
+     * @brief Constructor.
+     *
+     * @param type The shape of the emitter.
+     * @param a The point (point), the start of the segment (line), or the min. corner of the box (box).
+     * @param b The end of the segment (line), or the max. corner of the box (box). Unused otherwise.
+     * @param rate The number of particles emitted per simulation step.
+     * @param seed The seed of the emitter's random stream.
+     */
+    Emitter(Type type, glm::vec3 a, glm::vec3 b = glm::vec3(0.0f), int rate = 100, uint32_t seed = 0);
+
+    /**
+     * @brief Creates an emitter cycling through the positions stored in a NetCDF file.
+     * The file has the same structure as the one used by `ParticlesHandler::loadPositionsFromFile`.
+     *
+     * @param filePath The path of the file to load from.
+     * @param rate The number of particles emitted per simulation step.
+     * @return The emitter.
+     */
+    static Emitter fromFile(const std::string& filePath, int rate = 100);
+
+    /**
+     * @brief Reads the particle positions stored in a NetCDF file and maps them into the simulation domain.
+     *
+     * @param filePath The path of the file to load from.
+     * @return The positions.
+     */
+    static std::vector<glm::vec3> readPositionsFile(const std::string& filePath);
+
+    /**
+     * @brief Samples the position of the next emitted particle.
+     *
+     * @return The position.
+     */
+    glm::vec3 sample();
+
+    /**
+     * @brief Getter for the emission rate.
+     *
+     * @return The number of particles emitted per simulation step.
+     */
+    int getRate() { return rate; }
+
+private:
+    Type type;
+    glm::vec3 a;
+    glm::vec3 b;
+    int rate;
+    uint32_t seed;
+    uint32_t emitted;  // Number of emitted particles, the counter of the random stream
+
+    std::vector<glm::vec3> positions;  // Positions of a file emitter
+    size_t next;  // Next position of a file emitter
+};
+
+/**
+ * @struct RecyclePolicy
+ * @brief This struct defines when a particle is reclaimed so that its slot can be reused by an emitter.
+ */
+struct RecyclePolicy {
+    bool clamped = false;  // Reclaim particles clamped by the domain boundary
+    float maxAge = 0.0f;  // Reclaim particles older than this (<= 0 disables)
+    bool region = false;  // Reclaim particles outside of [regionMin, regionMax]
+    glm::vec3 regionMin = glm::vec3(-FIELD_WIDTH, -FIELD_HEIGHT, -FIELD_DEPTH);
+    glm::vec3 regionMax = glm::vec3(FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH);
+
+    /**
+     * @brief Checks whether a particle should be reclaimed.
+     *
+     * @param particle The particle to check.
+     * @param wasClamped Whether the particle was clamped in the last step.
+     * @return True if the particle should be reclaimed, false otherwise.
+     */
+    bool shouldRecycle(const Particle& particle, bool wasClamped) const {
+        return (clamped && wasClamped)
+            || (maxAge > 0.0f && particle.age > maxAge)
+            || (region && (glm::any(glm::lessThan(particle.position, regionMin)) || glm::any(glm::greaterThan(particle.position, regionMax))));
+    }
+
+    /**
+     * @brief Checks whether any recycling is enabled.
+     *
+     * @return True if any criterion is enabled, false otherwise.
+     */
+    bool isEnabled() const { return clamped || maxAge > 0.0f || region; }
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_EMITTER_H
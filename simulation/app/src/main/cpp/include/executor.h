@@ -0,0 +1,329 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_EXECUTOR_H
+#define LAGRANGIAN_FLUID_SIMULATION_EXECUTOR_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "cpu_topology.h"
+
+/**
+ * @class Executor
+ * @brief Single set of worker threads shared by all CPU work of the application, with two priority classes.
+ *
+ * Latency-critical tasks (the particle update and other work the current frame waits for) run on every worker
+ * and are always taken first. Background tasks (decoding and uploading time steps) only run on the last
+ * `backgroundLanes` workers, which bounds the I/O concurrency without adding threads on top of the cores.
+ * A long background task calls `Executor::yield` at safe points, which runs the queued latency-critical tasks
+ * on its own thread before resuming, so a frame never waits for a decode to finish.
+ *
+ * With a single lane, all background tasks run in order on the same thread, so a GL context made current by
+ * one background task stays current for the next ones.
+ *
+ * Worker i runs on the i-th fastest core of the topology when pinned, so the background lane lands on a slow core.
+ * On heterogeneous cores, work is split into more chunks than workers (see `getChunkCount`), so that the fast cores
+ * pick up several chunks while a slow core finishes one, instead of the frame waiting for the slowest core.
+ */
+class Executor {
+public:
+    /**
+     * @enum Priority
+     * @brief The priority class of a task.
+     */
+    enum class Priority {
+        critical,   // Work the current frame waits for
+        background  // Work that may take several frames, e.g., I/O
+    };
+
+    /**
+     * @brief Constructor launching the workers.
+     *
+     * @param threads The number of workers, at least one.
+     * @param backgroundLanes The number of workers that may run background tasks, at least one.
+     */
+    Executor(size_t threads, size_t backgroundLanes = 1);
+
+    /**
+     * @brief Constructor launching one worker per core of the topology.
+     *
+     * @param topology The cores of the device.
+     * @param backgroundLanes The number of workers that may run background tasks, at least one.
+     * @param pinWorkers True to pin every worker to its core.
+     */
+    Executor(const CpuTopology& topology, size_t backgroundLanes = 1, bool pinWorkers = false);
+
+    /**
+     * @brief Destructor running the remaining tasks and joining the workers.
+     */
+    ~Executor();
+
+    /**
+     * @brief Submits a task in the given priority class.
+     *
+     * @param priority The priority class of the task.
+     * @param f The function to run.
+     * @param args The arguments to the function.
+     * @return The future of the result of the task.
+     */
+    template<class F, class... Args>
+    auto submit(Priority priority, F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>;
+
+    /**
+     * @brief Submits a latency-critical task, see `submit`.
+     *
+     * @param f The function to run.
+     * @param args The arguments to the function.
+     * @return The future of the result of the task.
+     */
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type> {
+        return submit(Priority::critical, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Waits until all latency-critical tasks are done. Background tasks are awaited through their futures.
+     */
+    void waitForAll();
+
+    /**
+     * @brief Runs the queued latency-critical tasks if called from a background task, does nothing otherwise.
+     * Called at safe points of long background tasks.
+     */
+    static void yield();
+
+    /**
+     * @brief Getter for the number of workers.
+     *
+     * @return The number of workers.
+     */
+    size_t getThreadCount() { return workers.size(); }
+
+    /**
+     * @brief Gets the number of equal chunks to split data-parallel work into.
+     * This is the number of workers on equal cores, and the total capacity in units of the slowest core otherwise,
+     * capped at four chunks per worker.
+     *
+     * @return The number of chunks.
+     */
+    size_t getChunkCount() { return chunkCount; }
+
+    /**
+     * @brief Gets the time every worker spent running tasks since the last call, and resets it.
+     *
+     * @return The busy time per worker in milliseconds.
+     */
+    std::vector<float> takeBusyTimes();
+
+private:
+    /**
+     * @brief Main loop of a worker.
+     *
+     * @param index The index of the worker.
+     * @param lane True if the worker may run background tasks.
+     * @param core The id of the core to pin the worker to, -1 to not pin it.
+     */
+    void work(size_t index, bool lane, int core);
+
+    /**
+     * @brief Runs latency-critical tasks on the calling thread until their queue is empty.
+     */
+    void runCritical();
+
+    /**
+     * @brief Marks a latency-critical task as done.
+     */
+    void finishCritical();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> criticalTasks;
+    std::deque<std::function<void()>> backgroundTasks;
+
+    // Synchronization
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    std::condition_variable criticalDone;
+    size_t criticalCount = 0;  // Queued and running latency-critical tasks
+    bool stop = false;
+
+    size_t chunkCount;
+    std::unique_ptr<std::atomic<uint64_t>[]> busyTimes;  // Nanoseconds spent running tasks per worker
+
+    static thread_local Executor* backgroundOwner;  // Executor of the background task running on this thread
+};
+
+inline thread_local Executor* Executor::backgroundOwner = nullptr;
+
+inline Executor::Executor(size_t threads, size_t backgroundLanes) :
+        Executor(CpuTopology::uniform(threads), backgroundLanes) {}
+
+inline Executor::Executor(const CpuTopology& topology, size_t backgroundLanes, bool pinWorkers) {
+    const std::vector<CpuTopology::Core>& cores = topology.getCores();
+    size_t threads = std::max(cores.size(), (size_t) 1);
+    backgroundLanes = std::clamp(backgroundLanes, (size_t) 1, threads);
+
+    float totalWeight = 0.0f;
+    for (size_t i = 0; i < cores.size(); i++) {
+        totalWeight += topology.getWeight(i);
+    }
+    chunkCount = std::clamp((size_t) std::lround(totalWeight), threads, 4 * threads);
+
+    busyTimes.reset(new std::atomic<uint64_t>[threads]);
+    for (size_t i = 0; i < threads; i++) {
+        busyTimes[i] = 0;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        bool lane = i >= threads - backgroundLanes;
+        int core = pinWorkers && i < cores.size() ? cores[i].id : -1;
+        workers.emplace_back([this, i, lane, core]() { work(i, lane, core); });
+    }
+}
+
+inline Executor::~Executor() {
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+template<class F, class... Args>
+auto Executor::submit(Priority priority, F&& f, Args&&... args)
+-> std::future<typename std::result_of<F(Args...)>::type> {
+    using return_type = typename std::result_of<F(Args...)>::type;
+
+    auto task = std::make_shared<std::packaged_task<return_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    std::future<return_type> res = task->get_future();
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+
+        // Don't allow submitting after stopping the executor
+        if (stop) {
+            throw std::runtime_error("submit on stopped Executor");
+        }
+
+        if (priority == Priority::critical) {
+            criticalTasks.emplace_back([task]() { (*task)(); });
+            criticalCount++;
+        } else {
+            backgroundTasks.emplace_back([task]() { (*task)(); });
+        }
+    }
+    // Only lanes take background tasks, so wake every worker to make sure one of them sees it
+    if (priority == Priority::critical) {
+        condition.notify_one();
+    } else {
+        condition.notify_all();
+    }
+    return res;
+}
+
+inline void Executor::work(size_t index, bool lane, int core) {
+#ifdef __linux__
+    if (core >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        sched_setaffinity(0, sizeof(set), &set);  // Best effort, the worker keeps running unpinned on failure
+    }
+#endif
+
+    for (;;) {
+        std::function<void()> task;
+        bool critical;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            condition.wait(lock, [this, lane]() {
+                return stop || !criticalTasks.empty() || (lane && !backgroundTasks.empty());
+            });
+            critical = !criticalTasks.empty();
+            if (!critical && (!lane || backgroundTasks.empty())) {
+                return;  // Stopped and nothing left for this worker
+            }
+            std::deque<std::function<void()>>& queue = critical ? criticalTasks : backgroundTasks;
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (critical) {
+            task();
+            finishCritical();
+        } else {
+            // Critical tasks run from `yield` count towards the busy time of the background task
+            backgroundOwner = this;
+            task();
+            backgroundOwner = nullptr;
+        }
+        auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        busyTimes[index] += busy.count();
+    }
+}
+
+inline void Executor::runCritical() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (criticalTasks.empty()) return;
+            task = std::move(criticalTasks.front());
+            criticalTasks.pop_front();
+        }
+        task();
+        finishCritical();
+    }
+}
+
+inline void Executor::finishCritical() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (--criticalCount == 0) {
+        criticalDone.notify_all();
+    }
+}
+
+inline void Executor::waitForAll() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    criticalDone.wait(lock, [this]() { return criticalCount == 0; });
+}
+
+inline std::vector<float> Executor::takeBusyTimes() {
+    std::vector<float> times(workers.size());
+    for (size_t i = 0; i < workers.size(); i++) {
+        times[i] = busyTimes[i].exchange(0) / 1.0e6f;
+    }
+    return times;
+}
+
+inline void Executor::yield() {
+    Executor* owner = backgroundOwner;
+    if (owner == nullptr) return;
+
+    // Critical tasks never yield themselves, so clear the owner while running them
+    backgroundOwner = nullptr;
+    owner->runCritical();
+    backgroundOwner = owner;
+}
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_EXECUTOR_H
@@ -0,0 +1,79 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_FIELD_WINDOW_H
+#define LAGRANGIAN_FLUID_SIMULATION_FIELD_WINDOW_H
+
+#include "glm/glm.hpp"
+#include "consts.h"
+
+#include <string>
+
+/**
+ * @struct FieldWindow
+ * @brief A box of grid cells of the dataset (a region of interest), read instead of the full grid.
+ *
+ * The simulated volume `[-FIELD_WIDTH, FIELD_WIDTH] x ...` spans the window, so particles, the sampler, and the
+ * compute shader work in the window without knowing about the dataset around it. Axes are in the order of the
+ * simulation: x (lon), y (lat), z (depth).
+ */
+struct FieldWindow {
+    glm::ivec3 start = glm::ivec3(0);  // First cell of the window
+    glm::ivec3 count = glm::ivec3(0);  // Number of cells per axis, 0 for the rest of the axis
+
+    /**
+     * @brief Checks if the window covers the full dataset, i.e., nothing was restricted.
+     *
+     * @return True if the window is the full dataset, false otherwise.
+     */
+    bool isFull() const { return start == glm::ivec3(0) && count == glm::ivec3(0); }
+
+    /**
+     * @brief Clamps the window to the dataset and replaces the counts of unrestricted axes.
+     *
+     * @param size The number of cells of the dataset per axis.
+     * @return The window with a count of at least two cells per axis (if the dataset has them).
+     */
+    FieldWindow resolve(const glm::ivec3& size) const;
+
+    /**
+     * @brief Grows a resolved window by a number of cells at either side, clamped to the dataset.
+     *
+     * @param low The number of cells to add below the window per axis.
+     * @param high The number of cells to add above the window per axis.
+     * @param size The number of cells of the dataset per axis.
+     * @return The grown window.
+     */
+    FieldWindow expand(const glm::ivec3& low, const glm::ivec3& high, const glm::ivec3& size) const;
+
+    /**
+     * @brief Maps a position in the simulated volume of this (resolved) window to cell coordinates of the dataset.
+     *
+     * @param position The position in simulation units.
+     * @return The position in cells of the dataset.
+     */
+    glm::vec3 toCells(const glm::vec3& position) const;
+
+    /**
+     * @brief Maps cell coordinates of the dataset to a position in the simulated volume of this (resolved) window.
+     *
+     * @param cells The position in cells of the dataset.
+     * @return The position in simulation units.
+     */
+    glm::vec3 fromCells(const glm::vec3& cells) const;
+
+    /**
+     * @brief Parses a window of the form `x0:x1,y0:y1,z0:z1` (half-open cell ranges, empty bounds for the full axis).
+     *
+     * @param text The text to parse, e.g., `120:200,40:90,:`.
+     * @param window The window to fill.
+     * @return True if the text is a valid window, false otherwise.
+     */
+    static bool parse(const std::string& text, FieldWindow& window);
+
+    /**
+     * @brief Describes the window for logging.
+     *
+     * @return The window in the format of `parse`.
+     */
+    std::string describe() const;
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_FIELD_WINDOW_H
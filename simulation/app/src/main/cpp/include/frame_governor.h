@@ -0,0 +1,110 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_FRAME_GOVERNOR_H
+#define LAGRANGIAN_FLUID_SIMULATION_FRAME_GOVERNOR_H
+
+#include <cstddef>
+
+#include "android_logging.h"
+
+/**
+ * @class FrameGovernor
+ * @brief This class adapts the simulated workload to hold a target frame time.
+ *
+ * Every `window` frames, the averaged frame time and stage timings are compared to the budget. Over budget, the
+ * governor first drops sub-steps, then thins the vector field overlay if drawing dominates, and then shrinks the
+ * number of active particles (a prefix of the particle arrays). With headroom, it undoes these in reverse order.
+ * Increasing requires two consecutive windows with headroom, so that a decision is not reverted by the next window.
+ * Every decision is logged.
+ */
+class FrameGovernor {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param targetFrameTime The frame time to hold in milliseconds.
+     * @param maxParticles The number of particles, all of them are active at the start.
+     * @param minParticles The lowest number of active particles.
+     * @param maxSubSteps The highest number of simulation steps per frame.
+     * @param maxFieldStride The highest stride between drawn vector field lines.
+     * @param window The number of frames averaged per decision.
+     */
+    FrameGovernor(float targetFrameTime, size_t maxParticles, size_t minParticles = 1000, int maxSubSteps = 4, int maxFieldStride = 4, int window = 30);
+
+    /**
+     * @brief Records the timings of a frame, and adapts the workload at the end of every window.
+     *
+     * @param frameTime The time since the previous frame in milliseconds.
+     * @param simulateTime The time spent simulating the particles in milliseconds.
+     * @param drawTime The time spent drawing in milliseconds.
+     */
+    void recordFrame(float frameTime, float simulateTime, float drawTime);
+
+    /**
+     * @brief Getter for the number of particles to simulate and draw.
+     *
+     * @return The number of active particles.
+     */
+    size_t getActiveParticles() { return activeParticles; }
+
+    /**
+     * @brief Getter for the number of simulation steps per frame.
+     *
+     * @return The number of sub-steps.
+     */
+    int getSubSteps() { return subSteps; }
+
+    /**
+     * @brief Getter for the stride between drawn vector field lines.
+     *
+     * @return The stride, 1 draws every line.
+     */
+    int getFieldStride() { return fieldStride; }
+
+private:
+    /**
+     * @brief Lowers the workload by one step.
+     *
+     * @param simulateTime The averaged simulation time in milliseconds.
+     * @param drawTime The averaged draw time in milliseconds.
+     * @return True if the workload was lowered, false if it is at its minimum.
+     */
+    bool decrease(float simulateTime, float drawTime);
+
+    /**
+     * @brief Raises the workload by one step.
+     *
+     * @param workTime The averaged simulation and draw time in milliseconds.
+     * @return True if the workload was raised, false if it is at its maximum.
+     */
+    bool increase(float workTime);
+
+    /**
+     * @brief Logs the current workload after a decision.
+     *
+     * @param reason The reason of the decision.
+     * @param frameTime The averaged frame time in milliseconds.
+     * @param workTime The averaged simulation and draw time in milliseconds.
+     */
+    void logDecision(const char* reason, float frameTime, float workTime);
+
+    float targetFrameTime;
+    size_t maxParticles;
+    size_t minParticles;
+    int maxSubSteps;
+    int maxFieldStride;
+    int window;
+
+    // Current workload
+    size_t activeParticles;
+    int subSteps = 1;
+    int fieldStride = 1;
+
+    // Timings of the current window
+    int numFrames = 0;
+    float frameTimeSum = 0.0f;
+    float simulateTimeSum = 0.0f;
+    float drawTimeSum = 0.0f;
+    int headroomWindows = 0;  // Consecutive windows with headroom
+    bool atMinimum = false;  // True if the minimum workload is already logged
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_FRAME_GOVERNOR_H
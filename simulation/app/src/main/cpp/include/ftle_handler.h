@@ -0,0 +1,161 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_FTLE_HANDLER_H
+#define LAGRANGIAN_FLUID_SIMULATION_FTLE_HANDLER_H
+
+#include "glm/glm.hpp"
+#include "particle.h"
+#include "physics.h"
+#include "mainview.h"
+#include "executor.h"
+#include "consts.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @class FTLEHandler
+ * @brief This class computes the finite-time Lyapunov exponent (FTLE) field of the loaded vector field.
+ *
+ * A regular lattice of tracers is advected with `Physics::advectionStep` over a fixed time horizon. The
+ * gradient of the resulting flow map is approximated by finite differences on the lattice, and the FTLE
+ * of each lattice point is derived from the largest eigenvalue of the Cauchy-Green deformation tensor.
+ *
+ * @note The integration starts at the current `global_time_in_step` and advances the time of the field by `dt`
+ * every step, so the lattice follows the time-dependent flow. Only the two time steps in use are interpolated:
+ * beyond the next time step the field is held at it, which is logged when the horizon reaches past it.
+ */
+class FTLEHandler {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param physics The physics object used for the integration.
+     * @param width The number of lattice points in the X axis.
+     * @param height The number of lattice points in the Y axis.
+     * @param depth The number of lattice points in the Z axis.
+     * @param horizon The integration time horizon (in simulation time units).
+     */
+    FTLEHandler(Physics& physics, int width = 128, int height = 128, int depth = 1, float horizon = 10.0f);
+
+    /**
+     * @brief Seeds the regular lattice over the simulation domain.
+     */
+    void seedLattice();
+
+    /**
+     * @brief Computes the FTLE field on the CPU, splitting the lattice in chunks over the executor.
+     *
+     * @param executor The executor to use.
+     * @param threadCount The number of chunks to split the lattice into.
+     */
+    void computeFTLE(Executor& executor, size_t threadCount);
+
+    /**
+     * @brief Computes the FTLE field using the compute shaders.
+     *
+     * @param mainview The view owning the compute shader programs.
+     */
+    void computeFTLE(Mainview& mainview);
+
+    /**
+     * @brief Writes the FTLE field into a NetCDF file.
+     *
+     * @param filePath The path of the file to write to.
+     */
+    void exportToFile(const std::string& filePath);
+
+    /**
+     * @brief Getter for the FTLE field (x-fastest, then y, then z).
+     *
+     * @return A reference to the flat vector of FTLE values.
+     */
+    std::vector<float>& getField() { return ftleField; };
+
+    /**
+     * @brief Getter for the lattice positions (3 floats per lattice point).
+     *
+     * @return A reference to the flat vector of lattice positions.
+     */
+    std::vector<float>& getLatticePositions() { return latticePos; };
+
+    /**
+     * @brief Setter for the integration time horizon.
+     *
+     * @param horizon The new time horizon.
+     */
+    void setHorizon(float horizon) { this->horizon = horizon; };
+
+    /**
+     * @brief Getter for the lattice width.
+     *
+     * @return The number of lattice points in the X axis.
+     */
+    int getWidth() { return width; };
+
+    /**
+     * @brief Getter for the lattice height.
+     *
+     * @return The number of lattice points in the Y axis.
+     */
+    int getHeight() { return height; };
+
+    /**
+     * @brief Getter for the lattice depth.
+     *
+     * @return The number of lattice points in the Z axis.
+     */
+    int getDepth() { return depth; };
+
+private:
+    /**
+     * @brief Advects the lattice points in the range [start, end) over the full horizon.
+     *
+     * @param startTime The time of the field at the start of the horizon.
+     */
+    void advectRange(size_t start, size_t end, float startTime);
+
+    /**
+     * @brief Logs if the horizon reaches past the next time step, where the field is held.
+     *
+     * @param startTime The time of the field at the start of the horizon.
+     */
+    void checkHorizon(float startTime);
+
+    /**
+     * @brief Computes the FTLE of the lattice points in the range [start, end) from the flow map.
+     */
+    void ftleRange(size_t start, size_t end);
+
+    /**
+     * @brief Gets the largest eigenvalue of a symmetric 3x3 matrix.
+     *
+     * @param C The symmetric matrix.
+     * @return The largest eigenvalue.
+     */
+    static float largestEigenvalue(const glm::mat3& C);
+
+    /**
+     * @brief Gets the number of integration steps of the horizon.
+     */
+    int numSteps();
+
+    /**
+     * @brief Gets the number of lattice points.
+     */
+    size_t numPoints() { return latticePos.size() / 3; };
+
+    Physics& physics;
+
+    // Lattice dimensions
+    int width;
+    int height;
+    int depth;
+    glm::vec3 spacing;
+
+    float horizon;
+
+    std::vector<float> latticePos;  // Initial lattice positions (3 floats per point)
+    std::vector<float> flowMap;  // Advected lattice positions (3 floats per point)
+    std::vector<float> ftleField;
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_FTLE_HANDLER_H
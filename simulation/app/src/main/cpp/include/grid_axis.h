@@ -0,0 +1,140 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_GRID_AXIS_H
+#define LAGRANGIAN_FLUID_SIMULATION_GRID_AXIS_H
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * @class GridAxis
+ * @brief Maps positions along one axis of the simulated volume to (fractional) node indices of the loaded grid.
+ *
+ * On a uniform axis the mapping is linear. On a stretched axis (e.g., thin near-surface depth levels) the simulated
+ * volume is linear in the coordinate of the axis (lon, lat, or depth), and the node index is found in O(1) through a
+ * table of uniform bins holding the node at their start, finer than the smallest spacing, so that at most one step to
+ * the next node remains (more if the number of bins is capped for very fine axes). The compute shader runs the same
+ * lookup on the packed axis (see `pack`).
+ */
+class GridAxis {
+public:
+    /**
+     * @brief Sets up a uniform axis.
+     *
+     * @param origin The node index of the low side of the simulated volume.
+     * @param extent The number of nodes the simulated volume spans.
+     */
+    void setUniform(float origin, float extent);
+
+    /**
+     * @brief Sets up the axis from the coordinates of the loaded nodes, uniform if they are evenly spaced.
+     *
+     * @param coordinates The coordinate of every node, monotonic (ascending or descending).
+     * @param origin The node index of the low side of the simulated volume.
+     * @param extent The number of nodes the simulated volume spans.
+     */
+    void build(const std::vector<float>& coordinates, float origin, float extent);
+
+    /**
+     * @brief Checks if the axis maps linearly.
+     *
+     * @return True if the axis is uniform, false if it is stretched.
+     */
+    bool isUniform() const { return uniform; }
+
+    /**
+     * @brief Maps a position of the simulated volume to a node index.
+     *
+     * @param t The position, 0 at the low and 1 at the high side of the simulated volume.
+     * @return The fractional node index, extrapolated outside of the nodes.
+     */
+    float toIndex(float t) const {
+        if (uniform) return origin + t * extent;
+
+        float coordinate = low + t * (high - low);
+        int bin = (int) (t * (float) numBins);
+        bin = bin < 0 ? 0 : (bin >= numBins ? numBins - 1 : bin);
+        int node = bins[bin];
+        int last = (int) coordinates.size() - 2;
+        while (node < last && coordinate >= coordinates[node + 1]) node++;
+        return (float) node + (coordinate - coordinates[node]) / (coordinates[node + 1] - coordinates[node]);
+    }
+
+    /**
+     * @brief Maps a node index to a position of the simulated volume, the inverse of `toIndex`.
+     *
+     * @param index The fractional node index.
+     * @return The position, 0 at the low and 1 at the high side of the simulated volume.
+     */
+    float toPosition(float index) const;
+
+    /**
+     * @brief Getter for the node index of the low side of the simulated volume.
+     *
+     * @return The origin.
+     */
+    float getOrigin() const { return origin; }
+
+    /**
+     * @brief Getter for the number of nodes the simulated volume spans.
+     *
+     * @return The extent.
+     */
+    float getExtent() const { return extent; }
+
+    /**
+     * @brief Appends the coordinates and the bins of a stretched axis for the compute shader.
+     *
+     * @param data The buffer to append to, the bins are stored as floats after the coordinates.
+     * @return The offset of the axis in the buffer.
+     */
+    int pack(std::vector<float>& data) const;
+
+    /**
+     * @brief Getter for the number of nodes of a stretched axis.
+     *
+     * @return The number of nodes.
+     */
+    int getNumNodes() const { return (int) coordinates.size(); }
+
+    /**
+     * @brief Getter for the number of bins of a stretched axis.
+     *
+     * @return The number of bins, 0 on a uniform axis.
+     */
+    int getNumBins() const { return uniform ? 0 : numBins; }
+
+    /**
+     * @brief Getter for the coordinate of the low side of the simulated volume (ascending, see `build`).
+     *
+     * @return The coordinate.
+     */
+    float getLow() const { return low; }
+
+    /**
+     * @brief Getter for the coordinate of the high side of the simulated volume (ascending, see `build`).
+     *
+     * @return The coordinate.
+     */
+    float getHigh() const { return high; }
+
+private:
+    /**
+     * @brief Interpolates the coordinate at a node index, extrapolating the outer spacings.
+     *
+     * @param index The fractional node index.
+     * @return The coordinate.
+     */
+    float coordinateAt(float index) const;
+
+    bool uniform = true;
+    float origin = 0.0f;
+    float extent = 1.0f;
+
+    // Stretched axes only
+    std::vector<float> coordinates;  // Ascending, descending coordinates are negated
+    std::vector<int32_t> bins;  // Last node at or below the start of every bin
+    int numBins = 0;
+    float low = 0.0f;
+    float high = 1.0f;
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_GRID_AXIS_H
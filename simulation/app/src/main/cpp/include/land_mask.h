@@ -0,0 +1,187 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_LAND_MASK_H
+#define LAGRANGIAN_FLUID_SIMULATION_LAND_MASK_H
+
+#include "glm/glm.hpp"
+#include "consts.h"
+#include "android_logging.h"
+#include "grid_axis.h"
+
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cmath>
+
+/**
+ * @class LandMask
+ * @brief This class holds the land/sea mask of the loaded vector field and its signed distance field.
+ *
+ * Land cells are the cells holding fill values in the NetCDF velocity data. The signed distance field
+ * (positive in the sea, negative on land, in simulation units) and its normalized gradient are precomputed
+ * once, so that the coastline test and the reflection of a particle are a single trilinear sample.
+ */
+class LandMask {
+public:
+    /**
+     * @enum BoundaryMode
+     * @brief What happens to a particle that is advected onto land.
+     */
+    enum class BoundaryMode {
+        stop,     // The particle stays at its previous (sea) position
+        reflect   // The particle is mirrored back into the sea along the coastline normal
+    };
+
+    /**
+     * @brief Constructor.
+     *
+     * @param boundaryMode What happens to a particle that is advected onto land.
+     */
+    LandMask(BoundaryMode boundaryMode = BoundaryMode::stop);
+
+    /**
+     * @brief Builds the mask from the velocity data and precomputes the signed distance field.
+     *
+     * @param uData The u data, land cells hold `fillValue` (or NaN).
+     * @param fillValue The fill value of the data.
+     * @param width The width of the grid.
+     * @param height The height of the grid.
+     * @param depth The depth of the grid.
+     * @param axes The mapping of the simulated volume to the grid per axis, see `VectorFieldHandler::getGridAxes`.
+     * @param wrap 1 along periodic axes, where the mask wraps around like the velocity sampling.
+     */
+    void build(const std::vector<float>& uData, float fillValue, int width, int height, int depth, const std::array<GridAxis, 3>& axes,
+               const glm::ivec3& wrap = glm::ivec3(0));
+
+    /**
+     * @brief Drops the mask, e.g., when the grid changes. Keeps the boundary mode.
+     */
+    void reset();
+
+    /**
+     * @brief Checks whether a value is a fill value, i.e., marks a land cell.
+     *
+     * @param value The value to check.
+     * @param fillValue The fill value of the data.
+     * @return True if the value is a fill value, false otherwise.
+     */
+    static bool isFill(float value, float fillValue) { return value != value || value == fillValue || std::abs(value) > 1.0e10f; }
+
+    /**
+     * @brief Samples the signed distance field and its gradient at the given position.
+     *
+     * @param position The position to sample at.
+     * @return The normalized gradient (xyz) and the signed distance (w).
+     */
+    glm::vec4 sample(const glm::vec3& position) const;
+
+    /**
+     * @brief Resolves a particle that was advected onto land, either by stopping or reflecting it.
+     * Particles in the sea are left untouched without branching.
+     *
+     * @param position The position after the step, modified in place.
+     * @param previous The position before the step.
+     */
+    void resolve(glm::vec3& position, const glm::vec3& previous) const;
+
+    /**
+     * @brief Checks whether the mask contains any land.
+     *
+     * @return True if there are land cells, false otherwise.
+     */
+    bool hasLand() const { return numLand > 0; }
+
+    /**
+     * @brief Checks whether the mask has been built.
+     *
+     * @return True if the mask was built, false otherwise.
+     */
+    bool isBuilt() const { return built; }
+
+    /**
+     * @brief Gets the sea factor of a grid cell.
+     *
+     * @param index The index of the cell.
+     * @return 0 for land cells, 1 for sea cells.
+     */
+    float seaFactor(int index) const { return built ? (float) !land[index] : 1.0f; }
+
+    /**
+     * @brief Getter for the signed distance field data (normalized gradient and distance, 4 floats per cell).
+     *
+     * @return A reference to the flat vector of the signed distance field.
+     */
+    const std::vector<float>& getDistanceField() const { return distanceField; }
+
+    /**
+     * @brief Getter for the boundary mode.
+     *
+     * @return The boundary mode.
+     */
+    BoundaryMode getBoundaryMode() const { return boundaryMode; }
+
+    /**
+     * @brief Setter for the boundary mode.
+     *
+     * @param boundaryMode What happens to a particle that is advected onto land.
+     */
+    void setBoundaryMode(BoundaryMode boundaryMode) { this->boundaryMode = boundaryMode; }
+
+private:
+    /**
+     * @brief Gets the two cells to interpolate between along an axis, the last cell of a periodic axis is
+     * interpolated with the first one (mirrors `VectorFieldHandler::cornerCells`).
+     *
+     * @param axis The axis, 0 for x.
+     * @param fGrid The grid coordinate along the axis.
+     * @param size The number of cells along the axis.
+     * @param low Set to the lower cell.
+     * @param high Set to the upper cell.
+     * @return The interpolation weight of the upper cell.
+     */
+    float cornerCells(int axis, float fGrid, int size, int& low, int& high) const {
+        int base = std::max(-wrap[axis], std::min((int) std::floor(fGrid), size - 2 + wrap[axis]));
+        low = base + (base < 0) * size;
+        high = base + 1 - (base + 1 >= size) * size;
+        return std::clamp(fGrid - (float) base, 0.0f, 1.0f);
+    }
+
+    /**
+     * @brief Computes the squared Euclidean distance transform of a sampled 1D function (Felzenszwalb & Huttenlocher, 2012).
+     *
+     * @param f The function values, replaced by the transform.
+     * @param n The number of samples.
+     * @param h The spacing of the samples.
+     * @param v Scratch space for the parabola locations (n ints).
+     * @param z Scratch space for the parabola boundaries (n + 1 floats).
+     * @param d Scratch space for the result (n floats).
+     */
+    static void distanceTransform1D(float* f, int n, float h, int* v, float* z, float* d);
+
+    /**
+     * @brief Computes the distance to the nearest feature cell for every cell of the grid.
+     * Along periodic axes the distance is measured around the seam.
+     *
+     * @param feature 1 for feature cells, 0 otherwise.
+     * @return The Euclidean distances in simulation units.
+     */
+    std::vector<float> distanceTransform(const std::vector<uint8_t>& feature);
+
+    BoundaryMode boundaryMode;
+    bool built;
+    size_t numLand;
+
+    // Dimensions of the grid
+    int width;
+    int height;
+    int depth;
+
+    // Mapping of the simulated volume to the grid, see `VectorFieldHandler::getGridAxes`
+    std::array<GridAxis, 3> axes;
+
+    glm::ivec3 wrap;  // 1 along periodic axes, see `cornerCells`
+
+    std::vector<uint8_t> land;  // 1 for land cells, 0 for sea cells
+    std::vector<float> distanceField;  // Normalized gradient (xyz) and signed distance (w) per cell
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_LAND_MASK_H
@@ -9,6 +9,7 @@
 #include <string>
 #include <chrono>
 #include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <android/asset_manager.h>
@@ -16,12 +17,20 @@
 #include <sstream>
 #include <vector>
 #include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
 
 #include "android_logging.h"
 #include "consts.h"
 #include "transforms.h"
 #include "shaderManager.h"
 #include "navig_cube.h"
+#include "emitter.h"
+#include "land_mask.h"
+#include "grid_axis.h"
+#include "domain_boundary.h"
+#include "physics_constants.h"
 
 
 /**
@@ -34,8 +43,9 @@ public:
      * @brief Constructor
      *
      * @param assetManager A pointer to the asset manager.
+     * @param shaderCacheDir The directory to persist the linked shader program binaries in, empty to disable the cache.
      */
-    Mainview(AAssetManager* assetManager);
+    Mainview(AAssetManager* assetManager, const std::string& shaderCacheDir = "");
 
     /**
      * @brief Destructor
@@ -76,14 +86,16 @@ public:
     /**
      * @brief Creates a buffer for the particles.
      *
-     * @param particlesPos A reference to the flat vector of particle positions (3 floats per particle).
+     * @param particlesPos A reference to the flat vector of particle positions and ages (`PARTICLE_STRIDE` floats per particle).
+     * @param capacity The number of particle slots to allocate, slots beyond the given particles are free
+     * and filled by the GPU emission once the free list runs empty. Defaults to the number of particles.
      */
-    void createParticlesBuffer(std::vector<float>& particlesPos);
+    void createParticlesBuffer(std::vector<float>& particlesPos, size_t capacity = 0);
 
     /**
      * @brief Loads particle data.
      *
-     * @param particlesPos A reference to the flat vector of particle positions.
+     * @param particlesPos A reference to the flat vector of particle positions and ages (`PARTICLE_STRIDE` floats per particle).
      */
     void loadParticlesData(std::vector<float>& particlesPos);
 
@@ -100,8 +112,11 @@ public:
      * @param vector_field0 A reference to the previous vector field.
      * @param vector_field1 A reference to the next vector field.
      * @param vector_field2 A reference to the vector field to be loaded next.
+     * @param dims The dimensions of the vector field grid.
+     *
+     * @note With `FieldStorage::textures` the fields are also uploaded into 3D textures.
      */
-    void createComputeBuffer(std::vector<float>& vector_field0, std::vector<float>& vector_field1, std::vector<float>& vector_field2);
+    void createComputeBuffer(std::vector<float>& vector_field0, std::vector<float>& vector_field1, std::vector<float>& vector_field2, glm::ivec3 dims);
 
     /**
      * @brief Loads constant uniforms.
@@ -113,6 +128,62 @@ public:
      */
     void loadConstUniforms(float dt, int width, int height, int depth);
 
+    /**
+     * @brief Sets the part of the field grid spanned by the simulated volume, e.g., a window with a halo of cells.
+     * Applies to the constant uniforms loaded afterwards.
+     *
+     * @param origin The grid coordinates of the low corner of the simulated volume.
+     * @param extent The number of cells the simulated volume spans per axis.
+     */
+    void setGridMapping(const glm::vec3& origin, const glm::vec3& extent) { gridOrigin = origin; gridExtent = extent; }
+
+    /**
+     * @brief Sets what happens to particles leaving the simulated volume per axis, and wraps the field sampling around
+     * periodic axes. Applies to the field textures and the constant uniforms created and loaded afterwards.
+     *
+     * @param boundaries The boundaries, see `ParticlesHandler::setDomainBoundaries`.
+     */
+    void setDomainBoundaries(const DomainBoundaries& boundaries) { domainBoundaries = boundaries; }
+
+    /**
+     * @brief Picks the fastest workgroup size of the particle compute shader for this device.
+     * Every candidate is timed on a scratch copy of the particle buffer, the fastest program replaces the default one.
+     *
+     * @param dt Simulation time step.
+     * @param dims The dimensions of the vector field grid.
+     * @note Must be called after the particle and compute buffers are created and before the other uniforms are loaded.
+     */
+    void calibrateWorkgroupSize(float dt, glm::ivec3 dims);
+
+    /**
+     * @brief Describes the dispatch parameters of the particle compute shader for the profiler.
+     *
+     * @return The description.
+     */
+    std::string getDispatchInfo();
+
+    /**
+     * @brief Describes the render path of the particles and vector field for the profiler.
+     *
+     * @return The description.
+     */
+    std::string getRenderInfo();
+
+    /**
+     * @brief Starts measuring the GPU time of the draw calls of a frame.
+     * @note Without `GL_EXT_disjoint_timer_query` the measurement is skipped.
+     */
+    void beginDrawTiming();
+
+    /**
+     * @brief Stops measuring the GPU time of the draw calls of a frame.
+     * The result becomes available a frame later, so the time of the previous frame is returned.
+     *
+     * @param drawTime Set to the draw time of the previous frame in milliseconds.
+     * @return True if a draw time was available, false otherwise.
+     */
+    bool endDrawTiming(float& drawTime);
+
     /**
      * @brief Loads a compute buffer (not used for rendering) with new data so that it can be
      * efficiently swapped when required.
@@ -130,9 +201,129 @@ public:
 
     /**
      * @brief Dispatches the compute shader to update the particle positions.
+     * The number of workgroups is read from the GPU-side dispatch arguments, which cover all used particle slots.
      */
     void dispatchComputeShader();
 
+    /**
+     * @brief Limits the compute shader and the drawing to a prefix of the particle slots.
+     *
+     * @param count The number of active particle slots, SIZE_MAX for all of them.
+     */
+    void setActiveParticles(size_t count) { activeParticles = count; }
+
+    /**
+     * @brief Seeds the particle buffer with uniformly distributed positions using the compute shaders.
+     * The positions are bit-identical to the ones of `ParticlesHandler::InitType::uniform` on the CPU.
+     *
+     * @param seed The seed of the random initialization.
+     */
+    void seedParticles(uint32_t seed);
+
+    /**
+     * @brief Loads the recycling policy into the compute shader.
+     *
+     * @param policy The recycling policy.
+     */
+    void loadRecyclePolicy(const RecyclePolicy& policy);
+
+    /**
+     * @brief Creates the land mask buffer used by the compute shader to keep the particles off land.
+     *
+     * @param mask A reference to the land mask.
+     */
+    void createLandMaskBuffer(const LandMask& mask);
+
+    /**
+     * @brief Creates the brick table buffer of the sparse field storage (`FieldStorage::bricks`).
+     *
+     * @param table The index of the stored brick for every brick of the grid, -1 for bricks of land only.
+     */
+    void createBrickTableBuffer(const std::vector<int32_t>& table);
+
+    /**
+     * @brief Creates the buffer of the stretched axes of the field grid, looked up by the compute shader like
+     * `GridAxis::toIndex`. Applies to the constant uniforms loaded afterwards.
+     *
+     * @param axes The axes x (lon), y (lat), and z (depth), see `VectorFieldHandler::getGridAxes`.
+     */
+    void createGridAxesBuffer(const std::array<GridAxis, 3>& axes);
+
+    /**
+     * @brief Loads the constants of the particle model into the uniform buffer shared by the compute shaders.
+     *
+     * @param constants The constants of the particle model.
+     */
+    void loadPhysicsConstants(const PhysicsConstants& constants);
+
+    /**
+     * @brief Creates the buffer holding the velocity and acceleration of every particle slot for the inertial models.
+     * With the advection model the buffer is a minimal placeholder.
+     *
+     * @param state A reference to the flat vector of particle states (`PARTICLE_STATE_STRIDE` floats per particle).
+     * @note Must be called after the particle buffer is created.
+     */
+    void createParticleStateBuffer(std::vector<float>& state);
+
+    /**
+     * @brief Replaces the GPU particle slots by the CPU ones when switching to the compute shaders.
+     * All slots count as used, the free ones are handed to the GPU free list.
+     *
+     * @param particlesPos A reference to the flat vector of particle positions and ages.
+     * @param state A reference to the flat vector of particle states (only used by the inertial models).
+     * @param freeSlots The indices of the free slots.
+     */
+    void uploadParticleSlots(std::vector<float>& particlesPos, std::vector<float>& state, const std::vector<size_t>& freeSlots);
+
+    /**
+     * @brief Reads the GPU particle slots back when switching from the compute shaders to the CPU.
+     *
+     * @param particlesPos A reference to the vector to write the positions and ages to, resized to the particle buffer.
+     * @param state A reference to the vector to write the particle states to (only written by the inertial models).
+     */
+    void readParticleSlots(std::vector<float>& particlesPos, std::vector<float>& state);
+
+    /**
+     * @brief Advances a set of particles with the particle compute shader, without recycling them.
+     * Used to cross-check the GPU physics against the CPU implementation.
+     *
+     * @param particlesPos A reference to the flat vector of particle positions and ages (`PARTICLE_STRIDE` floats per particle), updated in place.
+     * @param state A reference to the flat vector of particle states (`PARTICLE_STATE_STRIDE` floats per particle), updated in place.
+     * @param steps The number of integration steps.
+     */
+    void stepParticles(std::vector<float>& particlesPos, std::vector<float>& state, int steps);
+
+    /**
+     * @brief Appends newly emitted particles into free slots of the particle buffer using the compute shaders.
+     * Particles that do not fit into the free slots are dropped.
+     *
+     * @param emittedPos A reference to the flat vector of emitted positions (3 floats per particle).
+     */
+    void emitParticles(std::vector<float>& emittedPos);
+
+    /**
+     * @brief Computes the FTLE field of a lattice using the compute shaders.
+     * The lattice is advected by the particle compute shader while the time of the field advances, the FTLE is
+     * then derived from the flow map.
+     *
+     * @param latticePos A reference to the flat vector of initial lattice positions (3 floats per point).
+     * @param ftleField A reference to the vector to store the FTLE values in (1 float per point).
+     * @param dims The lattice dimensions.
+     * @param spacing The lattice spacing in each axis.
+     * @param steps The number of integration steps.
+     * @param horizon The integration time horizon.
+     */
+    void computeFTLE(std::vector<float>& latticePos, std::vector<float>& ftleField, glm::ivec3 dims, glm::vec3 spacing, int steps, float horizon);
+
+    /**
+     * @brief Bins the particles of the particle buffer into a regular grid using the compute shaders.
+     *
+     * @param counts A reference to the vector to store the number of particles per cell in.
+     * @param dims The grid dimensions.
+     * @return The number of binned particles.
+     */
+    size_t computeDensity(std::vector<uint32_t>& counts, glm::ivec3 dims);
+
     /**
      * @brief Getter for the object defining the view transformations.
      *
@@ -152,6 +343,64 @@ private:
      */
     void loadUniforms();
 
+    /**
+     * @brief (Re)allocates the GPU free list of particle slots, i.e., marks all slots as used.
+     *
+     * @param numParticles The number of particle slots.
+     */
+    void resetFreeList(size_t numParticles);
+
+    /**
+     * @brief Resets the indirect dispatch arguments of the particle compute shader.
+     *
+     * @param numSlots The number of particle slots in use.
+     */
+    void resetDispatchArgs(size_t numSlots);
+
+    /**
+     * @brief Loads the constant uniforms into a particle compute shader program.
+     *
+     * @param program The program.
+     * @param dt Simulation time step.
+     * @param width The width simulation dimension.
+     * @param height The height simulation dimension.
+     * @param depth The depth simulation dimension.
+     */
+    void loadComputeConstUniforms(GLuint program, float dt, int width, int height, int depth);
+
+    /**
+     * @brief Creates a zeroed particle state buffer for a scratch set of particles.
+     *
+     * @param numParticles The number of particles.
+     * @return The buffer, owned by the caller.
+     */
+    GLuint createScratchStateBuffer(size_t numParticles);
+
+    /**
+     * @brief Advances a scratch set of particles with the particle compute shader, with the recycling disabled.
+     *
+     * @param particlesSSBO The buffer of the particle positions and ages.
+     * @param stateSSBO The buffer of the particle states.
+     * @param numParticles The number of particles.
+     * @param steps The number of integration steps.
+     * @param timeStep The time the field advances by per step, starting at `global_time_in_step` and held at the
+     * next time step, 0 to sample every step at `global_time_in_step`.
+     */
+    void advectScratch(GLuint particlesSSBO, GLuint stateSSBO, size_t numParticles, int steps, float timeStep);
+
+    /**
+     * @brief Uploads the velocities of a vector field into a 3D texture (RGBA, one texel per grid cell).
+     *
+     * @param texture The texture to upload into, allocated by `createComputeBuffer`.
+     * @param vector_field A reference to the vector field vertices (start and end point per cell).
+     */
+    void uploadFieldTexture(GLuint texture, std::vector<float>& vector_field);
+
+    /**
+     * @brief Binds the vector field textures of the current and next time step to the compute shader.
+     */
+    void bindFieldTextures();
+
     ShaderManager *shaderManager;
     Transforms *transforms;
     NavigCube *navigCube;
@@ -164,16 +413,55 @@ private:
     GLint modelLocationPoints;
     GLint viewLocationPoints;
     GLint projectionLocationPoints;
+    GLint mvpLocationPoints;
+    GLint mvpLocationLines;
     GLint globalTimeInStepLocation;
+    GLint recycleClampedLocation;
+    GLint activeParticlesLocation;
 
     // Buffers
     GLuint particleVBO;
     GLuint particleVAO;
+    size_t particleBufferSize;  // Number of floats in the particle buffer
+    size_t numParticleSlots = 0;  // Number of particle slots in use when the buffer was (re)filled
+    size_t activeParticles = SIZE_MAX;  // Number of particle slots simulated and drawn
+    GLuint dispatchArgsSSBO;
+    int localSize = DEFAULT_LOCAL_SIZE;  // Workgroup size of the particle compute shader
+    GLuint freeListSSBO;
+    GLuint emittedSSBO;
+    GLuint landMaskSSBO = 0;
+    GLuint brickTableSSBO = 0;
+    GLuint gridAxesSSBO = 0;
+    GLuint particleStateSSBO = 0;
+    GLuint physicsUBO = 0;
+    bool inertialModel = false;  // Whether the particle model keeps a velocity and acceleration per particle
+    bool recycleClamped = false;
+    bool recycleRegion = false;
+    float recycleMaxAge = 0.0f;
     GLuint vectorFieldVBO;
     GLuint vectorFieldVAO;
     GLuint computeVectorField0SSBO;
     GLuint computeVectorField1SSBO;
     GLuint computeVectorField2SSBO;
+    GLuint fieldTexture0 = 0;
+    GLuint fieldTexture1 = 0;
+    GLuint fieldTexture2 = 0;
+    GLenum fieldTextureFormat = GL_RGBA16F;
+    glm::ivec3 fieldDims = glm::ivec3(0);
+    glm::vec3 gridOrigin = glm::vec3(0.0f);
+    glm::vec3 gridExtent = glm::vec3(0.0f);  // 0 for the full grid
+    glm::ivec3 axisNodes = glm::ivec3(0);  // Nodes of every stretched axis
+    glm::ivec3 axisBins = glm::ivec3(0);  // Lookup bins of every axis, 0 for a uniform axis
+    glm::ivec3 axisOffset = glm::ivec3(0);  // Offset of every stretched axis in the buffer
+    glm::vec3 axisLow = glm::vec3(0.0f);  // Coordinate of the low side of the simulated volume per stretched axis
+    glm::vec3 axisHigh = glm::vec3(1.0f);
+    DomainBoundaries domainBoundaries;
+    std::vector<float> fieldTexels;  // Staging memory for the texture uploads
+
+    bool drawTimingSupported = false;
+    GLuint drawTimeQueries[2] = {0, 0};  // Alternating, so that the previous frame's result can be read without stalling
+    int drawTimeQueryIndex = 0;
+    bool drawTimeQueryIssued[2] = {false, false};  // A query may only be polled once it was begun and ended
 };
 
 #endif // GL_SHADER_MANAGER_H
@@ -30,6 +30,7 @@ public:
     glm::vec3 position;
     glm::vec3 velocity;
     glm::vec3 acceleration;
+    float age;  // Simulation time since the particle was seeded or emitted
 };
 
 #endif // PARTICLE_H
\ No newline at end of file
@@ -6,19 +6,27 @@
 #define LAGRANGIAN_FLUID_SIMULATION_PARTICLES_HANDLER_H
 
 #include "particle.h"
+#if !HEADLESS
 #include "mainview.h"
+#endif
 #include "physics.h"
 #include "vector_field_handler.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
-#include "ThreadPool.h"
+#include "executor.h"
+#include "emitter.h"
+#include "domain_boundary.h"
+#include "counter_rng.h"
 
 #include <stdio.h>
 #include <vector>
 #include <algorithm>
 #include <thread>
+#include <functional>
 
+#if !HEADLESS
 #include "netcdf_reader.h"
+#endif
 
 /**
  * @class ParticlesHandler
@@ -42,17 +50,20 @@ public:
      *
      * @param type The type of initialization.
      * @param physics The physics object.
+     * @param executor The executor running the CPU particle updates.
      * @param num The number of particles.
+     * @param seed The seed of the random initializations.
      */
-    ParticlesHandler(InitType type, Physics& physics, int num = 100);  // Constructor with initialization
+    ParticlesHandler(InitType type, Physics& physics, Executor& executor, int num = 100, uint32_t seed = 112358);  // Constructor with initialization
 
     /**
      * @brief Constructor without initialization (for loading from file).
      *
      * @param physics The physics object.
+     * @param executor The executor running the CPU particle updates.
      * @param num The number of particles.
      */
-    ParticlesHandler(Physics& physics, int num = 100);  // Constructor without initialization (for loading from file)
+    ParticlesHandler(Physics& physics, Executor& executor, int num = 100);  // Constructor without initialization (for loading from file)
 
     /**
      * @brief Initializes the particles with the given type of initialization.
@@ -62,20 +73,30 @@ public:
     void initParticles(InitType type);
 
     /**
-     * @brief Updates the particles.
+     * @brief Checks if the particles still have to be seeded into the particle buffer by the seed compute shader.
+     *
+     * @return True if the particles are seeded on the GPU, false otherwise.
      */
-    void updateParticles();
+    bool isSeededOnGPU() { return seedOnGPU; }
 
     /**
-     * @brief Updates the particles in parallel.
+     * @brief Getter for the seed of the random initializations.
+     *
+     * @return The seed.
      */
-    void updateParticlesParallel();
+    uint32_t getSeed() { return seed; }
+
+    /**
+     * @brief Updates the particles.
+     */
+    void updateParticles();
 
     /**
-     * @brief Updates the particles using a thread pool.
+     * @brief Updates the particles in parallel as latency-critical tasks of the executor.
      */
-    void updateParticlesPool();
+    void updateParticlesParallel();
 
+#if !HEADLESS
     /**
      * @brief Simulates the particles.
      */
@@ -87,20 +108,54 @@ public:
      * @param mainview A reference to the view to render in.
      */
     void draw(Mainview& mainview);
+#endif
 
     /**
      * @brief Getter for the positions of the particles.
      *
-     * @return A reference to the vector of particle positions.
+     * @return A reference to the flat vector of particle positions and ages (`PARTICLE_STRIDE` floats per particle).
      */
     std::vector<float>& getParticlesPositions() { return particlesPos; };
 
     /**
-     * @brief Binds the position of the given particle between the simulation dimensions.
+     * @brief Gathers the velocity and acceleration of every particle for the GPU particle state buffer.
+     *
+     * @return The flat vector of particle states (`PARTICLE_STATE_STRIDE` floats per particle).
+     */
+    std::vector<float> getParticlesState();
+
+#if !HEADLESS
+    /**
+     * @brief Cross-checks the particle model of the compute shader against the CPU implementation.
+     * A sample of uniformly seeded particles is stepped on both sides and the largest deviations are logged.
+     *
+     * @param mainview A reference to the main view.
+     * @param numSamples The number of sampled particles.
+     * @param steps The number of integration steps.
+     * @return The largest position deviation.
+     */
+    float crossCheckPhysics(Mainview& mainview, size_t numSamples = 1024, int steps = 10);
+
+    /**
+     * @brief Moves the particle state between the CPU arrays and the GPU buffers when the execution mode changes.
+     * Positions, ages, velocities, accelerations, and the free slots are carried over, so the simulation continues.
+     *
+     * @param mainview A reference to the view owning the GPU buffers.
+     * @param from The current mode.
+     * @param to The new mode.
+     */
+    void migrate(Mainview& mainview, Mode from, Mode to);
+#endif
+
+    /**
+     * @brief Binds the position of the given particle between the simulation dimensions, per axis by the domain
+     * boundaries (see `setDomainBoundaries`).
      *
      * @param particle A reference to the particle to be bound.
+     * @param absorbed Set to true if the particle left through an absorbing boundary, may be nullptr.
+     * @return True if the particle was clamped, false otherwise.
      */
-    void bindPosition(Particle& particle);
+    bool bindPosition(Particle& particle, bool* absorbed = nullptr);
 
     /**
      * @brief Binds the positions of all particles between the simulation dimensions.
@@ -114,6 +169,95 @@ public:
      */
     void loadPositionsFromFile(const std::string& filePath);
 
+    /**
+     * @brief Initializes the particles at rest at the given positions.
+     *
+     * @param positions The positions in simulation coordinates.
+     */
+    void setPositions(const std::vector<glm::vec3>& positions);
+
+    /**
+     * @brief Moves every live particle by the given mapping, e.g., when the simulated volume spans a new window.
+     *
+     * @param map The mapping from the old to the new position.
+     */
+    void remapPositions(const std::function<glm::vec3(const glm::vec3&)>& map);
+
+    /**
+     * @brief Adds a continuous emitter of particles. Emitted particles reuse the slots of reclaimed particles.
+     *
+     * @param emitter The emitter to add.
+     */
+    void addEmitter(const Emitter& emitter) { emitters.push_back(emitter); }
+
+    /**
+     * @brief Sets the policy defining when particles are reclaimed.
+     *
+     * @param policy The recycling policy.
+     */
+    void setRecyclePolicy(const RecyclePolicy& policy) { recyclePolicy = policy; }
+
+    /**
+     * @brief Getter for the recycling policy.
+     *
+     * @return A reference to the recycling policy.
+     */
+    RecyclePolicy& getRecyclePolicy() { return recyclePolicy; }
+
+    /**
+     * @brief Sets the land mask used to keep the particles off land (CPU implementations only).
+     *
+     * @param mask A pointer to the land mask, nullptr disables the coastline handling.
+     */
+    void setLandMask(const LandMask* mask) { landMask = mask; }
+
+    /**
+     * @brief Sets what happens to particles leaving the simulated volume, per axis (CPU implementations only).
+     * Particles leaving through an absorbing boundary are reclaimed whatever the recycling policy.
+     *
+     * @param boundaries The boundaries, clamping along all axes by default.
+     */
+    void setDomainBoundaries(const DomainBoundaries& boundaries) { domainBoundaries = boundaries; }
+
+    /**
+     * @brief Getter for the domain boundaries.
+     *
+     * @return The boundaries.
+     */
+    const DomainBoundaries& getDomainBoundaries() { return domainBoundaries; }
+
+#if !HEADLESS
+    /**
+     * @brief Emits new particles from all emitters into free particle slots.
+     * On the CPU the slots are popped from the free list, on the GPU the particles are appended
+     * by the emit compute shader.
+     *
+     * @param mainview A reference to the view owning the particle buffer.
+     */
+    void emitParticles(Mainview& mainview);
+#endif
+
+    /**
+     * @brief Getter for the number of free particle slots (CPU implementations only).
+     *
+     * @return The number of free slots.
+     */
+    size_t getNumFree() { return freeList.size(); }
+
+    /**
+     * @brief Limits the simulation and drawing to a prefix of the particle arrays, e.g., to hold a frame budget.
+     *
+     * @param count The number of active particles, the particles beyond stay frozen and hidden.
+     */
+    void setActiveCount(size_t count) { numActive = count; }
+
+    /**
+     * @brief Getter for the number of active particles.
+     *
+     * @return The number of active particles.
+     */
+    size_t getActiveCount() { return std::min(numActive, particles.size()); }
+
     /**
      * @brief Checks if the particles have been initialized.
      *
@@ -121,16 +265,69 @@ public:
      */
     bool areParticlesInitialized() { return isInitialized; }
 
+    /**
+     * @brief Getter for the number of chunks the particle updates are split into, see `Executor::getChunkCount`.
+     *
+     * @return The number of chunks.
+     */
+    size_t getThreadCount() { return thread_count; }
+
 private:
+    /**
+     * @brief Creates the i-th particle of the given initialization. The result depends only on the index and seed.
+     *
+     * @param type The type of initialization.
+     * @param i The index of the particle.
+     * @return The particle.
+     */
+    Particle seedParticle(InitType type, size_t i);
+
+    /**
+     * @brief Advances a single particle by one step and writes its position for rendering.
+     *
+     * @param j The index of the particle.
+     * @return True if the particle was reclaimed in this step, false otherwise.
+     */
+    bool stepParticle(size_t j);
+
+    /**
+     * @brief Writes the position and age of a particle into the rendering buffer.
+     *
+     * @param j The index of the particle.
+     */
+    void storeParticle(size_t j);
+
+    /**
+     * @brief Resets the free list and the liveness of the particles after (re)initialization.
+     */
+    void resetSlots();
+
     int num;  // Number handled of particles
     std::vector<Particle> particles;
     std::vector<float> particlesPos;
     Physics& physics;
 
+    // Particle recycling
+    std::vector<Emitter> emitters;
+    RecyclePolicy recyclePolicy;
+    std::vector<uint8_t> alive;  // 1 if the slot holds a live particle, 0 if it is free
+    std::vector<size_t> freeList;  // Stack of free slots
+    std::vector<std::vector<size_t>> recycledPerThread;  // Slots reclaimed by each thread in the last step
+    std::vector<float> emittedPos;  // Positions emitted in the last step (GPU implementation)
+
+    const LandMask* landMask = nullptr;  // Coastline handling, owned by the vector field handler
+    DomainBoundaries domainBoundaries;
+
+    size_t numActive = SIZE_MAX;  // Number of active particles, all by default
+
+    Executor& executor;
     size_t thread_count;
-    ThreadPool pool;
 
     bool isInitialized;  // True if particles have been initialized
+
+    InitType initType;
+    uint32_t seed = 112358;
+    bool seedOnGPU = false;  // True if the positions are generated by the seed compute shader
 };
 
 #endif //LAGRANGIAN_FLUID_SIMULATION_PARTICLES_HANDLER_H
@@ -8,6 +8,7 @@
 #include "glm/glm.hpp"
 #include "vector_field_handler.h"
 #include "particle.h"
+#include "physics_constants.h"
 
 struct ParticleState {
     glm::vec3 pos;
@@ -26,12 +27,12 @@ public:
      * @enum Model
      * @brief The model of physics for the particles.
      *
-     * @note particles_simple and particles are not compatible with the compute shader implementation
+     * @note The integer values are shared with `compute_shader.glsl`.
      */
     enum class Model {
-        particles_simple,       // drag force
-        particles,              // centripetal, buoyant, drag, gravity, drag, and added mass force
-        particles_advection,    // Advection equation for tracer particles - default
+        particles_simple = 0,       // drag force
+        particles = 1,              // centripetal, buoyant, drag, gravity, drag, and added mass force
+        particles_advection = 2,    // Advection equation for tracer particles - default
     };
 
     /**
@@ -52,6 +53,15 @@ public:
      */
     glm::vec3 dvdt(const ParticleState& state);
 
+    /**
+     * @brief Calculates the derivative of the simulated quantity with the field sampled at the given time.
+     *
+     * @param state The state of the particle (at least the position).
+     * @param time The time since the first loaded time step.
+     * @return The quantity as defined for `dvdt`.
+     */
+    glm::vec3 dvdt(const ParticleState& state, float time);
+
     /**
      * @brief Performs an Euler integration step.
      *
@@ -73,6 +83,14 @@ public:
      */
     void advectionStep(Particle& particle);
 
+    /**
+     * @brief Performs an advection step with the field sampled at the given time.
+     *
+     * @param particle The particle to update.
+     * @param time The time since the first loaded time step at the start of the step.
+     */
+    void advectionStep(Particle& particle, float time);
+
     /**
      * @brief Performs a step of the simulation.
      *
@@ -80,6 +98,20 @@ public:
      */
     void doStep(Particle& particle);
 
+    /**
+     * @brief Getter for the model of physics.
+     *
+     * @return The model.
+     */
+    Model getModel() { return model; }
+
+    /**
+     * @brief Gathers the constants of the model for the compute shader.
+     *
+     * @return The constants.
+     */
+    PhysicsConstants getConstants() { return {b, m, rho, V, g, C, (int32_t) model}; }
+
     float dt = 0.1f;  // Time step == dt / TIME_STEP [days] == approx 2.88 [minutes] (for 0.02f)
     float b = 50;  // Drag coefficient (6*pi*mu*radius = 0.017 for water)
     float m = 1.0f;  // Mass of the particle
@@ -0,0 +1,31 @@
+#ifndef LAGRANGIAN_FLUID_SIMULATION_PHYSICS_CONSTANTS_H
+#define LAGRANGIAN_FLUID_SIMULATION_PHYSICS_CONSTANTS_H
+
+#include <cstdint>
+
+/**
+ * @struct PhysicsConstants
+ * @brief The constants of the particle models, laid out to match the std140 `PhysicsConstants` uniform block
+ * of `compute_shader.glsl` (eight 4-byte scalars).
+ */
+struct PhysicsConstants {
+    float b;  // Drag coefficient
+    float m;  // Mass of the particle
+    float rho;  // Density of the fluid
+    float V;  // Volume of the particle
+    float g;  // Gravity
+    float C;  // Displacement coefficient
+    int32_t model;  // `Physics::Model` as an integer
+    float padding = 0.0f;
+
+    static constexpr int32_t advectionModel = 2;  // `Physics::Model::particles_advection`, no per-particle state
+
+    /**
+     * @brief Checks whether the model keeps a velocity and acceleration per particle.
+     *
+     * @return True for the inertial models, false for the advection of tracers.
+     */
+    bool isInertial() const { return model != advectionModel; }
+};
+
+#endif //LAGRANGIAN_FLUID_SIMULATION_PHYSICS_CONSTANTS_H
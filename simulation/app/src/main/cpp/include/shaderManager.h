@@ -9,10 +9,13 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <string>
+#include <vector>
+#include <fstream>
 #include <android/asset_manager.h>
 
 
 #include "android_logging.h"
+#include "consts.h"
 
 /**
  * @class ShaderManager
@@ -24,8 +27,9 @@ public:
      * @brief Constructor.
      *
      * @param assetManager A pointer to the asset manager.
+     * @param cacheDir The directory to persist the linked program binaries in, empty to disable the cache.
      */
-    ShaderManager(AAssetManager* assetManager);
+    ShaderManager(AAssetManager* assetManager, const std::string& cacheDir = "");
 
     /**
      * @brief Destructor.
@@ -37,14 +41,84 @@ public:
     GLuint shaderPointsProgram;
     GLuint shaderComputeProgram;
     GLuint shaderUIProgram;
+    GLuint shaderFTLEProgram;
+    GLuint shaderDensityProgram;
+    GLuint shaderEmitProgram;
+    GLuint shaderSeedProgram;
 
     /**
      * @brief Creates the shader programs.
      */
     void createShaderPrograms();
 
+    /**
+     * @brief Creates a variant of the particle compute shader program with the given workgroup size.
+     *
+     * @param localSizeX The number of invocations per workgroup.
+     * @return The linked program, owned by the caller.
+     */
+    GLuint createComputeProgramVariant(int localSizeX);
+
 private:
+    /**
+     * @struct CachedProgram
+     * @brief A program of the binary cache along with the sources it is built from.
+     */
+    struct CachedProgram {
+        const char* name;  // File name of the binary in the cache directory
+        GLuint* program;
+        std::vector<const std::string*> sources;
+    };
+
     AAssetManager *assetManager;
+    std::string cacheDir;
+    std::string driverVersion;  // Vendor, renderer, and version of the driver, binaries are only valid for the same driver
+
+    /**
+     * @brief Lists the programs of the binary cache along with their sources.
+     *
+     * @return The programs.
+     */
+    std::vector<CachedProgram> cachedPrograms();
+
+    /**
+     * @brief Computes the cache key of a program from the driver version and its sources (64-bit FNV-1a).
+     *
+     * @param sources The sources of the program.
+     * @return The key.
+     */
+    uint64_t cacheKey(const std::vector<const std::string*>& sources);
+
+    /**
+     * @brief Loads a program from its cached binary, validating the key and the link status.
+     *
+     * @param program Set to the loaded program.
+     * @param name The file name of the binary.
+     * @param key The expected cache key.
+     * @return True if the cached binary was valid, false if the program has to be compiled from source.
+     */
+    bool loadProgramBinary(GLuint& program, const std::string& name, uint64_t key);
+
+    /**
+     * @brief Persists the binary of a linked program.
+     *
+     * @param program The program.
+     * @param name The file name of the binary.
+     * @param key The cache key.
+     */
+    void saveProgramBinary(GLuint program, const std::string& name, uint64_t key);
+
+    /**
+     * @brief Loads all shader programs from the binary cache.
+     *
+     * @return True if every program was loaded, false otherwise (the loaded ones are deleted again).
+     */
+    bool loadCachedPrograms();
+
+    /**
+     * @brief Persists the binaries of all shader programs.
+     */
+    void saveCachedPrograms();
 
     /**
      * @brief Loads a shader file with the given filename.
@@ -54,6 +128,22 @@ private:
      */
     std::string loadShaderFile(const char* fileName);
 
+    /**
+     * @brief Injects preprocessor definitions into a shader source, right after its `#version` line.
+     *
+     * @param source The shader source to modify.
+     * @param defines The definitions to inject, e.g., "#define USE_FIELD_TEXTURE\n".
+     */
+    static void injectDefines(std::string& source, const std::string& defines);
+
+    /**
+     * @brief Builds the preprocessor definitions of the particle compute shader.
+     *
+     * @param localSizeX The number of invocations per workgroup.
+     * @return The definitions, one per line.
+     */
+    static std::string computeShaderDefines(int localSizeX);
+
     /**
      * @brief Compiles and links the shaders.
      */
@@ -80,7 +170,8 @@ private:
     void compileFragmentShaders();
 
     /**
-     * @brief Compiles the geometry shader for lines (vector field).
+     * @brief Compiles the geometry shaders for lines (vector field) and points (particles).
+     * @note Only used with `RenderPath::geometryShaders`.
      */
     void compileGeometryShaders();
 
@@ -104,6 +195,26 @@ private:
      */
     void createComputeProgram();
 
+    /**
+     * @brief Creates the FTLE compute shader program.
+     */
+    void createFTLEProgram();
+
+    /**
+     * @brief Creates the density compute shader program.
+     */
+    void createDensityProgram();
+
+    /**
+     * @brief Creates the particle emission compute shader program.
+     */
+    void createEmitProgram();
+
+    /**
+     * @brief Creates the particle seeding compute shader program.
+     */
+    void createSeedProgram();
+
     /**
      * @brief Creates the UI shader program.
      */
@@ -126,21 +237,33 @@ private:
 
     // Shader sources
     std::string vertexShaderSource;
+    std::string vertexShaderPointsSource;
+    std::string vertexShaderLinesSource;
     std::string fragmentShaderLinesSource;
     std::string fragmentShaderPointsSource;
     std::string geometryLinesShaderSource;
     std::string geometryPointsShaderSource;
     std::string computeShaderSource;
+    std::string ftleComputeShaderSource;
+    std::string densityComputeShaderSource;
+    std::string emitComputeShaderSource;
+    std::string seedComputeShaderSource;
     std::string uiVertexShaderSource;
     std::string uiFragmentShaderSource;
 
     // Shaders
-    GLuint vertexShader;
+    GLuint vertexShader = 0;
+    GLuint vertexShaderPoints = 0;
+    GLuint vertexShaderLines = 0;
     GLuint fragmentShaderLines;
     GLuint fragmentShaderPoints;
-    GLuint geometryLinesShader;
-    GLuint geometryPointsShader;
+    GLuint geometryLinesShader = 0;
+    GLuint geometryPointsShader = 0;
     GLuint computeShader;
+    GLuint ftleComputeShader;
+    GLuint densityComputeShader;
+    GLuint emitComputeShader;
+    GLuint seedComputeShader;
     GLuint uiVertexShader;
     GLuint uiFragmentShader;
 
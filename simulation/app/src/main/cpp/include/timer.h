@@ -7,6 +7,8 @@
 
 #include <chrono>
 #include <ctime>
+#include <string>
+#include <functional>
 
 #include "consts.h"
 #include "android_logging.h"
@@ -72,23 +74,57 @@ public:
      */
     void measure();
 
+    /**
+     * @brief Sets a description of the measured configuration, logged along with the elapsed time.
+     *
+     * @param info The description.
+     */
+    void setInfo(const std::string& info);
+
+    /**
+     * @brief Adds a GPU draw time sample, averaged and logged along with the elapsed time.
+     *
+     * @param drawTime The draw time of a frame in milliseconds.
+     */
+    void addDrawTime(float drawTime);
+
+    /**
+     * @brief Logs the time elapsed since the start of the timer for a named milestone, e.g., of the startup.
+     *
+     * @param name The name of the milestone.
+     */
+    void logMilestone(const std::string& name);
+
+    /**
+     * @brief Sets a report that is logged along with the elapsed time, e.g., the busy time of the workers.
+     *
+     * @param report The function creating the report, called once per logged measurement.
+     */
+    void setReport(const std::function<std::string()>& report);
+
 private:
     bool started;
     std::chrono::time_point<ClockType> startTime, stopTime;
     int numMeasurements;
     std::chrono::milliseconds displayFrequency;
+    std::string info;  // Description of the measured configuration
+    float drawTimeSum;
+    int numDrawTimes;
+    std::function<std::string()> report;  // Additional report, empty if not set
 };
 
 // Definitions are below the class declaration, but still in the header
 
 template<typename ClockType>
 inline Timer<ClockType>::Timer()
-        : started(false), numMeasurements(0), displayFrequency(std::chrono::milliseconds(1000)) {}
+        : started(false), numMeasurements(0), displayFrequency(std::chrono::milliseconds(1000)), drawTimeSum(0.0f), numDrawTimes(0) {}
 
 template<typename ClockType>
 inline void Timer<ClockType>::start() {
     started = true;
     numMeasurements = 0;
+    drawTimeSum = 0.0f;
+    numDrawTimes = 0;
     startTime = ClockType::now();
 }
 
@@ -121,7 +157,16 @@ inline void Timer<ClockType>::logFPS() {
 template<typename ClockType>
 inline void Timer<ClockType>::logElapsedTime() {
     float elapsedTime = getElapsedTimeInSeconds() * 1000 / numMeasurements;  // Convert to milliseconds
-    LOGI("Timer", "Elapsed time: %f ms", elapsedTime);
+    if (numDrawTimes > 0) {
+        LOGI("Timer", "Elapsed time: %f ms, draw time: %f ms (%s)", elapsedTime, drawTimeSum / numDrawTimes, info.c_str());
+    } else if (info.empty()) {
+        LOGI("Timer", "Elapsed time: %f ms", elapsedTime);
+    } else {
+        LOGI("Timer", "Elapsed time: %f ms (%s)", elapsedTime, info.c_str());
+    }
+    if (report) {
+        LOGI("Timer", "%s", report().c_str());
+    }
 }
 
 template<typename ClockType>
@@ -144,4 +189,25 @@ inline void Timer<ClockType>::measure() {
     }
 }
 
+template<typename ClockType>
+inline void Timer<ClockType>::setInfo(const std::string& info) {
+    this->info = info;
+}
+
+template<typename ClockType>
+inline void Timer<ClockType>::addDrawTime(float drawTime) {
+    drawTimeSum += drawTime;
+    numDrawTimes++;
+}
+
+template<typename ClockType>
+inline void Timer<ClockType>::logMilestone(const std::string& name) {
+    LOGI("Timer", "Milestone %s: %f ms", name.c_str(), getElapsedTimeInSeconds() * 1000);
+}
+
+template<typename ClockType>
+inline void Timer<ClockType>::setReport(const std::function<std::string()>& report) {
+    this->report = report;
+}
+
 #endif //LAGRANGIAN_FLUID_SIMULATION_TIMER_H
@@ -46,6 +46,12 @@ public:
      */
     void setAspectRatio(float aspectRatio);
 
+    /**
+     * @brief Pre-multiplies the model, view, and projection transformations into `mvpTransform`.
+     * @note Called once per frame, so that the vertex shaders apply a single matrix.
+     */
+    void updateMVP();
+
     /**
      * @brief Getter for the rotation of the transformations.
      *
@@ -64,6 +70,7 @@ public:
     glm::mat4 modelTransform;
     glm::mat4 projectionTransform;
     glm::mat4 viewTransform;
+    glm::mat4 mvpTransform;  // Uploaded transposed, like the individual matrices
 
 private:
     /**
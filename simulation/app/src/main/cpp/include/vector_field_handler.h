@@ -5,13 +5,24 @@
 #ifndef LAGRANGIAN_FLUID_SIMULATION_VECTOR_FIELD_HANDLER_H
 #define LAGRANGIAN_FLUID_SIMULATION_VECTOR_FIELD_HANDLER_H
 
+#if HEADLESS
+#include <netcdf>
+#else
 #include "mainview.h"
+#include "netcdf_reader.h"
+#endif
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "android_logging.h"
-#include "netcdf_reader.h"
 #include "consts.h"
+#include "land_mask.h"
+#include "field_window.h"
+#include "grid_axis.h"
+#include "domain_boundary.h"
 #include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
 
 /**
  * @class VectorFieldHandler
@@ -19,6 +30,18 @@
  */
 class VectorFieldHandler {
 public:
+    /**
+     * @enum Decimation
+     * @brief How a coarser grid is read from the dataset, see `setDecimation`.
+     */
+    enum class Decimation {
+        stride,   // Every n-th cell, read by NetCDF directly
+        average   // Mean of the sea cells of every block of n x n cells
+    };
+
+    // Cells of a brick of the sparse storage along every axis, shared with the compute shader
+    static constexpr int BRICK_SIZE = 8;
+
     /**
      * @brief Constructor for the VectorFieldHandler class.
      *
@@ -28,13 +51,23 @@ public:
     VectorFieldHandler(int finenessX = 1, int finenessY = 1, int finenessZ = 1, bool alt = false);
 
     /**
-     * @brief Gets the velocity field at the given position.
+     * @brief Gets the velocity field at the given position. Positions far from the focus (see `setFocus`) are sampled
+     * on a coarser level of the pyramid, blended with the finer level over a band around the level boundaries.
      *
      * @param position The position at which to calculate the velocity field.
      * @param velocity The var. to store the  velocity field's value.
      */
     void velocityField(const glm::vec3 &position, glm::vec3 &velocity);
 
+    /**
+     * @brief Gets the velocity field at the given position and time, like `velocityField` at `global_time_in_step`.
+     *
+     * @param position The position at which to calculate the velocity field.
+     * @param velocity The var. to store the  velocity field's value.
+     * @param time The time since the first loaded time step, in [0, `one_day_simulation_period`].
+     */
+    void velocityField(const glm::vec3 &position, glm::vec3 &velocity, float time);
+
 
     /**
      * @brief Prepares the vertex data with the given u, v, and w data.
@@ -52,9 +85,11 @@ public:
      * @param fileUPath The file path for the u data.
      * @param fileVPath The file path for the v data.
      * @param fileWPath The file path for the w data.
+     * @param removeFiles True to delete the files once loaded (temporary copies), false to keep them.
      */
-    void loadTimeStepHelper(const std::string& fileUPath, const std::string& fileVPath, const std::string& fileWPath);
+    void loadTimeStepHelper(const std::string& fileUPath, const std::string& fileVPath, const std::string& fileWPath, bool removeFiles = true);
 
+#if !HEADLESS
     /**
      * @brief Loads a time step with the given file descriptors for u, v, and w data.
      *
@@ -64,18 +99,111 @@ public:
      * @param fdW The file descriptor for the w data.
      */
     void loadTimeStep(NetCDFReader& reader, int fdU, int fdV, int fdW);
+#endif
 
     /**
      * @brief Updates the time step.
      */
     void updateTimeStep();
 
+    /**
+     * @brief Restricts the loading to a region of interest of the dataset, from the next loaded time step on.
+     * The time steps in use keep the previous window until they are reloaded (see `clearTimeSteps`).
+     *
+     * @param window The window in cells of the dataset, `FieldWindow()` for the full dataset.
+     */
+    void setWindow(const FieldWindow& window);
+
+    /**
+     * @brief Samples the velocity field at the full resolution only around a region of interest, from the next loaded
+     * time step on. Farther away, positions are sampled on the 1/2 and then the 1/4 resolution level of the pyramid.
+     *
+     * @param focus The region in cells of the dataset, `FieldWindow()` to sample everywhere at the full resolution.
+     */
+    void setFocus(const FieldWindow& focus);
+
+    /**
+     * @brief Enables or disables the coarser sampling away from the focus, e.g., while the compute shaders advect the
+     * particles, which always sample the full resolution. Disabled, every position is sampled at the full resolution.
+     *
+     * @param enabled True to sample on the pyramid away from the focus (default), false otherwise.
+     */
+    void setFocusSampling(bool enabled);
+
+    /**
+     * @brief Stores the velocities of the next loaded time steps sparsely: only the bricks of `BRICK_SIZE`^3 cells
+     * holding sea are kept, found through a table of all bricks (see `getBrickTable`). Land-only bricks take no memory
+     * and have zero velocity, like land cells in the dense storage. The slots then hold 3 floats (the velocity) per
+     * cell of the stored bricks instead of 6 floats (the start and end point) per cell of the grid.
+     *
+     * @param sparse True for the sparse storage, false for the dense one.
+     */
+    void setSparse(bool sparse);
+
+    /**
+     * @brief Reads a coarser grid from the next loaded time step on, e.g., for a first look at a dataset. Only the
+     * horizontal axes are decimated, the depth levels are kept. Like `setWindow`, the time steps in use keep their grid
+     * until they are reloaded.
+     *
+     * @param decimation How the cells of a block are reduced to one.
+     * @param stride The cells per block along x and y, 1 for the full resolution. A memory budget may coarsen it.
+     */
+    void setDecimation(Decimation decimation, int stride);
+
+    /**
+     * @brief Limits the memory of the three resident time steps, from the next loaded time step on. The loader picks
+     * the finest stride (not finer than the one of `setDecimation`) whose slots and decode buffers fit the budget.
+     *
+     * @param bytes The budget in bytes, 0 for no budget.
+     */
+    void setMemoryBudget(size_t bytes);
+
+    /**
+     * @brief Maps the simulated volume through the coordinates of the dataset (the `lon`, `lat`, and `depth` variables)
+     * from the next loaded time step on, so that stretched grids (e.g., thin near-surface depth levels) are sampled in
+     * their coordinates instead of their indices. Evenly spaced axes and datasets without these variables keep the linear
+     * mapping.
+     *
+     * @param use True to read the coordinates, false to map all axes linearly.
+     */
+    void setGridCoordinates(bool use);
+
+    /**
+     * @brief Wraps the sampling around the periodic axes of the domain boundaries, e.g., across the dateline of a
+     * global dataset, so that the cells at both borders are interpolated between. Other axes clamp the sampling.
+     *
+     * @param boundaries The boundaries of the simulated volume, see `ParticlesHandler::setDomainBoundaries`.
+     */
+    void setDomainBoundaries(const DomainBoundaries& boundaries);
+
+    /**
+     * @brief Drops all loaded time steps, e.g., to reload them after changing the window.
+     */
+    void clearTimeSteps();
+
+#if !HEADLESS
     /**
      * @brief Draws the vector field with the view.
      *
      * @param mainview The view
      */
     void draw(Mainview& mainview);
+#endif
+
+    /**
+     * @brief Gets the level of the pyramid the overlay is drawn from at a zoom, every level halves the lines along x and y.
+     *
+     * @param scale The scale of the transformations, see `Transforms::getScale`.
+     * @return The level, 0 for the full resolution.
+     */
+    int displayLevel(float scale);
+
+    /**
+     * @brief Sets the stride between the drawn lines of the vector field, e.g., to hold a frame budget.
+     *
+     * @param stride The stride, 1 draws every displayed line.
+     */
+    void setDisplayStride(int stride) { displayStride = std::max(stride, 1); }
 
     /**
      * @brief Getter for the previous time step vertices.
@@ -119,6 +247,66 @@ public:
      */
     int getDepth() {return depth;};
 
+    /**
+     * @brief Getter for the land mask, built from the fill values of the first loaded time step.
+     *
+     * @return A reference to the land mask.
+     */
+    LandMask& getLandMask() {return landMask;};
+
+    /**
+     * @brief Getter for the window of the loaded time steps, resolved against the dataset.
+     *
+     * @return The window.
+     */
+    const FieldWindow& getWindow() {return window;};
+
+    /**
+     * @brief Getter for the number of cells of the dataset per axis.
+     *
+     * @return The size of the dataset.
+     */
+    glm::ivec3 getDatasetSize() {return datasetSize;};
+
+    /**
+     * @brief Getter for the brick table of the sparse storage, the index of the stored brick for every brick of the grid
+     * (x fastest), -1 for bricks of land only. Built with the land mask and shared by all time steps.
+     *
+     * @return The brick table, empty with the dense storage.
+     */
+    const std::vector<int32_t>& getBrickTable() {return brickTable;};
+
+    /**
+     * @brief Getter for the stride of the loaded grid along x and y, chosen by the last load.
+     *
+     * @return The stride, 1 for the full resolution.
+     */
+    int getStride() {return stride;};
+
+    /**
+     * @brief Gets the grid coordinates of the low corner of the simulated volume. The loaded grid has a halo of
+     * cells around the window, so that the sampler interpolates real data up to the border of the window.
+     *
+     * @return The origin in cells of the loaded grid.
+     */
+    glm::vec3 getGridOrigin() {return gridOrigin;};
+
+    /**
+     * @brief Gets the number of cells the simulated volume spans per axis, i.e., the size of the window in cells of
+     * the loaded (possibly decimated) grid.
+     *
+     * @return The extent in cells of the loaded grid.
+     */
+    glm::vec3 getGridExtent() {return gridExtent;};
+
+    /**
+     * @brief Gets the mapping of the simulated volume to the loaded grid per axis, linear unless the coordinates of a
+     * stretched axis were read (see `setGridCoordinates`). Built with the land mask and shared by all time steps.
+     *
+     * @return The axes x (lon), y (lat), and z (depth).
+     */
+    const std::array<GridAxis, 3>& getGridAxes() {return axes;};
+
 private:
     // Different vector field loading methods
     bool alt = false;  // Boolean to switch between the two methods
@@ -144,19 +332,274 @@ private:
      */
     void prepareVertexDataHelperAlt(const std::vector<float>& uData, const std::vector<float>& vData, const std::vector<float>& wData);
 
-    // Dimensions of the loaded vector field
-    int width ;
-    int height;
-    int depth ;
+    /**
+     * @brief Gets the slot the next time step is decoded into, sized for the current grid.
+     * Once all three slots exist, the buffers of the expired time step are recycled, so that no memory is allocated.
+     *
+     * @return The index of the slot in `allVertices` and `displayVertices`.
+     */
+    size_t nextSlot();
+
+    /**
+     * @brief Builds the brick table of the sparse storage from the land mask.
+     */
+    void buildBricks();
+
+    /**
+     * @brief Gets the position of a cell in the sparse storage of a slot.
+     *
+     * @param x The x index of the cell.
+     * @param y The y index of the cell.
+     * @param z The z index of the cell.
+     * @return The index of the cell among the cells of the stored bricks, -1 if its brick is land only.
+     */
+    int64_t brickCell(int x, int y, int z) {
+        int32_t brick = brickTable[((size_t) (z / BRICK_SIZE) * brickCount.y + y / BRICK_SIZE) * brickCount.x + x / BRICK_SIZE];
+        if (brick < 0) return -1;
+        return (int64_t) brick * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE + ((z % BRICK_SIZE) * BRICK_SIZE + y % BRICK_SIZE) * BRICK_SIZE + x % BRICK_SIZE;
+    }
+
+    /**
+     * @brief Stores the velocity of a cell into its brick of a slot, nothing if its brick is land only.
+     *
+     * @param vertices The slot.
+     * @param x The x index of the cell.
+     * @param y The y index of the cell.
+     * @param z The z index of the cell.
+     * @param velocity The velocity.
+     */
+    void storeBrickCell(std::vector<float>& vertices, int x, int y, int z, const glm::vec3& velocity) {
+        int64_t cell = brickCell(x, y, z);
+        if (cell < 0) return;
+        vertices[cell * 3] = velocity.x;
+        vertices[cell * 3 + 1] = velocity.y;
+        vertices[cell * 3 + 2] = velocity.z;
+    }
+
+    /**
+     * @brief Gets the velocity of a cell of a slot, from the dense or the sparse storage.
+     *
+     * @param slot The index of the slot.
+     * @param x The x index of the cell.
+     * @param y The y index of the cell.
+     * @param z The z index of the cell.
+     * @return The velocity, zero in bricks of land only.
+     */
+    glm::vec3 cellVelocity(size_t slot, int x, int y, int z) {
+        const std::vector<float>& vertices = allVertices[slot];
+        if (sparse) {
+            int64_t cell = brickCell(x, y, z);
+            return cell < 0 ? glm::vec3(0.0f) : glm::vec3(vertices[cell * 3], vertices[cell * 3 + 1], vertices[cell * 3 + 2]);
+        }
+        size_t index = (size_t) (z * width * height + y * width + x) * 6;
+        return glm::vec3(vertices[index + 3] - vertices[index], vertices[index + 4] - vertices[index + 1], vertices[index + 5] - vertices[index + 2]);
+    }
+
+    /**
+     * @brief Builds the coarser levels of the pyramid of a decoded slot, each one averaging 2 x 2 cells of the level
+     * below along x and y, together with their display vertices.
+     *
+     * @param slot The index of the slot.
+     */
+    void buildPyramid(size_t slot);
+
+    /**
+     * @brief Gets the number of cells of a level of the pyramid.
+     *
+     * @param level The level, 0 for the loaded grid.
+     * @return The number of cells per axis.
+     */
+    glm::ivec3 levelSize(int level) {
+        return glm::ivec3((width + (1 << level) - 1) >> level, (height + (1 << level) - 1) >> level, depth);
+    }
+
+    /**
+     * @brief Gets the two cells a grid coordinate is interpolated between along an axis. On a periodic axis the base
+     * cell may be the last one, interpolated with the first one, without branching in the interior.
+     *
+     * @param axis The axis, 0 for x.
+     * @param fGrid The grid coordinate along the axis.
+     * @param size The number of cells along the axis.
+     * @param low Set to the lower cell.
+     * @param high Set to the upper cell.
+     * @return The interpolation weight of the upper cell.
+     */
+    float cornerCells(int axis, float fGrid, int size, int& low, int& high) {
+        int base = std::max(-wrap[axis], std::min((int) std::floor(fGrid), size - 2 + wrap[axis]));
+        low = base + (base < 0) * size;
+        high = base + 1 - (base + 1 >= size) * size;
+        return fGrid - (float) base;
+    }
+
+    /**
+     * @brief Gets the level of the pyramid a position is sampled on, from its distance to the focus.
+     * Within the transition band around a level boundary the level is fractional.
+     *
+     * @param grid The position in cells of the loaded grid.
+     * @return The level, 0 for the loaded grid, the fractional part is the weight of the next coarser level.
+     */
+    float samplingLevel(const glm::vec3& grid);
+
+    /**
+     * @brief Samples the loaded grid, interpolated trilinearly in space and linearly in time.
+     *
+     * @param fGrid The position in cells of the loaded grid.
+     * @param time The time since the first loaded time step.
+     * @return The velocity.
+     */
+    glm::vec3 sampleGrid(const glm::vec3& fGrid, float time);
+
+    /**
+     * @brief Samples a level of the pyramid, interpolated like `sampleGrid`.
+     *
+     * @param grid The position in cells of the loaded grid.
+     * @param level The level, 0 for the loaded grid.
+     * @param time The time since the first loaded time step.
+     * @return The velocity.
+     */
+    glm::vec3 sampleLevel(const glm::vec3& grid, int level, float time);
+
+    /**
+     * @brief Estimates the memory of three resident time steps and the decode buffers at a stride.
+     *
+     * @param readCount The number of cells of the dataset read per axis (the window and its halo).
+     * @param stride The stride along x and y.
+     * @return The memory in bytes.
+     */
+    size_t residentBytes(const glm::ivec3& readCount, int stride);
+
+    /**
+     * @brief Picks the stride of the next load from the requested stride and the memory budget.
+     *
+     * @param readCount The number of cells of the dataset read per axis at the full resolution.
+     * @return The stride along x and y.
+     */
+    int chooseStride(const glm::ivec3& readCount);
+
+    /**
+     * @brief Reads a variable block-averaged into a decode buffer, one row of blocks at a time, so that the full
+     * resolution is never resident. Fill values are left out of the mean, blocks of land only stay fill values.
+     *
+     * @param variable The variable to read.
+     * @param readStart The first cell of the dataset to read.
+     * @param readCount The number of cells of the dataset to read per axis.
+     * @param fillValue The fill value of the variable.
+     * @param data The decode buffer of the decimated grid.
+     */
+    void readAveraged(const netCDF::NcVar& variable, const glm::ivec3& readStart, const glm::ivec3& readCount, float fillValue, std::vector<float>& data);
+
+    /**
+     * @brief Builds the axes of the loaded grid from the coordinate variables of a file, and the positions of its nodes.
+     *
+     * @param file The file of the u data.
+     * @param readStart The first cell of the dataset read.
+     * @param readCount The number of cells of the dataset read per axis.
+     */
+    void buildAxes(const netCDF::NcFile& file, const glm::ivec3& readStart, const glm::ivec3& readCount);
+
+    /**
+     * @brief Reads the coordinates of the loaded nodes of an axis, decimated like the data.
+     *
+     * @param file The file to read from.
+     * @param name The name of the coordinate variable.
+     * @param readStart The first cell of the dataset read along the axis.
+     * @param readCount The number of cells of the dataset read along the axis.
+     * @param axisStride The stride of the loaded grid along the axis.
+     * @param coordinates The coordinates to fill, one per node of the loaded grid.
+     * @return True if the file has a one-dimensional variable of the name, false otherwise.
+     */
+    bool readCoordinates(const netCDF::NcFile& file, const std::string& name, int readStart, int readCount, int axisStride, std::vector<float>& coordinates);
+
+    /**
+     * @brief Checks if the line of a cell of the loaded grid is displayed.
+     *
+     * @param x The x index of the cell.
+     * @param y The y index of the cell.
+     * @param z The z index of the cell.
+     * @return True if the cell lies in the window and on the reduced display grid, false otherwise.
+     */
+    bool isDisplayed(int x, int y, int z) {
+        glm::ivec3 cell = glm::ivec3(x, y, z) - displayFirst;
+        return glm::all(glm::greaterThanEqual(cell, glm::ivec3(0))) && glm::all(glm::lessThan(cell, displayCount)) &&
+               cell.x % finenessX == 0 && cell.y % finenessY == 0 && cell.z % finenessZ == 0;
+    }
+
+    /**
+     * @brief Maps a position in the simulated volume to coordinates of the loaded grid.
+     *
+     * @param position The position in simulation units.
+     * @return The position in cells of the loaded grid.
+     */
+    glm::vec3 toGrid(const glm::vec3& position) {
+        glm::vec3 t = (position / glm::vec3(FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH) + 1.0f) / 2.0f;
+        return glm::vec3(axes[0].toIndex(t.x), axes[1].toIndex(t.y), axes[2].toIndex(t.z));
+    }
+
+    // Dimensions of the loaded vector field (the window and its halo)
+    int width = 0;
+    int height = 0;
+    int depth = 0;
+
+    // Region of interest
+    FieldWindow requestedWindow;  // As set, applied by the next load
+    FieldWindow window;  // Resolved window of the loaded time steps
+    glm::ivec3 datasetSize = glm::ivec3(0);
+
+    // Focus sampled at the full resolution, in cells of the loaded grid
+    FieldWindow requestedFocus;
+    bool hasFocus = false;
+    bool focusSampling = true;  // Cleared while the compute shaders advect the particles
+    glm::vec2 focusLow = glm::vec2(0.0f);
+    glm::vec2 focusHigh = glm::vec2(0.0f);
+
+    // Decimation, the loaded grid maps to the simulated volume through its origin and extent
+    Decimation decimation = Decimation::stride;
+    int requestedStride = 1;  // As set, applied by the next load
+    size_t memoryBudget = 0;
+    int stride = 1;  // Stride of the loaded time steps along x and y
+    glm::vec3 gridOrigin = glm::vec3(0.0f);
+    glm::vec3 gridExtent = glm::vec3(1.0f);
+    glm::ivec3 displayFirst = glm::ivec3(0);  // First cell of the loaded grid inside the window
+    glm::ivec3 displayCount = glm::ivec3(0);  // Cells of the loaded grid inside the window
+
+    // Stretched grids, the axes map the simulated volume to the loaded grid in the coordinates of the dataset
+    bool gridCoordinates = true;
+    std::array<GridAxis, 3> axes;
+    std::array<std::vector<float>, 3> nodePositions;  // Position of every node of the loaded grid in simulation units
+
+    glm::ivec3 wrap = glm::ivec3(0);  // 1 along periodic axes, see `cornerCells`
 
     // Defines how many vertices to omit for rendering (higher value = less vertices)
     int finenessX;
     int finenessY;
     int finenessZ;
 
+    // Sparse storage, the bricks holding sea and their table
+    bool sparse = false;
+    std::vector<int32_t> brickTable;
+    glm::ivec3 brickCount = glm::ivec3(0);
+    size_t numBricks = 0;
+
+    // Slots of the previous, next, and future time step, rotated by swapping in `updateTimeStep`
     std::vector<std::vector<float>> allVertices;
     std::vector<std::vector<float>> displayVertices;
 
+    // Coarser levels of the pyramid of every slot (velocities and display vertices), starting at level 1
+    std::vector<std::vector<std::vector<float>>> levelVelocities;
+    std::vector<std::vector<std::vector<float>>> levelDisplayVertices;
+    int numLevels = 1;  // Levels of the loaded grid, coarser levels need two cells per axis
+
+    // Reused decode buffers of the u, v, and w data
+    std::vector<float> uBuffer;
+    std::vector<float> vBuffer;
+    std::vector<float> wBuffer;
+    std::vector<float> blockBuffer;  // One row of blocks at the full resolution, see `readAveraged`
+
+    std::vector<float> interpolatedVertices;  // Display vertices interpolated for the current frame
+    int displayStride = 1;  // Stride between the drawn lines
+
+    LandMask landMask;
+
 };
 
 #endif //LAGRANGIAN_FLUID_SIMULATION_VECTOR_FIELD_HANDLER_H
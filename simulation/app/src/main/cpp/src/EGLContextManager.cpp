@@ -34,7 +34,7 @@ void EGLContextManager::initContext() {
     sharedContext = eglCreateContext(storedEglDisplay, config, storedEglContext, contextAttributes);
 }
 
-void EGLContextManager::syncEGLContext(ThreadPool *threadPool) {
+void EGLContextManager::syncEGLContext(Executor *executor) {
     GLsync fence = globalFence.load(std::memory_order_acquire);
     if (fence != nullptr) {
         // Fence active, wait for it to complete
@@ -46,11 +46,15 @@ void EGLContextManager::syncEGLContext(ThreadPool *threadPool) {
         globalFence.store(nullptr, std::memory_order_release);
     } else {
         // Fence not active, make context current on thread
-        threadPool->enqueue([this]() {
-            if (!eglMakeCurrent(storedEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, sharedContext)) {
-                LOGE("EGLContextManager", "Failed to make context current on thread");
-                return;
-            }
-        });
+        makeCurrentOnThread(executor);
     }
 }
+
+void EGLContextManager::makeCurrentOnThread(Executor *executor) {
+    executor->submit(Executor::Priority::background, [this]() {
+        if (!eglMakeCurrent(storedEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, sharedContext)) {
+            LOGE("EGLContextManager", "Failed to make context current on thread");
+            return;
+        }
+    });
+}
@@ -0,0 +1,105 @@
+#include "include/app_config.h"
+
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+
+AppConfig AppConfig::defaults() {
+    AppConfig config;
+#if USE_GPU
+    config.mode = Mode::computeShaders;
+#elif USE_CPU_PARALLELISM
+    config.mode = Mode::parallel;
+#else
+    config.mode = Mode::sequential;
+#endif
+
+#if DOUBLE_GYRE_DEFAULT_SETTINGS
+    config.preset = Preset::doubleGyre;
+#elif PERLIN_DEFAULT_SETTINGS
+    config.preset = Preset::perlin;
+#else
+    config.preset = Preset::doubleGyreAlt;
+#endif
+
+#if REDUCE_FIELD_GRAPHICS
+    config.reduceFieldGraphics = true;
+#else
+    config.reduceFieldGraphics = false;
+#endif
+    return config;
+}
+
+AppConfig AppConfig::load(const std::string& filePath) {
+    AppConfig config = defaults();
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        LOGI("app_config", "No config at %s, using the built settings", filePath.c_str());
+        return config;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t separator = line.find('=');
+        if (line.empty() || line[0] == '#' || separator == std::string::npos) continue;
+        std::string key = line.substr(0, separator);
+        std::string value = line.substr(separator + 1);
+
+        if (key == "MODE") {
+            if (value == modeName(Mode::sequential)) config.mode = Mode::sequential;
+            else if (value == modeName(Mode::parallel)) config.mode = Mode::parallel;
+            else if (value == modeName(Mode::computeShaders)) config.mode = Mode::computeShaders;
+            else LOGE("app_config", "Unknown mode %s", value.c_str());
+        } else if (key == "PRESET") {
+            if (value == presetName(Preset::doubleGyre)) config.preset = Preset::doubleGyre;
+            else if (value == presetName(Preset::perlin)) config.preset = Preset::perlin;
+            else if (value == presetName(Preset::doubleGyreAlt)) config.preset = Preset::doubleGyreAlt;
+            else LOGE("app_config", "Unknown preset %s", value.c_str());
+        } else if (key == "REDUCE_FIELD_GRAPHICS") {
+            config.reduceFieldGraphics = value == "1";
+        } else if (key == "MODE_SWITCH_INTERVAL") {
+            config.modeSwitchInterval = std::strtof(value.c_str(), nullptr);
+        } else if (key == "WINDOW") {
+            if (!FieldWindow::parse(value, config.window)) LOGE("app_config", "Invalid window %s", value.c_str());
+        } else if (key == "FOCUS") {
+            if (!FieldWindow::parse(value, config.focus)) LOGE("app_config", "Invalid focus %s", value.c_str());
+        } else if (key == "FIELD_STRIDE") {
+            config.fieldStride = std::max(std::atoi(value.c_str()), 1);
+        } else if (key == "FIELD_DECIMATION") {
+            if (value == "stride") config.averageField = false;
+            else if (value == "average") config.averageField = true;
+            else LOGE("app_config", "Unknown decimation %s", value.c_str());
+        } else if (key == "FIELD_MEMORY_BUDGET") {
+            config.fieldMemoryBudget = (size_t) (std::strtof(value.c_str(), nullptr) * 1024.0f * 1024.0f);
+        } else if (key == "GRID_COORDINATES") {
+            config.gridCoordinates = value == "1";
+        } else if (key == "DOMAIN_BOUNDARY") {
+            if (!DomainBoundaries::parse(value, config.domainBoundaries)) LOGE("app_config", "Invalid domain boundary %s", value.c_str());
+        } else {
+            LOGE("app_config", "Unknown key %s", key.c_str());
+        }
+    }
+    LOGI("app_config", "Loaded %s: mode %s, preset %s, %s field graphics, mode switch interval %.0f s, window %s, focus %s, field stride %d (%s), field memory budget %zu bytes, %s grid, domain boundary %s",
+         filePath.c_str(), modeName(config.mode), presetName(config.preset), config.reduceFieldGraphics ? "reduced" : "full", config.modeSwitchInterval,
+         config.window.describe().c_str(), config.focus.describe().c_str(), config.fieldStride, config.averageField ? "average" : "stride", config.fieldMemoryBudget,
+         config.gridCoordinates ? "stretched" : "linear", config.domainBoundaries.describe().c_str());
+    return config;
+}
+
+const char* AppConfig::modeName(Mode mode) {
+    switch (mode) {
+        case Mode::sequential: return "sequential";
+        case Mode::parallel: return "parallel";
+        case Mode::computeShaders: return "compute_shaders";
+    }
+    return "unknown";
+}
+
+const char* AppConfig::presetName(Preset preset) {
+    switch (preset) {
+        case Preset::doubleGyre: return "double_gyre";
+        case Preset::perlin: return "perlin";
+        case Preset::doubleGyreAlt: return "double_gyre_alt";
+    }
+    return "unknown";
+}
@@ -0,0 +1,20 @@
+#include "include/batch_runner.h"
+
+// Globals of `consts.h`, defined by `native-lib.cpp` in the app
+float global_time_in_step = 0.0f;
+float one_day_simulation_period = 0.0f;
+Mode mode = Mode::parallel;
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!BatchRunner::parseArguments(argc, argv, options)) {
+        return 1;
+    }
+
+    BatchRunner runner(options);
+    if (!runner.run()) {
+        return 1;
+    }
+    runner.printReport(stdout);
+    return 0;
+}
@@ -0,0 +1,534 @@
+#include "include/batch_runner.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <dirent.h>
+
+// Helper function to get the milliseconds between two time points
+static float millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+BatchRunner::BatchRunner(const BatchOptions& options) : options(options) {}
+
+BatchRunner::~BatchRunner() {
+    // The load and the record reference members that are destroyed before the executor
+    waitForOutput();
+    waitForLoad();
+}
+
+void BatchRunner::printUsage(const char* program) {
+    std::fprintf(stderr,
+                 "Usage: %s --fields <dir> [options]\n"
+                 "  --fields <dir>        Directory of the NetCDF files of u, v, and w (sorted: all u, all v, then all w files)\n"
+                 "  --seeds <file>        Positions file (lat, lon, depth), seeds by --init otherwise\n"
+                 "  --init <type>         line, two_lines, explosion, or uniform (default uniform)\n"
+                 "  --particles <n>       Number of seeded particles without --seeds (default %d)\n"
+                 "  --seed <n>            Seed of the random initializations (default 112358)\n"
+                 "  --model <model>       advection (RK4 on the velocity), simple, or inertial (RK4 on the forces)\n"
+                 "  --mode <mode>         sequential or parallel (default parallel)\n"
+                 "  --dt <t>              Time step of the integrator (default 0.05)\n"
+                 "  --period <t>          Simulation time between two time steps of the field (default 50)\n"
+                 "  --duration <t>        Simulation time to run for (default 500)\n"
+                 "  --threads <n>         Number of workers, one per core by default\n"
+                 "  --reflect             Reflect particles at the coast instead of stopping them\n"
+                 "  --window <w>          Region of interest in cells, x0:x1,y0:y1,z0:z1 (empty bounds for the full axis)\n"
+                 "  --expand-window <n>   Grow the window by n cells where particles reach its border\n"
+                 "  --focus <w>           Region sampled at the full resolution, coarser levels farther away (format of --window)\n"
+                 "  --stride <n>          Load every n-th cell along x and y for a coarser field (default 1)\n"
+                 "  --average             Block-average the cells of the stride instead of skipping them\n"
+                 "  --memory-budget <mb>  Coarsen the stride until the three resident time steps fit\n"
+                 "  --sparse              Store only the bricks of the field holding sea\n"
+                 "  --linear-grid         Map all axes linearly, ignoring the lon, lat, and depth coordinates\n"
+                 "  --boundary <b>        clamp, periodic, reflect, or absorb per axis, e.g., periodic,clamp,clamp (default clamp)\n"
+                 "  --output <prefix>     Write <prefix>_endpoints.nc (and <prefix>_trajectories.nc)\n"
+                 "  --save-every <n>      Steps between trajectory records, 0 (default) for the endpoints only\n",
+                 program, NUM_PARTICLES);
+}
+
+bool BatchRunner::parseArguments(int argc, char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help") {
+            printUsage(argv[0]);
+            return false;
+        } else if (flag == "--reflect") {
+            options.reflectAtCoast = true;
+            continue;
+        } else if (flag == "--average") {
+            options.average = true;
+            continue;
+        } else if (flag == "--sparse") {
+            options.sparse = true;
+            continue;
+        } else if (flag == "--linear-grid") {
+            options.linearGrid = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            LOGE("batch_runner", "Missing value of %s", flag.c_str());
+            printUsage(argv[0]);
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (flag == "--fields") {
+            options.fieldDir = value;
+        } else if (flag == "--boundary") {
+            if (!DomainBoundaries::parse(value, options.boundaries)) {
+                LOGE("batch_runner", "Invalid boundary %s", value.c_str());
+                return false;
+            }
+        } else if (flag == "--seeds") {
+            options.seedsFile = value;
+        } else if (flag == "--init") {
+            if (value == "line") options.initType = ParticlesHandler::InitType::line;
+            else if (value == "two_lines") options.initType = ParticlesHandler::InitType::two_lines;
+            else if (value == "explosion") options.initType = ParticlesHandler::InitType::explosion;
+            else if (value == "uniform") options.initType = ParticlesHandler::InitType::uniform;
+            else {
+                LOGE("batch_runner", "Unknown initialization %s", value.c_str());
+                return false;
+            }
+        } else if (flag == "--particles") {
+            options.numParticles = std::atoi(value.c_str());
+        } else if (flag == "--seed") {
+            options.seed = (uint32_t) std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--model") {
+            if (value == "advection") options.model = Physics::Model::particles_advection;
+            else if (value == "simple") options.model = Physics::Model::particles_simple;
+            else if (value == "inertial") options.model = Physics::Model::particles;
+            else {
+                LOGE("batch_runner", "Unknown model %s", value.c_str());
+                return false;
+            }
+        } else if (flag == "--mode") {
+            if (value == "sequential") options.mode = Mode::sequential;
+            else if (value == "parallel") options.mode = Mode::parallel;
+            else {
+                LOGE("batch_runner", "Unknown mode %s, only the CPU modes run headless", value.c_str());
+                return false;
+            }
+        } else if (flag == "--dt") {
+            options.dt = std::strtof(value.c_str(), nullptr);
+        } else if (flag == "--period") {
+            options.period = std::strtof(value.c_str(), nullptr);
+        } else if (flag == "--duration") {
+            options.duration = std::strtof(value.c_str(), nullptr);
+        } else if (flag == "--threads") {
+            options.threads = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--window") {
+            if (!FieldWindow::parse(value, options.window)) {
+                LOGE("batch_runner", "Invalid window %s", value.c_str());
+                return false;
+            }
+        } else if (flag == "--expand-window") {
+            options.expandMargin = std::atoi(value.c_str());
+        } else if (flag == "--focus") {
+            if (!FieldWindow::parse(value, options.focus)) {
+                LOGE("batch_runner", "Invalid focus %s", value.c_str());
+                return false;
+            }
+        } else if (flag == "--stride") {
+            options.stride = std::max(std::atoi(value.c_str()), 1);
+        } else if (flag == "--memory-budget") {
+            options.memoryBudget = (size_t) (std::strtod(value.c_str(), nullptr) * 1024.0 * 1024.0);
+        } else if (flag == "--output") {
+            options.output = value;
+        } else if (flag == "--save-every") {
+            options.saveEvery = std::atoi(value.c_str());
+        } else {
+            LOGE("batch_runner", "Unknown flag %s", flag.c_str());
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.fieldDir.empty()) {
+        LOGE("batch_runner", "No field directory given");
+        printUsage(argv[0]);
+        return false;
+    }
+    if (options.dt <= 0.0f || options.period <= 0.0f || options.duration < 0.0f) {
+        LOGE("batch_runner", "dt and period must be positive, duration must not be negative");
+        return false;
+    }
+    return true;
+}
+
+bool BatchRunner::listFieldFiles() {
+    DIR* dir = opendir(options.fieldDir.c_str());
+    if (dir == nullptr) {
+        LOGE("batch_runner", "Failed to open the field directory %s", options.fieldDir.c_str());
+        return false;
+    }
+    std::vector<std::string> files;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".nc") == 0) {
+            files.push_back(options.fieldDir + "/" + name);
+        }
+    }
+    closedir(dir);
+
+    // Same layout as the files picked in the app: all u files, all v files, then all w files
+    std::sort(files.begin(), files.end());
+    if (files.empty() || files.size() % 3 != 0) {
+        LOGE("batch_runner", "Expected the u, v, and w files of every time step, found %zu files", files.size());
+        return false;
+    }
+    size_t numFrames = files.size() / 3;
+    uFiles.assign(files.begin(), files.begin() + numFrames);
+    vFiles.assign(files.begin() + numFrames, files.begin() + 2 * numFrames);
+    wFiles.assign(files.begin() + 2 * numFrames, files.end());
+    LOGI("batch_runner", "Found %zu time steps in %s", numFrames, options.fieldDir.c_str());
+    return true;
+}
+
+void BatchRunner::loadStep(size_t frame) {
+    vectorFieldHandler->loadTimeStepHelper(uFiles[frame], vFiles[frame], wFiles[frame], false);
+
+    // Same slot as `VectorFieldHandler::nextSlot`
+    if (slotFrames.size() < 3) {
+        slotFrames.push_back(frame);
+    } else {
+        slotFrames.back() = frame;
+    }
+}
+
+void BatchRunner::waitForLoad() {
+    if (!pendingLoad.valid()) return;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        pendingLoad.get();
+    } catch (netCDF::exceptions::NcException& e) {
+        LOGE("batch_runner", "Failed to load time step %zu: %s", currentFrame, e.what());
+    }
+    timing.loadWait += millisecondsBetween(start, std::chrono::steady_clock::now());
+}
+
+void BatchRunner::waitForOutput() {
+    if (!pendingOutput.valid()) return;
+    auto start = std::chrono::steady_clock::now();
+    pendingOutput.get();
+    timing.outputWait += millisecondsBetween(start, std::chrono::steady_clock::now());
+}
+
+void BatchRunner::advanceTime() {
+    // Same time keeping as `check_update` in the app
+    global_time_in_step += physics->dt;
+    if (global_time_in_step >= one_day_simulation_period) {
+        global_time_in_step = 0.0f;
+
+        waitForLoad();
+        vectorFieldHandler->updateTimeStep();
+        if (slotFrames.size() > 2) {
+            std::rotate(slotFrames.begin(), slotFrames.begin() + 1, slotFrames.end());
+        } else if (slotFrames.size() > 1) {
+            std::swap(slotFrames[0], slotFrames[1]);
+        }
+        currentFrame = (currentFrame + 1) % uFiles.size();
+        pendingLoad = executor->submit(Executor::Priority::background, [this, frame = currentFrame]() {
+            loadStep(frame);
+        });
+    }
+}
+
+void BatchRunner::checkWindow() {
+    const FieldWindow& window = vectorFieldHandler->getWindow();
+    glm::ivec3 size = vectorFieldHandler->getDatasetSize();
+    glm::ivec3 low(0);
+    glm::ivec3 high(0);
+    const std::vector<float>& positions = particlesHandler->getParticlesPositions();
+    for (size_t index = 0; index < positions.size(); index += PARTICLE_STRIDE) {
+        if (positions[index] >= PARKED_POSITION) continue;
+
+        // Within a cell of a border that is not the border of the dataset
+        glm::vec3 cells = window.toCells(glm::vec3(positions[index], positions[index + 1], positions[index + 2])) - glm::vec3(window.start);
+        for (int axis = 0; axis < 3; axis++) {
+            if (cells[axis] < 1.0f && window.start[axis] > 0) {
+                low[axis] = options.expandMargin;
+            }
+            if (cells[axis] > window.count[axis] - 1.0f && window.start[axis] + window.count[axis] < size[axis]) {
+                high[axis] = options.expandMargin;
+            }
+        }
+    }
+    if (low != glm::ivec3(0) || high != glm::ivec3(0)) {
+        expandWindow(low, high);
+    }
+}
+
+void BatchRunner::expandWindow(const glm::ivec3& low, const glm::ivec3& high) {
+    waitForOutput();
+    waitForLoad();
+    auto start = std::chrono::steady_clock::now();
+    FieldWindow previous = vectorFieldHandler->getWindow();
+    FieldWindow expanded = previous.expand(low, high, vectorFieldHandler->getDatasetSize());
+    LOGI("batch_runner", "Expanding the window from %s to %s", previous.describe().c_str(), expanded.describe().c_str());
+
+    // Reload the same time steps into the same slots
+    vectorFieldHandler->setWindow(expanded);
+    vectorFieldHandler->clearTimeSteps();
+    std::vector<size_t> frames;
+    std::swap(frames, slotFrames);
+    for (size_t frame : frames) {
+        loadStep(frame);
+    }
+    particlesHandler->remapPositions([&](const glm::vec3& position) {
+        return expanded.fromCells(previous.toCells(position));
+    });
+
+    timing.loadWait += millisecondsBetween(start, std::chrono::steady_clock::now());
+    timing.expansions++;
+}
+
+bool BatchRunner::run(const Observer& observer) {
+    timing = BatchTiming();
+    auto runStart = std::chrono::steady_clock::now();
+    if (!listFieldFiles()) return false;
+
+    mode = options.mode;
+    global_time_in_step = 0.0f;
+    one_day_simulation_period = options.period;
+    // A single background lane, so that the time step loads and the trajectory records never call into netCDF at once
+    if (options.threads > 0) {
+        executor = std::make_unique<Executor>(options.threads);
+    } else {
+        CpuTopology topology = CpuTopology::discover();
+        LOGI("batch_runner", "CPU topology: %s", topology.describe().c_str());
+        executor = std::make_unique<Executor>(topology);
+    }
+
+    // The vertices for rendering are still prepared, but only the full field is sampled by the physics
+    vectorFieldHandler = std::make_unique<VectorFieldHandler>();
+    slotFrames.clear();
+    if (!options.window.isFull()) {
+        vectorFieldHandler->setWindow(options.window);
+    }
+    if (options.sparse) {
+        vectorFieldHandler->setSparse(true);
+    }
+    if (!options.focus.isFull()) {
+        vectorFieldHandler->setFocus(options.focus);
+    }
+    if (options.stride > 1 || options.average) {
+        vectorFieldHandler->setDecimation(options.average ? VectorFieldHandler::Decimation::average : VectorFieldHandler::Decimation::stride, options.stride);
+    }
+    if (options.memoryBudget > 0) {
+        vectorFieldHandler->setMemoryBudget(options.memoryBudget);
+    }
+    if (options.linearGrid) {
+        vectorFieldHandler->setGridCoordinates(false);
+    }
+    vectorFieldHandler->setDomainBoundaries(options.boundaries);
+    physics = std::make_unique<Physics>(*vectorFieldHandler, options.model, options.dt);
+    if (options.reflectAtCoast) {
+        vectorFieldHandler->getLandMask().setBoundaryMode(LandMask::BoundaryMode::reflect);
+    }
+
+    // Same start as the app: the first two time steps in use, the third one prefetched
+    try {
+        loadStep(0);
+        loadStep(uFiles.size() > 1 ? 1 : 0);  // A single time step is a steady field
+    } catch (netCDF::exceptions::NcException& e) {
+        LOGE("batch_runner", "Failed to load the field: %s", e.what());
+        return false;
+    }
+    currentFrame = uFiles.size() > 1 ? 1 : 0;
+
+    if (!options.seedsFile.empty()) {
+        particlesHandler = std::make_unique<ParticlesHandler>(*physics, *executor, 0);
+        try {
+            // The seeds are given relative to the dataset, the simulated volume spans the window
+            std::vector<glm::vec3> positions = Emitter::readPositionsFile(options.seedsFile);
+            FieldWindow dataset = FieldWindow().resolve(vectorFieldHandler->getDatasetSize());
+            for (glm::vec3& position : positions) {
+                position = vectorFieldHandler->getWindow().fromCells(dataset.toCells(position));
+            }
+            particlesHandler->setPositions(positions);
+        } catch (netCDF::exceptions::NcException& e) {
+            LOGE("batch_runner", "Failed to read the seeds %s: %s", options.seedsFile.c_str(), e.what());
+            return false;
+        }
+    } else {
+        particlesHandler = std::make_unique<ParticlesHandler>(options.initType, *physics, *executor, options.numParticles, options.seed);
+    }
+    particlesHandler->setLandMask(&vectorFieldHandler->getLandMask());
+    particlesHandler->setDomainBoundaries(options.boundaries);
+
+    size_t numSteps = (size_t) std::ceil(options.duration / options.dt - 1.0e-4f);
+    timing.steps = numSteps;
+    timing.particles = particlesHandler->getParticlesPositions().size() / PARTICLE_STRIDE;
+    LOGI("batch_runner", "Stepping %zu particles %zu times (%s mode, dt %f)", timing.particles, numSteps,
+         options.mode == Mode::parallel ? "parallel" : "sequential", options.dt);
+
+    bool writeTrajectories = !options.output.empty() && options.saveEvery > 0 && openTrajectories();
+
+    // From here on, all netCDF calls run on the background lane (see `writeTrajectoryRecord`)
+    if (uFiles.size() > 2) {
+        currentFrame = 2;
+        pendingLoad = executor->submit(Executor::Priority::background, [this]() { loadStep(2); });
+    }
+    if (writeTrajectories) writeTrajectoryRecord(0);
+    if (observer) observer(0, particlesHandler->getParticlesPositions());
+    executor->takeBusyTimes();  // Only count the busy time of the stepping
+    auto loopStart = std::chrono::steady_clock::now();
+    timing.setup = millisecondsBetween(runStart, loopStart);
+
+    for (size_t step = 1; step <= numSteps; step++) {
+        advanceTime();
+        if (options.expandMargin > 0) {
+            checkWindow();
+        }
+
+        auto advectStart = std::chrono::steady_clock::now();
+        if (options.mode == Mode::parallel) {
+            particlesHandler->updateParticlesParallel();
+        } else {
+            particlesHandler->updateParticles();
+        }
+        timing.advect += millisecondsBetween(advectStart, std::chrono::steady_clock::now());
+
+        if (writeTrajectories && step % options.saveEvery == 0) writeTrajectoryRecord(step);
+        if (observer) observer(step, particlesHandler->getParticlesPositions());
+    }
+    timing.busyTimes = executor->takeBusyTimes();
+
+    waitForOutput();
+    waitForLoad();
+    trajectories.reset();
+    if (!options.output.empty()) {
+        writeEndpoints();
+    }
+    timing.total = millisecondsBetween(runStart, std::chrono::steady_clock::now());
+    return true;
+}
+
+const std::vector<float>& BatchRunner::gatherOutputPositions() {
+    const std::vector<float>& positions = particlesHandler->getParticlesPositions();
+    if (vectorFieldHandler->getWindow().count == vectorFieldHandler->getDatasetSize()) {
+        return positions;  // The simulated volume spans the dataset
+    }
+
+    // Map the positions from the volume of the window to the volume of the dataset, parked particles stay parked
+    FieldWindow window = vectorFieldHandler->getWindow();
+    FieldWindow dataset = FieldWindow().resolve(vectorFieldHandler->getDatasetSize());
+    outputPositions.resize(positions.size());
+    for (size_t index = 0; index < positions.size(); index += PARTICLE_STRIDE) {
+        glm::vec3 position(positions[index], positions[index + 1], positions[index + 2]);
+        if (position.x < PARKED_POSITION) {
+            position = dataset.fromCells(window.toCells(position));
+        }
+        outputPositions[index] = position.x;
+        outputPositions[index + 1] = position.y;
+        outputPositions[index + 2] = position.z;
+        outputPositions[index + 3] = positions[index + 3];
+    }
+    return outputPositions;
+}
+
+bool BatchRunner::openTrajectories() {
+    std::string filePath = options.output + "_trajectories.nc";
+    try {
+        trajectories = std::make_unique<netCDF::NcFile>(filePath, netCDF::NcFile::replace);
+        netCDF::NcDim dimTime = trajectories->addDim("time");  // Unlimited
+        netCDF::NcDim dimParticle = trajectories->addDim("particle", timing.particles);
+        trajectories->addVar("time", netCDF::ncFloat, dimTime);
+        for (const char* name : {"x", "y", "z", "age"}) {
+            trajectories->addVar(name, netCDF::ncFloat, {dimTime, dimParticle});
+        }
+        trajectories->putAtt("dt", netCDF::ncFloat, options.dt);
+        trajectories->putAtt("period", netCDF::ncFloat, options.period);
+        trajectories->putAtt("extent", netCDF::ncFloat, 3, std::vector<float>{FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH}.data());
+    } catch (netCDF::exceptions::NcException& e) {
+        LOGE("batch_runner", "Failed to create the trajectory file %s: %s", filePath.c_str(), e.what());
+        trajectories.reset();
+        return false;
+    }
+    numRecords = 0;
+    return true;
+}
+
+void BatchRunner::writeTrajectoryRecord(size_t step) {
+    // The previous record owns the buffer until it is written
+    waitForOutput();
+    recordPositions = gatherOutputPositions();
+
+    // netCDF and HDF5 are not thread-safe, so the record is written on the background lane behind the pending load
+    pendingOutput = executor->submit(Executor::Priority::background, [this, step]() {
+        auto start = std::chrono::steady_clock::now();
+        size_t numParticles = recordPositions.size() / PARTICLE_STRIDE;
+        component.resize(numParticles);
+        try {
+            float time = step * options.dt;
+            trajectories->getVar("time").putVar({numRecords}, &time);
+
+            // One variable per coordinate
+            const char* names[PARTICLE_STRIDE] = {"x", "y", "z", "age"};
+            for (size_t c = 0; c < PARTICLE_STRIDE; c++) {
+                for (size_t j = 0; j < numParticles; j++) {
+                    component[j] = recordPositions[j * PARTICLE_STRIDE + c];
+                }
+                trajectories->getVar(names[c]).putVar({numRecords, 0}, {1, numParticles}, component.data());
+            }
+            numRecords++;
+        } catch (netCDF::exceptions::NcException& e) {
+            LOGE("batch_runner", "Failed to write the trajectory record of step %zu: %s", step, e.what());
+        }
+        timing.output += millisecondsBetween(start, std::chrono::steady_clock::now());
+    });
+}
+
+void BatchRunner::writeEndpoints() {
+    auto start = std::chrono::steady_clock::now();
+    std::string filePath = options.output + "_endpoints.nc";
+    const std::vector<float>& positions = gatherOutputPositions();
+    size_t numParticles = positions.size() / PARTICLE_STRIDE;
+    component.resize(numParticles);
+    try {
+        netCDF::NcFile file(filePath, netCDF::NcFile::replace);
+        netCDF::NcDim dimParticle = file.addDim("particle", numParticles);
+
+        // Reclaimed particles keep `PARKED_POSITION`
+        const char* names[PARTICLE_STRIDE] = {"x", "y", "z", "age"};
+        for (size_t c = 0; c < PARTICLE_STRIDE; c++) {
+            for (size_t j = 0; j < numParticles; j++) {
+                component[j] = positions[j * PARTICLE_STRIDE + c];
+            }
+            file.addVar(names[c], netCDF::ncFloat, dimParticle).putVar(component.data());
+        }
+        file.putAtt("duration", netCDF::ncFloat, timing.steps * options.dt);
+        file.putAtt("dt", netCDF::ncFloat, options.dt);
+        file.putAtt("extent", netCDF::ncFloat, 3, std::vector<float>{FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH}.data());
+        file.close();
+    } catch (netCDF::exceptions::NcException& e) {
+        LOGE("batch_runner", "Failed to write the endpoints file %s: %s", filePath.c_str(), e.what());
+    }
+    timing.output += millisecondsBetween(start, std::chrono::steady_clock::now());
+}
+
+void BatchRunner::printReport(FILE* stream) {
+    double particleSteps = (double) timing.particles * timing.steps;
+    std::fprintf(stream, "particles          %zu\n", timing.particles);
+    std::fprintf(stream, "steps              %zu\n", timing.steps);
+    std::fprintf(stream, "setup              %.1f ms\n", timing.setup);
+    std::fprintf(stream, "advect             %.1f ms\n", timing.advect);
+    std::fprintf(stream, "load wait          %.1f ms\n", timing.loadWait);
+    std::fprintf(stream, "output             %.1f ms\n", timing.output);
+    std::fprintf(stream, "output wait        %.1f ms\n", timing.outputWait);
+    std::fprintf(stream, "window expansions  %zu (%s)\n", timing.expansions, vectorFieldHandler ? vectorFieldHandler->getWindow().describe().c_str() : "-");
+    if (vectorFieldHandler) {
+        std::fprintf(stream, "field grid         %d x %d x %d (stride %d)\n", vectorFieldHandler->getWidth(), vectorFieldHandler->getHeight(),
+                     vectorFieldHandler->getDepth(), vectorFieldHandler->getStride());
+    }
+    std::fprintf(stream, "total              %.1f ms\n", timing.total);
+    std::fprintf(stream, "particle steps/s   %.3g\n", timing.advect > 0.0f ? particleSteps / (timing.advect / 1000.0) : 0.0);
+    std::fprintf(stream, "worker busy time  ");
+    for (float busyTime : timing.busyTimes) {
+        std::fprintf(stream, " %.0f", busyTime);
+    }
+    std::fprintf(stream, " ms\n");
+}
@@ -0,0 +1,102 @@
+#include "include/cpu_topology.h"
+#include "include/android_logging.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+// Helper function to read a single number from a sysfs file
+static long readNumber(const std::string& path, long fallback) {
+    std::ifstream file(path);
+    long value;
+    if (file >> value) return value;
+    return fallback;
+}
+
+// Helper function to parse a CPU list, e.g., "0-3,6"
+static std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> ids;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int id = first; id <= last; id++) {
+                ids.push_back(id);
+            }
+        } catch (const std::exception&) {
+            // Skip malformed ranges
+        }
+    }
+    return ids;
+}
+
+CpuTopology CpuTopology::discover(const std::string& root) {
+    std::ifstream onlineFile(root + "/online");
+    std::string online;
+    std::vector<int> ids;
+    if (std::getline(onlineFile, online)) {
+        ids = parseCpuList(online);
+    }
+    if (ids.empty()) {
+        LOGE("cpu_topology", "Failed to read %s/online, assuming equal cores", root.c_str());
+        return uniform(std::thread::hardware_concurrency());
+    }
+
+    CpuTopology topology;
+    for (int id : ids) {
+        std::string cpu = root + "/cpu" + std::to_string(id);
+        Core core;
+        core.id = id;
+        core.capacity = readNumber(cpu + "/cpu_capacity", 0);
+        core.maxFrequency = readNumber(cpu + "/cpufreq/cpuinfo_max_freq", 0);
+        // Older kernels only expose the package of a core
+        core.cluster = (int) readNumber(cpu + "/topology/cluster_id", readNumber(cpu + "/topology/physical_package_id", 0));
+        topology.cores.push_back(core);
+    }
+
+    // The fastest cores come first, so that the slowest ones are left for the background lane
+    std::stable_sort(topology.cores.begin(), topology.cores.end(), [](const Core& a, const Core& b) {
+        return speed(a) > speed(b);
+    });
+    return topology;
+}
+
+CpuTopology CpuTopology::uniform(size_t numCores) {
+    CpuTopology topology;
+    for (size_t i = 0; i < std::max(numCores, (size_t) 1); i++) {
+        topology.cores.push_back({(int) i, 0, 0, 0});
+    }
+    return topology;
+}
+
+long CpuTopology::speed(const Core& core) {
+    return core.capacity > 0 ? core.capacity : core.maxFrequency;
+}
+
+float CpuTopology::getWeight(size_t i) const {
+    long slowest = speed(cores.back());
+    if (slowest <= 0 || speed(cores[i]) <= 0) return 1.0f;
+    return (float) speed(cores[i]) / (float) slowest;
+}
+
+bool CpuTopology::isHeterogeneous() const {
+    return getWeight(0) > 1.0f;
+}
+
+std::string CpuTopology::describe() const {
+    std::string description;
+    size_t i = 0;
+    while (i < cores.size()) {
+        // Group consecutive cores of the same speed and cluster
+        size_t j = i;
+        while (j < cores.size() && speed(cores[j]) == speed(cores[i]) && cores[j].cluster == cores[i].cluster) j++;
+        if (!description.empty()) description += ", ";
+        description += std::to_string(j - i) + "x" + std::to_string(speed(cores[i])) + " (cluster " + std::to_string(cores[i].cluster) + ")";
+        i = j;
+    }
+    return description;
+}
@@ -0,0 +1,152 @@
+#include "include/density_handler.h"
+
+#include <netcdf>
+#include <numeric>
+
+// Helper function to split [0, n) into contiguous chunks over the executor and wait for them
+template<typename F>
+void forEachChunk(Executor& executor, size_t threadCount, size_t n, F&& fn) {
+    size_t num_active_threads = std::max((size_t) 1, std::min(n, threadCount));
+    size_t batch_size = n / num_active_threads;
+    size_t remainder = n % num_active_threads;
+
+    for (size_t t = 0; t < num_active_threads; t++) {
+        size_t start = t * batch_size + std::min(t, remainder);
+        size_t end = start + batch_size + (t < remainder ? 1 : 0);
+        executor.enqueue([&fn, t, start, end]() { fn(t, start, end); });
+    }
+    executor.waitForAll();
+}
+
+DensityHandler::DensityHandler(int width, int height, int depth, int interval, int smoothingPasses) :
+        width(width), height(height), depth(depth), interval(std::max(interval, 1)), stepCounter(0), smoothingPasses(smoothingPasses), numRecords(0) {
+    size_t numCells = (size_t) width * height * depth;
+    counts.resize(numCells);
+    density.resize(numCells);
+    smoothingBuffer.resize(numCells);
+}
+
+bool DensityHandler::isDue() {
+    stepCounter = (stepCounter + 1) % interval;
+    return stepCounter == 0;
+}
+
+void DensityHandler::binRange(const std::vector<float>& particlesPos, size_t start, size_t end, std::vector<uint32_t>& histogram) {
+    for (size_t j = start; j < end; j++) {
+        size_t index = PARTICLE_STRIDE * j;
+        if (particlesPos[index] >= PARKED_POSITION) continue;  // Free slot
+
+        // Transform position [-FIELD, FIELD] range to grid indices
+        int x = (int) ((particlesPos[index] / FIELD_WIDTH + 1.0f) / 2.0f * width);
+        int y = (int) ((particlesPos[index + 1] / FIELD_HEIGHT + 1.0f) / 2.0f * height);
+        int z = (int) ((particlesPos[index + 2] / FIELD_DEPTH + 1.0f) / 2.0f * depth);
+
+        // Particles on the upper boundary belong to the last cell
+        x = std::clamp(x, 0, width - 1);
+        y = std::clamp(y, 0, height - 1);
+        z = std::clamp(z, 0, depth - 1);
+
+        histogram[(size_t) z * width * height + (size_t) y * width + x]++;
+    }
+}
+
+void DensityHandler::computeDensity(const std::vector<float>& particlesPos, Executor& executor, size_t threadCount) {
+    size_t numSlots = particlesPos.size() / PARTICLE_STRIDE;
+    size_t numCells = counts.size();
+
+    // Private histograms avoid any synchronization while binning
+    privateHistograms.resize(std::max((size_t) 1, threadCount));
+    for (auto& histogram : privateHistograms) {
+        histogram.assign(numCells, 0);
+    }
+    forEachChunk(executor, threadCount, numSlots, [this, &particlesPos](size_t t, size_t start, size_t end) {
+        binRange(particlesPos, start, end, privateHistograms[t]);
+    });
+
+    // Parallel reduction over the cells
+    forEachChunk(executor, threadCount, numCells, [this](size_t, size_t start, size_t end) {
+        for (size_t c = start; c < end; c++) {
+            uint32_t sum = 0;
+            for (auto& histogram : privateHistograms) {
+                sum += histogram[c];
+            }
+            counts[c] = sum;
+        }
+    });
+
+    // Normalize by the binned particles only, the free slots are skipped by `binRange`
+    size_t numParticles = std::accumulate(counts.begin(), counts.end(), (size_t) 0);
+    finalize(numParticles, executor, threadCount);
+}
+
+void DensityHandler::computeDensity(Mainview& mainview, Executor& executor, size_t threadCount) {
+    size_t numParticles = mainview.computeDensity(counts, glm::ivec3(width, height, depth));
+    finalize(numParticles, executor, threadCount);
+}
+
+void DensityHandler::finalize(size_t numParticles, Executor& executor, size_t threadCount) {
+    float norm = numParticles > 0 ? 1.0f / (float) numParticles : 0.0f;
+    forEachChunk(executor, threadCount, counts.size(), [this, norm](size_t, size_t start, size_t end) {
+        for (size_t c = start; c < end; c++) {
+            density[c] = counts[c] * norm;
+        }
+    });
+
+    for (int pass = 0; pass < smoothingPasses; pass++) {
+        smoothAxis(0, executor, threadCount);
+        smoothAxis(1, executor, threadCount);
+        if (depth > 1) {
+            smoothAxis(2, executor, threadCount);
+        }
+    }
+}
+
+void DensityHandler::smoothAxis(int axis, Executor& executor, size_t threadCount) {
+    const int dims[3] = {width, height, depth};
+    const size_t strides[3] = {1, (size_t) width, (size_t) width * height};
+    int size = dims[axis];
+    size_t stride = strides[axis];
+
+    forEachChunk(executor, threadCount, density.size(), [&](size_t, size_t start, size_t end) {
+        for (size_t c = start; c < end; c++) {
+            int i = (c / stride) % size;
+
+            // Mirror at the grid boundary so that the total mass is preserved
+            size_t lo = i > 0 ? c - stride : c;
+            size_t hi = i < size - 1 ? c + stride : c;
+            smoothingBuffer[c] = 0.25f * density[lo] + 0.5f * density[c] + 0.25f * density[hi];
+        }
+    });
+    std::swap(density, smoothingBuffer);
+}
+
+void DensityHandler::exportToFile(const std::string& filePath, Executor& executor) {
+    if (pendingExport.valid()) {
+        pendingExport.wait();
+    }
+    exportBuffer = density;
+    pendingExport = executor.submit(Executor::Priority::background, [this, filePath]() { writeRecord(filePath); });
+}
+
+void DensityHandler::writeRecord(const std::string& filePath) {
+    try {
+        std::vector<size_t> startp = {numRecords, 0, 0, 0};
+        std::vector<size_t> countp = {1, (size_t) depth, (size_t) height, (size_t) width};
+        if (numRecords == 0) {
+            netCDF::NcFile file(filePath, netCDF::NcFile::replace);
+            netCDF::NcDim dimT = file.addDim("time");  // Unlimited
+            netCDF::NcDim dimZ = file.addDim("depth", depth);
+            netCDF::NcDim dimY = file.addDim("lat", height);
+            netCDF::NcDim dimX = file.addDim("lon", width);
+            file.addVar("density", netCDF::ncFloat, {dimT, dimZ, dimY, dimX}).putVar(startp, countp, exportBuffer.data());
+            file.close();
+        } else {
+            netCDF::NcFile file(filePath, netCDF::NcFile::write);
+            file.getVar("density").putVar(startp, countp, exportBuffer.data());
+            file.close();
+        }
+        numRecords++;
+    } catch (netCDF::exceptions::NcException& e) {
+        LOGE("density_handler", "Failed to write density file: %s", e.what());
+    }
+}
@@ -0,0 +1,87 @@
+#include "include/divergence_tracker.h"
+#include "include/android_logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+DivergenceTracker::DivergenceTracker(size_t every) : every(std::max(every, (size_t) 1)), spool(std::tmpfile()) {
+    if (!spool) {
+        LOGE("divergence_tracker", "Failed to create the spool file of the reference");
+    }
+}
+
+DivergenceTracker::~DivergenceTracker() {
+    if (spool) {
+        std::fclose(spool);
+    }
+}
+
+void DivergenceTracker::recordReference(size_t step, const std::vector<float>& positions) {
+    if (!spool) return;
+
+    // Append after the last record, also if a step was read back in between
+    std::fseek(spool, 0, SEEK_END);
+    Record record = {std::ftell(spool), positions.size()};
+    if (std::fwrite(positions.data(), sizeof(float), positions.size(), spool) != positions.size()) {
+        LOGE("divergence_tracker", "Failed to spool the reference of step %zu", step);
+        return;
+    }
+    reference[step] = record;
+}
+
+bool DivergenceTracker::readReference(size_t step) {
+    auto found = reference.find(step);
+    if (found == reference.end()) return false;
+
+    expected.resize(found->second.size);
+    std::fflush(spool);
+    return std::fseek(spool, found->second.offset, SEEK_SET) == 0 &&
+           std::fread(expected.data(), sizeof(float), expected.size(), spool) == expected.size();
+}
+
+Divergence DivergenceTracker::compare(size_t step, const std::vector<float>& positions) {
+    Divergence divergence;
+    divergence.step = step;
+
+    bool recorded = readReference(step);
+    if (!recorded || expected.size() != positions.size()) {
+        divergence.mismatched = std::max(positions.size(), recorded ? expected.size() : 0) / PARTICLE_STRIDE;
+        divergences.push_back(divergence);
+        return divergence;
+    }
+
+    double sumSquared = 0.0;
+    for (size_t index = 0; index < positions.size(); index += PARTICLE_STRIDE) {
+        bool expectedParked = expected[index] >= PARKED_POSITION;
+        bool parked = positions[index] >= PARKED_POSITION;
+        if (expectedParked != parked) {
+            divergence.mismatched++;
+            continue;
+        }
+        if (parked) continue;
+
+        float dx = positions[index] - expected[index];
+        float dy = positions[index + 1] - expected[index + 1];
+        float dz = positions[index + 2] - expected[index + 2];
+        float squared = dx * dx + dy * dy + dz * dz;
+        divergence.maxError = std::max(divergence.maxError, std::sqrt(squared));
+        sumSquared += squared;
+        divergence.compared++;
+    }
+    if (divergence.compared > 0) {
+        divergence.rmsError = (float) std::sqrt(sumSquared / divergence.compared);
+    }
+    divergences.push_back(divergence);
+    return divergence;
+}
+
+bool DivergenceTracker::withinTolerance(float maxTolerance, float rmsTolerance) {
+    if (divergences.size() != reference.size()) return false;  // The candidate stopped early
+    for (const Divergence& divergence : divergences) {
+        // NaN positions fail the comparisons below as well
+        if (divergence.mismatched > 0 || !(divergence.maxError <= maxTolerance) || !(divergence.rmsError <= rmsTolerance)) {
+            return false;
+        }
+    }
+    return true;
+}
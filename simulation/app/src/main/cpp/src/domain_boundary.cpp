@@ -0,0 +1,34 @@
+#include "include/domain_boundary.h"
+
+#include <sstream>
+#include <vector>
+
+static const char* BOUNDARY_NAMES[] = {"clamp", "periodic", "reflect", "absorb"};
+
+bool DomainBoundaries::parse(const std::string& text, DomainBoundaries& boundaries) {
+    std::vector<DomainBoundary> parsed;
+    std::stringstream stream(text);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        int boundary = 0;
+        while (boundary < 4 && name != BOUNDARY_NAMES[boundary]) boundary++;
+        if (boundary == 4) return false;
+        parsed.push_back((DomainBoundary) boundary);
+    }
+    if (parsed.size() == 1) {
+        boundaries.axes.fill(parsed[0]);
+        return true;
+    }
+    if (parsed.size() != 3) return false;
+    std::copy(parsed.begin(), parsed.end(), boundaries.axes.begin());
+    return true;
+}
+
+std::string DomainBoundaries::describe() const {
+    std::string text;
+    for (int axis = 0; axis < 3; axis++) {
+        if (axis > 0) text += ",";
+        text += BOUNDARY_NAMES[(int) axes[axis]];
+    }
+    return text;
+}
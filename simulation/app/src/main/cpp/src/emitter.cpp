@@ -0,0 +1,61 @@
+#include "include/emitter.h"
+
+#include <netcdf>
+
+Emitter::Emitter(Type type, glm::vec3 a, glm::vec3 b, int rate, uint32_t seed) : type(type), a(a), b(b), rate(rate), seed(seed), emitted(0), next(0) {}
+
+Emitter Emitter::fromFile(const std::string &filePath, int rate) {
+    Emitter emitter(Type::file, glm::vec3(0.0f), glm::vec3(0.0f), rate);
+    emitter.positions = readPositionsFile(filePath);
+    if (emitter.positions.empty()) {
+        LOGE("emitter", "No positions loaded for file emitter");
+    }
+    return emitter;
+}
+
+std::vector<glm::vec3> Emitter::readPositionsFile(const std::string &filePath) {
+    netCDF::NcFile file(filePath, netCDF::NcFile::read);
+
+    size_t numParticles = file.getDim("particle").getSize();
+
+    // Read latitude, longitude, and depth
+    std::vector<float> lats(numParticles), lons(numParticles), depths(numParticles);
+    file.getVar("lat").getVar(lats.data());
+    file.getVar("lon").getVar(lons.data());
+    file.getVar("depth").getVar(depths.data());
+
+    // Get the max values
+    float maxLat, maxLon, maxDepth;
+    file.getAtt("max_lat").getValues(&maxLat);
+    file.getAtt("max_lon").getValues(&maxLon);
+    file.getAtt("max_depth").getValues(&maxDepth);
+
+    // Populate
+    std::vector<glm::vec3> positions(numParticles);
+    for (size_t i = 0; i < numParticles; i++) {
+        positions[i] = glm::vec3(FIELD_WIDTH * ((lons[i] / maxLon) * 2 - 1),      // X (longitude)
+                                 FIELD_HEIGHT * ((lats[i] / maxLat) * 2 - 1),     // Y (latitude)
+                                 FIELD_DEPTH * ((depths[i] / maxDepth) * 2 - 1)); // Z (depth)
+    }
+
+    file.close();
+    return positions;
+}
+
+glm::vec3 Emitter::sample() {
+    switch (type) {
+        case Type::point:
+            return a;
+        case Type::line:
+            return glm::mix(a, b, counterRandom(emitted++, seed).x);
+        case Type::box:
+            return glm::mix(a, b, glm::vec3(counterRandom(emitted++, seed)));
+        case Type::file: {
+            if (positions.empty()) return a;
+            glm::vec3 position = positions[next];
+            next = (next + 1) % positions.size();
+            return position;
+        }
+    }
+    return a;
+}
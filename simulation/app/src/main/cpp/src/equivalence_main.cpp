@@ -0,0 +1,89 @@
+#include "include/batch_runner.h"
+#include "include/divergence_tracker.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// Globals of `consts.h`, defined by `native-lib.cpp` in the app
+float global_time_in_step = 0.0f;
+float one_day_simulation_period = 0.0f;
+Mode mode = Mode::sequential;
+
+static void printUsage(const char* program) {
+    std::fprintf(stderr,
+                 "Usage: %s [shared flags] [--compare-every <n>] [--max-tolerance <d>] [--rms-tolerance <d>] --candidate [candidate flags]\n"
+                 "  The reference runs the shared flags sequentially on one worker, the candidate runs the shared flags\n"
+                 "  overridden by the candidate flags. Both take the flags of batch_runner (see batch_runner --help).\n"
+                 "  --compare-every <n>     Steps between the compared steps (default 10)\n"
+                 "  --max-tolerance <d>     Largest allowed distance of a particle from its reference (default 1e-3)\n"
+                 "  --rms-tolerance <d>     Largest allowed root mean square distance (default 1e-4)\n",
+                 program);
+}
+
+int main(int argc, char** argv) {
+    size_t compareEvery = 10;
+    float maxTolerance = 1.0e-3f;
+    float rmsTolerance = 1.0e-4f;
+
+    // Split the flags into the own flags, the shared flags, and the candidate flags
+    std::vector<char*> shared = {argv[0]};
+    std::vector<char*> candidate = {argv[0]};
+    bool inCandidate = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--candidate") == 0) {
+            inCandidate = true;
+        } else if (std::strcmp(argv[i], "--compare-every") == 0 && i + 1 < argc) {
+            compareEvery = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--max-tolerance") == 0 && i + 1 < argc) {
+            maxTolerance = std::strtof(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--rms-tolerance") == 0 && i + 1 < argc) {
+            rmsTolerance = std::strtof(argv[++i], nullptr);
+        } else {
+            (inCandidate ? candidate : shared).push_back(argv[i]);
+        }
+    }
+    if (!inCandidate) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    BatchOptions referenceOptions;
+    if (!BatchRunner::parseArguments((int) shared.size(), shared.data(), referenceOptions)) {
+        return 2;
+    }
+    BatchOptions candidateOptions = referenceOptions;
+    if (!BatchRunner::parseArguments((int) candidate.size(), candidate.data(), candidateOptions)) {
+        return 2;
+    }
+    referenceOptions.mode = Mode::sequential;
+    referenceOptions.threads = 1;
+    referenceOptions.output.clear();
+    candidateOptions.output.clear();
+
+    DivergenceTracker tracker(compareEvery);
+    LOGI("equivalence", "Running the reference");
+    {
+        BatchRunner reference(referenceOptions);
+        bool completed = reference.run([&tracker](size_t step, const std::vector<float>& positions) {
+            if (tracker.isSampled(step)) tracker.recordReference(step, positions);
+        });
+        if (!completed) return 2;
+    }
+
+    LOGI("equivalence", "Running the candidate");
+    std::printf("%8s %12s %12s %12s %10s %10s\n", "step", "time", "max", "rms", "compared", "mismatched");
+    BatchRunner runner(candidateOptions);
+    bool completed = runner.run([&tracker, &candidateOptions](size_t step, const std::vector<float>& positions) {
+        if (!tracker.isSampled(step)) return;
+        Divergence divergence = tracker.compare(step, positions);
+        std::printf("%8zu %12.4f %12.4e %12.4e %10zu %10zu\n", step, step * candidateOptions.dt,
+                    divergence.maxError, divergence.rmsError, divergence.compared, divergence.mismatched);
+    });
+    if (!completed) return 2;
+    std::printf("\n");
+    runner.printReport(stdout);
+
+    bool passed = tracker.withinTolerance(maxTolerance, rmsTolerance);
+    std::printf("\n%s (max tolerance %g, rms tolerance %g)\n", passed ? "PASSED" : "FAILED", maxTolerance, rmsTolerance);
+    return passed ? 0 : 1;
+}
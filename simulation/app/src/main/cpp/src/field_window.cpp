@@ -0,0 +1,74 @@
+#include "include/field_window.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+static const glm::vec3 FIELD_EXTENT(FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH);
+
+FieldWindow FieldWindow::resolve(const glm::ivec3& size) const {
+    FieldWindow resolved;
+    for (int axis = 0; axis < 3; axis++) {
+        int begin = std::clamp(start[axis], 0, std::max(size[axis] - 1, 0));
+        int end = count[axis] > 0 ? std::min(begin + count[axis], size[axis]) : size[axis];
+
+        // The sampler interpolates between two cells, keep at least two where the dataset has them
+        if (end - begin < 2) {
+            end = std::min(begin + 2, size[axis]);
+            begin = std::max(end - 2, 0);
+        }
+        resolved.start[axis] = begin;
+        resolved.count[axis] = end - begin;
+    }
+    return resolved;
+}
+
+FieldWindow FieldWindow::expand(const glm::ivec3& low, const glm::ivec3& high, const glm::ivec3& size) const {
+    FieldWindow expanded;
+    for (int axis = 0; axis < 3; axis++) {
+        int begin = std::max(start[axis] - low[axis], 0);
+        int end = std::min(start[axis] + count[axis] + high[axis], size[axis]);
+        expanded.start[axis] = begin;
+        expanded.count[axis] = end - begin;
+    }
+    return expanded;
+}
+
+glm::vec3 FieldWindow::toCells(const glm::vec3& position) const {
+    return glm::vec3(start) + (position / FIELD_EXTENT + 1.0f) / 2.0f * glm::vec3(count);
+}
+
+glm::vec3 FieldWindow::fromCells(const glm::vec3& cells) const {
+    return ((cells - glm::vec3(start)) / glm::vec3(count) * 2.0f - 1.0f) * FIELD_EXTENT;
+}
+
+bool FieldWindow::parse(const std::string& text, FieldWindow& window) {
+    FieldWindow parsed;
+    std::stringstream stream(text);
+    std::string range;
+    int axis = 0;
+    while (std::getline(stream, range, ',')) {
+        size_t separator = range.find(':');
+        if (axis > 2 || separator == std::string::npos) return false;
+
+        std::string begin = range.substr(0, separator);
+        std::string end = range.substr(separator + 1);
+        parsed.start[axis] = begin.empty() ? 0 : std::atoi(begin.c_str());
+        parsed.count[axis] = end.empty() ? 0 : std::atoi(end.c_str()) - parsed.start[axis];
+        if (parsed.start[axis] < 0 || parsed.count[axis] < 0) return false;
+        axis++;
+    }
+    if (axis != 3) return false;
+    window = parsed;
+    return true;
+}
+
+std::string FieldWindow::describe() const {
+    std::string text;
+    for (int axis = 0; axis < 3; axis++) {
+        if (axis > 0) text += ",";
+        text += std::to_string(start[axis]) + ":";
+        if (count[axis] > 0) text += std::to_string(start[axis] + count[axis]);
+    }
+    return text;
+}
@@ -0,0 +1,92 @@
+#include "include/frame_governor.h"
+
+#include <algorithm>
+
+// Over budget above this fraction of the target, the hysteresis band avoids reacting to vsync jitter
+static const float OVER_BUDGET = 1.1f;
+// Headroom when the frames keep up and the work fits in this fraction of the target
+static const float HEADROOM = 0.6f;
+// Factor the number of active particles is scaled by per decision
+static const float PARTICLE_STEP = 0.8f;
+
+FrameGovernor::FrameGovernor(float targetFrameTime, size_t maxParticles, size_t minParticles, int maxSubSteps, int maxFieldStride, int window) :
+        targetFrameTime(targetFrameTime), maxParticles(maxParticles), minParticles(std::min(minParticles, maxParticles)),
+        maxSubSteps(std::max(maxSubSteps, 1)), maxFieldStride(std::max(maxFieldStride, 1)), window(std::max(window, 1)),
+        activeParticles(maxParticles) {}
+
+void FrameGovernor::recordFrame(float frameTime, float simulateTime, float drawTime) {
+    numFrames++;
+    frameTimeSum += frameTime;
+    simulateTimeSum += simulateTime;
+    drawTimeSum += drawTime;
+    if (numFrames < window) return;
+
+    float avgFrameTime = frameTimeSum / numFrames;
+    float avgSimulateTime = simulateTimeSum / numFrames;
+    float avgDrawTime = drawTimeSum / numFrames;
+    float avgWorkTime = avgSimulateTime + avgDrawTime;
+    numFrames = 0;
+    frameTimeSum = simulateTimeSum = drawTimeSum = 0.0f;
+
+    // The frame time includes waiting for vsync, so headroom is judged by the measured work instead
+    if (avgFrameTime > OVER_BUDGET * targetFrameTime || avgWorkTime > targetFrameTime) {
+        headroomWindows = 0;
+        if (decrease(avgSimulateTime, avgDrawTime)) {
+            atMinimum = false;
+            logDecision("over budget", avgFrameTime, avgWorkTime);
+        } else if (!atMinimum) {
+            atMinimum = true;
+            logDecision("over budget at the minimum workload", avgFrameTime, avgWorkTime);
+        }
+    } else if (avgFrameTime <= OVER_BUDGET * targetFrameTime && avgWorkTime < HEADROOM * targetFrameTime) {
+        if (++headroomWindows >= 2 && increase(avgWorkTime)) {
+            headroomWindows = 0;
+            atMinimum = false;
+            logDecision("headroom", avgFrameTime, avgWorkTime);
+        }
+    } else {
+        headroomWindows = 0;
+    }
+}
+
+bool FrameGovernor::decrease(float simulateTime, float drawTime) {
+    if (subSteps > 1) {
+        subSteps--;
+        return true;
+    }
+    if (drawTime > simulateTime && fieldStride < maxFieldStride) {
+        fieldStride++;
+        return true;
+    }
+    if (activeParticles > minParticles) {
+        activeParticles = std::max(minParticles, (size_t) (activeParticles * PARTICLE_STEP));
+        return true;
+    }
+    if (fieldStride < maxFieldStride) {
+        fieldStride++;
+        return true;
+    }
+    return false;
+}
+
+bool FrameGovernor::increase(float workTime) {
+    if (activeParticles < maxParticles) {
+        activeParticles = std::min(maxParticles, (size_t) (activeParticles / PARTICLE_STEP) + 1);
+        return true;
+    }
+    if (fieldStride > 1) {
+        fieldStride--;
+        return true;
+    }
+    // Only add a sub-step if the extra simulation still fits in the headroom
+    if (subSteps < maxSubSteps && workTime * (subSteps + 1) / subSteps < HEADROOM * targetFrameTime) {
+        subSteps++;
+        return true;
+    }
+    return false;
+}
+
+void FrameGovernor::logDecision(const char* reason, float frameTime, float workTime) {
+    LOGI("frame_governor", "%s (frame %.1f ms, work %.1f ms, target %.1f ms): %zu particles, %d sub-steps, field stride %d",
+         reason, frameTime, workTime, targetFrameTime, activeParticles, subSteps, fieldStride);
+}
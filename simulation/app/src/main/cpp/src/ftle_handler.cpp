@@ -0,0 +1,162 @@
+#include "include/ftle_handler.h"
+
+#include <netcdf>
+#include <cmath>
+
+FTLEHandler::FTLEHandler(Physics& physics, int width, int height, int depth, float horizon) :
+        physics(physics), width(std::max(width, 2)), height(std::max(height, 2)), depth(std::max(depth, 1)), horizon(horizon) {
+    seedLattice();
+}
+
+void FTLEHandler::seedLattice() {
+    size_t num = (size_t) width * height * depth;
+    latticePos.resize(num * 3);
+
+    // Lattice spans the whole domain, a single layer lies at z = 0
+    spacing = glm::vec3(2 * FIELD_WIDTH / (width - 1), 2 * FIELD_HEIGHT / (height - 1), depth > 1 ? 2 * FIELD_DEPTH / (depth - 1) : 0.0f);
+    for (int z = 0; z < depth; z++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                glm::vec3 pos(-FIELD_WIDTH + x * spacing.x, -FIELD_HEIGHT + y * spacing.y, depth > 1 ? -FIELD_DEPTH + z * spacing.z : 0.0f);
+                size_t index = 3 * ((size_t) z * width * height + (size_t) y * width + x);
+                latticePos[index] = pos.x;
+                latticePos[index + 1] = pos.y;
+                latticePos[index + 2] = pos.z;
+            }
+        }
+    }
+}
+
+int FTLEHandler::numSteps() {
+    return std::max(1, (int) std::round(horizon / physics.dt));
+}
+
+void FTLEHandler::checkHorizon(float startTime) {
+    float overshoot = startTime + numSteps() * physics.dt - one_day_simulation_period;
+    if (overshoot > 0.0f) {
+        LOGI("ftle_handler", "FTLE horizon reaches %f past the next time step, the field is held at it", overshoot);
+    }
+}
+
+void FTLEHandler::advectRange(size_t start, size_t end, float startTime) {
+    int steps = numSteps();
+    for (size_t j = start; j < end; j++) {
+        Particle particle(glm::vec3(latticePos[3 * j], latticePos[3 * j + 1], latticePos[3 * j + 2]));
+        for (int s = 0; s < steps; s++) {
+            // Same time per step as `Mainview::advectScratch`
+            physics.advectionStep(particle, std::min(startTime + s * physics.dt, one_day_simulation_period));
+            particle.position.x = std::clamp(particle.position.x, -FIELD_WIDTH, FIELD_WIDTH);
+            particle.position.y = std::clamp(particle.position.y, -FIELD_HEIGHT, FIELD_HEIGHT);
+            particle.position.z = std::clamp(particle.position.z, -FIELD_DEPTH, FIELD_DEPTH);
+        }
+        flowMap[3 * j] = particle.position.x;
+        flowMap[3 * j + 1] = particle.position.y;
+        flowMap[3 * j + 2] = particle.position.z;
+    }
+}
+
+void FTLEHandler::ftleRange(size_t start, size_t end) {
+    auto flowAt = [this](int x, int y, int z) {
+        size_t index = 3 * ((size_t) z * width * height + (size_t) y * width + x);
+        return glm::vec3(flowMap[index], flowMap[index + 1], flowMap[index + 2]);
+    };
+
+    // Central differences in the interior, one-sided differences on the lattice boundary
+    auto derivative = [&](int x, int y, int z, int axis, int size, float h) {
+        if (size < 2) {
+            glm::vec3 unit(0.0f);
+            unit[axis] = 1.0f;
+            return unit;
+        }
+        glm::ivec3 lo(x, y, z), hi(x, y, z);
+        lo[axis] = std::max(lo[axis] - 1, 0);
+        hi[axis] = std::min(hi[axis] + 1, size - 1);
+        return (flowAt(hi.x, hi.y, hi.z) - flowAt(lo.x, lo.y, lo.z)) / ((hi[axis] - lo[axis]) * h);
+    };
+
+    float T = numSteps() * physics.dt;
+    for (size_t j = start; j < end; j++) {
+        int x = j % width;
+        int y = (j / width) % height;
+        int z = j / ((size_t) width * height);
+
+        // Columns of the flow map gradient
+        glm::mat3 F(derivative(x, y, z, 0, width, spacing.x),
+                    derivative(x, y, z, 1, height, spacing.y),
+                    derivative(x, y, z, 2, depth, spacing.z));
+        glm::mat3 C = glm::transpose(F) * F;  // Right Cauchy-Green deformation tensor
+
+        float lambdaMax = std::max(largestEigenvalue(C), 1e-12f);
+        ftleField[j] = std::log(std::sqrt(lambdaMax)) / T;
+    }
+}
+
+float FTLEHandler::largestEigenvalue(const glm::mat3& C) {
+    // Closed form for symmetric matrices (O. K. Smith, 1961)
+    float p1 = C[0][1] * C[0][1] + C[0][2] * C[0][2] + C[1][2] * C[1][2];
+    if (p1 == 0.0f) {
+        return std::max({C[0][0], C[1][1], C[2][2]});
+    }
+
+    float q = (C[0][0] + C[1][1] + C[2][2]) / 3.0f;
+    float p2 = (C[0][0] - q) * (C[0][0] - q) + (C[1][1] - q) * (C[1][1] - q) + (C[2][2] - q) * (C[2][2] - q) + 2.0f * p1;
+    float p = std::sqrt(p2 / 6.0f);
+    glm::mat3 B = (C - q * glm::mat3(1.0f)) / p;
+    float r = std::clamp(glm::determinant(B) / 2.0f, -1.0f, 1.0f);
+    float phi = std::acos(r) / 3.0f;
+
+    return q + 2.0f * p * std::cos(phi);
+}
+
+void FTLEHandler::computeFTLE(Executor& executor, size_t threadCount) {
+    size_t num = numPoints();
+    flowMap.resize(num * 3);
+    ftleField.resize(num);
+
+    size_t num_active_threads = std::max((size_t) 1, std::min(num, threadCount));
+    size_t batch_size = num / num_active_threads;
+    size_t remainder = num % num_active_threads;
+
+    // Both passes are split the same way, the gradient pass needs the whole flow map
+    float startTime = global_time_in_step;
+    checkHorizon(startTime);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t t = 0; t < num_active_threads; t++) {
+            size_t start = t * batch_size + std::min(t, remainder);
+            size_t end = start + batch_size + (t < remainder ? 1 : 0);
+            executor.enqueue([this, pass, start, end, startTime]() {
+                if (pass == 0) {
+                    advectRange(start, end, startTime);
+                } else {
+                    ftleRange(start, end);
+                }
+            });
+        }
+        executor.waitForAll();
+    }
+    LOGI("ftle_handler", "FTLE computed on CPU for %zu lattice points", num);
+}
+
+void FTLEHandler::computeFTLE(Mainview& mainview) {
+    checkHorizon(global_time_in_step);
+    ftleField.resize(numPoints());
+    mainview.computeFTLE(latticePos, ftleField, glm::ivec3(width, height, depth), spacing, numSteps(), numSteps() * physics.dt);
+    LOGI("ftle_handler", "FTLE computed on GPU for %zu lattice points", numPoints());
+}
+
+void FTLEHandler::exportToFile(const std::string& filePath) {
+    try {
+        netCDF::NcFile file(filePath, netCDF::NcFile::replace);
+        netCDF::NcDim dimZ = file.addDim("depth", depth);
+        netCDF::NcDim dimY = file.addDim("lat", height);
+        netCDF::NcDim dimX = file.addDim("lon", width);
+
+        netCDF::NcVar var = file.addVar("ftle", netCDF::ncFloat, {dimZ, dimY, dimX});
+        var.putVar(ftleField.data());
+        float T = numSteps() * physics.dt;
+        file.putAtt("horizon", netCDF::ncFloat, T);
+        file.close();
+    } catch (netCDF::exceptions::NcException& e) {
+        LOGE("ftle_handler", "Failed to write FTLE file: %s", e.what());
+    }
+}
@@ -0,0 +1,76 @@
+#include "include/grid_axis.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Relative deviation of the spacings from their mean up to which an axis is treated as uniform
+static const float UNIFORM_TOLERANCE = 1.0e-3f;
+
+// Upper bound of the lookup bins of an axis, the lookup steps over more nodes per bin beyond it
+static const int MAX_BINS = 65536;
+
+void GridAxis::setUniform(float origin, float extent) {
+    uniform = true;
+    this->origin = origin;
+    this->extent = extent;
+    coordinates.clear();
+    bins.clear();
+    numBins = 0;
+}
+
+void GridAxis::build(const std::vector<float>& coordinates, float origin, float extent) {
+    setUniform(origin, extent);
+    size_t n = coordinates.size();
+    if (n < 3) return;
+
+    // Evenly spaced axes keep the linear mapping
+    float sign = coordinates.back() < coordinates.front() ? -1.0f : 1.0f;
+    float mean = sign * (coordinates.back() - coordinates.front()) / (float) (n - 1);
+    float minSpacing = mean;
+    float maxDeviation = 0.0f;
+    for (size_t i = 1; i < n; i++) {
+        float spacing = sign * (coordinates[i] - coordinates[i - 1]);
+        minSpacing = std::min(minSpacing, spacing);
+        maxDeviation = std::max(maxDeviation, std::abs(spacing - mean));
+    }
+    if (minSpacing <= 0.0f || maxDeviation <= UNIFORM_TOLERANCE * mean) return;
+
+    uniform = false;
+    this->coordinates.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        this->coordinates[i] = sign * coordinates[i];
+    }
+    low = coordinateAt(origin);
+    high = coordinateAt(origin + extent);
+
+    // Bins no wider than the smallest spacing, so that a lookup steps to the next node at most once. Beyond
+    // `MAX_BINS` a bin spans several nodes, which `toIndex` and the compute shader both step over
+    numBins = (int) std::clamp(std::ceil((high - low) / minSpacing), 1.0f, (float) MAX_BINS);
+    bins.resize(numBins);
+    int node = 0;
+    for (int bin = 0; bin < numBins; bin++) {
+        float start = low + (high - low) * (float) bin / (float) numBins;
+        while (node < (int) n - 2 && this->coordinates[node + 1] <= start) node++;
+        bins[bin] = node;
+    }
+}
+
+float GridAxis::coordinateAt(float index) const {
+    int node = std::clamp((int) std::floor(index), 0, (int) coordinates.size() - 2);
+    return coordinates[node] + (index - (float) node) * (coordinates[node + 1] - coordinates[node]);
+}
+
+float GridAxis::toPosition(float index) const {
+    if (uniform) return (index - origin) / extent;
+    return (coordinateAt(index) - low) / (high - low);
+}
+
+int GridAxis::pack(std::vector<float>& data) const {
+    int offset = (int) data.size();
+    if (uniform) return offset;
+    data.insert(data.end(), coordinates.begin(), coordinates.end());
+    for (int32_t node : bins) {
+        data.push_back((float) node);
+    }
+    return offset;
+}
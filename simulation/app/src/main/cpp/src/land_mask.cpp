@@ -0,0 +1,177 @@
+#include "include/land_mask.h"
+
+#include <algorithm>
+
+// Distance used for cells without any feature
+static const float INF_DISTANCE = 1.0e20f;
+
+LandMask::LandMask(BoundaryMode boundaryMode) : boundaryMode(boundaryMode), built(false), numLand(0), width(0), height(0), depth(0), wrap(0) {}
+
+void LandMask::build(const std::vector<float>& uData, float fillValue, int width, int height, int depth, const std::array<GridAxis, 3>& axes,
+                     const glm::ivec3& wrap) {
+    this->width = width;
+    this->height = height;
+    this->depth = depth;
+    this->axes = axes;
+    this->wrap = wrap;
+    size_t numCells = (size_t) width * height * depth;
+
+    // Mark land cells
+    land.resize(numCells);
+    std::vector<uint8_t> sea(numCells);
+    numLand = 0;
+    for (size_t i = 0; i < numCells; i++) {
+        land[i] = isFill(uData[i], fillValue);
+        sea[i] = !land[i];
+        numLand += land[i];
+    }
+
+    // Signed distance: distance to land in the sea, minus distance to sea on land
+    std::vector<float> distToLand = distanceTransform(land);
+    std::vector<float> distToSea = distanceTransform(sea);
+
+    // Grid spacing in simulation units, the mean one on stretched axes
+    glm::vec3 h(2 * FIELD_WIDTH / axes[0].getExtent(), 2 * FIELD_HEIGHT / axes[1].getExtent(), 2 * FIELD_DEPTH / axes[2].getExtent());
+
+    // The coastline lies halfway between a land and a sea cell center
+    float halfCell = 0.5f * (depth > 1 ? std::min({h.x, h.y, h.z}) : std::min(h.x, h.y));
+    // Neighbors across the seam of a periodic axis are taken from the other side
+    auto neighbor = [&](int axis, int i, int size) {
+        return wrap[axis] ? (i + size) % size : std::clamp(i, 0, size - 1);
+    };
+    auto sdf = [&](int x, int y, int z) {
+        x = neighbor(0, x, width);
+        y = neighbor(1, y, height);
+        z = neighbor(2, z, depth);
+        size_t index = (size_t) z * width * height + (size_t) y * width + x;
+        return land[index] ? halfCell - distToSea[index] : distToLand[index] - halfCell;
+    };
+
+    // Store the normalized gradient (pointing towards the sea) next to the distance
+    distanceField.resize(numCells * 4);
+    for (int z = 0; z < depth; z++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t index = (size_t) z * width * height + (size_t) y * width + x;
+                glm::vec3 gradient((sdf(x + 1, y, z) - sdf(x - 1, y, z)) / (2 * h.x),
+                                   (sdf(x, y + 1, z) - sdf(x, y - 1, z)) / (2 * h.y),
+                                   depth > 1 ? (sdf(x, y, z + 1) - sdf(x, y, z - 1)) / (2 * h.z) : 0.0f);
+                float length = glm::length(gradient);
+                gradient = length > 1.0e-6f && length < INF_DISTANCE ? gradient / length : glm::vec3(0.0f);
+
+                distanceField[4 * index] = gradient.x;
+                distanceField[4 * index + 1] = gradient.y;
+                distanceField[4 * index + 2] = gradient.z;
+                distanceField[4 * index + 3] = sdf(x, y, z);
+            }
+        }
+    }
+
+    built = true;
+    LOGI("land_mask", "Land mask built, %zu of %zu cells are land", numLand, numCells);
+}
+
+void LandMask::reset() {
+    *this = LandMask(boundaryMode);
+}
+
+void LandMask::distanceTransform1D(float* f, int n, float h, int* v, float* z, float* d) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -INF_DISTANCE;
+    z[1] = INF_DISTANCE;
+    for (int q = 1; q < n; q++) {
+        double s;
+        while (true) {
+            // Intersection of the parabolas rooted at q and v[k]
+            s = ((f[q] + (double) (q * h) * (q * h)) - (f[v[k]] + (double) (v[k] * h) * (v[k] * h))) / (2.0 * h * (q - v[k]));
+            if (s > z[k] || k == 0) break;
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = (float) s;
+        z[k + 1] = INF_DISTANCE;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q * h) k++;
+        float dq = (q - v[k]) * h;
+        d[q] = dq * dq + f[v[k]];
+    }
+    std::copy(d, d + n, f);
+}
+
+std::vector<float> LandMask::distanceTransform(const std::vector<uint8_t>& feature) {
+    std::vector<float> f(feature.size());
+    for (size_t i = 0; i < feature.size(); i++) {
+        f[i] = feature[i] ? 0.0f : INF_DISTANCE;
+    }
+
+    const int dims[3] = {width, height, depth};
+    const size_t strides[3] = {1, (size_t) width, (size_t) width * height};
+    const float spacing[3] = {2 * FIELD_WIDTH / axes[0].getExtent(), 2 * FIELD_HEIGHT / axes[1].getExtent(), 2 * FIELD_DEPTH / axes[2].getExtent()};
+    // Periodic lines are transformed as three copies, the nearest feature of the middle copy is then found around the seam
+    int maxLine = 3 * std::max({width, height, depth});
+    std::vector<int> v(maxLine);
+    std::vector<float> z(maxLine + 1), d(maxLine), line(maxLine);
+
+    // Separable squared distance transform, one pass per axis
+    for (int axis = 0; axis < 3; axis++) {
+        int n = dims[axis];
+        int copies = wrap[axis] ? 3 : 1;
+        int offset = wrap[axis] ? n : 0;
+        size_t stride = strides[axis];
+        for (size_t start = 0; start < f.size(); start++) {
+            if ((start / stride) % n != 0) continue;  // Only the first cell of each line
+
+            for (int i = 0; i < copies * n; i++) line[i] = f[start + (i % n) * stride];
+            distanceTransform1D(line.data(), copies * n, spacing[axis], v.data(), z.data(), d.data());
+            for (int i = 0; i < n; i++) f[start + i * stride] = line[offset + i];
+        }
+    }
+
+    for (auto& value : f) {
+        value = value >= INF_DISTANCE ? INF_DISTANCE : std::sqrt(value);
+    }
+    return f;
+}
+
+glm::vec4 LandMask::sample(const glm::vec3& position) const {
+    // Transform position to grid indices as floating point
+    float fGridX = axes[0].toIndex((position.x / (float)FIELD_WIDTH + 1.0f) / 2);
+    float fGridY = axes[1].toIndex((position.y / (float)FIELD_HEIGHT + 1.0f) / 2);
+    float fGridZ = axes[2].toIndex((position.z / (float)FIELD_DEPTH + 1.0f) / 2);
+
+    // Corner indices within bounds (wrapped on periodic axes) and interpolation weights
+    int baseGridX, baseGridY, baseGridZ;
+    int nextGridX, nextGridY, nextGridZ;
+    float w_x = cornerCells(0, fGridX, width, baseGridX, nextGridX);
+    float w_y = cornerCells(1, fGridY, height, baseGridY, nextGridY);
+    float w_z = cornerCells(2, fGridZ, depth, baseGridZ, nextGridZ);
+
+    auto at = [&](int x, int y, int z) {
+        size_t index = 4 * ((size_t) std::min(z, depth - 1) * width * height + (size_t) std::min(y, height - 1) * width + std::min(x, width - 1));
+        return glm::vec4(distanceField[index], distanceField[index + 1], distanceField[index + 2], distanceField[index + 3]);
+    };
+
+    glm::vec4 c00 = glm::mix(at(baseGridX, baseGridY, baseGridZ), at(nextGridX, baseGridY, baseGridZ), w_x);
+    glm::vec4 c10 = glm::mix(at(baseGridX, nextGridY, baseGridZ), at(nextGridX, nextGridY, baseGridZ), w_x);
+    glm::vec4 c01 = glm::mix(at(baseGridX, baseGridY, nextGridZ), at(nextGridX, baseGridY, nextGridZ), w_x);
+    glm::vec4 c11 = glm::mix(at(baseGridX, nextGridY, nextGridZ), at(nextGridX, nextGridY, nextGridZ), w_x);
+
+    return glm::mix(glm::mix(c00, c10, w_y), glm::mix(c01, c11, w_y), w_z);
+}
+
+void LandMask::resolve(glm::vec3& position, const glm::vec3& previous) const {
+    glm::vec4 s = sample(position);
+    float inLand = (float) (s.w < 0.0f);
+    float penetration = std::max(-s.w, 0.0f);
+    glm::vec3 normal = glm::vec3(s) / std::max(glm::length(glm::vec3(s)), 1.0e-6f);
+
+    // Both modes are evaluated arithmetically, sea particles get a zero correction
+    float stop = (float) (boundaryMode == BoundaryMode::stop);
+    float reflect = 1.0f - stop;
+    position = glm::mix(position + (reflect * 2.0f * penetration) * normal, previous, stop * inLand);
+}
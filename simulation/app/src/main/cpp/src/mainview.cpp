@@ -5,9 +5,21 @@
 
 #include "include/mainview.h"
 
-Mainview::Mainview(AAssetManager* assetManager) {
+// Helper function to check whether the context supports an OpenGL ES extension
+static bool hasExtension(const char* name) {
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (GLint i = 0; i < numExtensions; i++) {
+        if (strcmp((const char*) glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Mainview::Mainview(AAssetManager* assetManager, const std::string& shaderCacheDir) {
     transforms = new Transforms();
-    shaderManager = new ShaderManager(assetManager);
+    shaderManager = new ShaderManager(assetManager, shaderCacheDir);
     navigCube = new NavigCube();
 }
 
@@ -16,6 +28,18 @@ Mainview::~Mainview() {
     glDeleteBuffers(1, &vectorFieldVBO);
     glDeleteBuffers(1, &computeVectorField0SSBO);
     glDeleteBuffers(1, &computeVectorField1SSBO);
+    glDeleteBuffers(1, &freeListSSBO);
+    glDeleteBuffers(1, &emittedSSBO);
+    glDeleteBuffers(1, &dispatchArgsSSBO);
+    glDeleteBuffers(1, &landMaskSSBO);
+    glDeleteBuffers(1, &brickTableSSBO);
+    glDeleteBuffers(1, &gridAxesSSBO);
+    glDeleteBuffers(1, &particleStateSSBO);
+    glDeleteBuffers(1, &physicsUBO);
+    glDeleteTextures(1, &fieldTexture0);
+    glDeleteTextures(1, &fieldTexture1);
+    glDeleteTextures(1, &fieldTexture2);
+    glDeleteQueries(2, drawTimeQueries);
 
     glDeleteVertexArrays(1, &particleVAO);
     glDeleteVertexArrays(1, &vectorFieldVAO);
@@ -28,6 +52,8 @@ Mainview::~Mainview() {
 
 
 void Mainview::setFrame() {
+    transforms->updateMVP();
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
@@ -46,7 +72,12 @@ void Mainview::loadUniforms() {
     this->projectionLocationLines = glGetUniformLocation(shaderManager->shaderLinesProgram, "projectionTransform");
     this->viewLocationLines = glGetUniformLocation(shaderManager->shaderLinesProgram, "viewTransform");
 
+    this->mvpLocationPoints = glGetUniformLocation(shaderManager->shaderPointsProgram, "mvpTransform");
+    this->mvpLocationLines = glGetUniformLocation(shaderManager->shaderLinesProgram, "mvpTransform");
+
     this->globalTimeInStepLocation = glGetUniformLocation(shaderManager->shaderComputeProgram, "global_time_in_step");
+    this->recycleClampedLocation = glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_clamped");
+    this->activeParticlesLocation = glGetUniformLocation(shaderManager->shaderComputeProgram, "active_particles");
 }
 
 
@@ -54,24 +85,43 @@ void Mainview::loadUniforms() {
 void Mainview::setupGraphics() {
     shaderManager->createShaderPrograms();
     loadUniforms();
+
+    // GPU timer queries for the draw-time comparison of the render paths
+    drawTimingSupported = hasExtension("GL_EXT_disjoint_timer_query");
+    if (drawTimingSupported) {
+        glGenQueries(2, drawTimeQueries);
+        drawTimeQueryIssued[0] = drawTimeQueryIssued[1] = false;
+    }
     navigCube->loadConstUniforms(shaderManager->shaderUIProgram);
 }
 
-void Mainview::createParticlesBuffer(std::vector<float>& particlesPos) {
+void Mainview::createParticlesBuffer(std::vector<float>& particlesPos, size_t capacity) {
     glUseProgram(shaderManager->shaderPointsProgram);
 
-    // Create VBO
+    // Create VBO, the slots beyond the given particles are free
+    numParticleSlots = particlesPos.size() / PARTICLE_STRIDE;
+    particleBufferSize = std::max(capacity, numParticleSlots) * PARTICLE_STRIDE;
+    std::vector<float> freeSlots(particleBufferSize - particlesPos.size(), PARKED_POSITION);
     glGenBuffers(1, &particleVBO);
     glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
-    glBufferData(GL_ARRAY_BUFFER, particlesPos.size() * sizeof(float), particlesPos.data(), GL_STREAM_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, particleBufferSize * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, particlesPos.size() * sizeof(float), particlesPos.data());
+    glBufferSubData(GL_ARRAY_BUFFER, particlesPos.size() * sizeof(float), freeSlots.size() * sizeof(float), freeSlots.data());
+
+    // Create free list, emission, and dispatch SSBOs
+    glGenBuffers(1, &freeListSSBO);
+    glGenBuffers(1, &emittedSSBO);
+    glGenBuffers(1, &dispatchArgsSSBO);
+    resetFreeList(particleBufferSize / PARTICLE_STRIDE);
+    resetDispatchArgs(numParticleSlots);
 
     // Create VAO
     glGenVertexArrays(1, &particleVAO);
     glBindVertexArray(particleVAO);
 
-    // Enable vertex attribute array
+    // Enable vertex attribute array, the positions are the xyz lanes of each vec4
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE * sizeof(float), (void*)0);
 
     // Unbind VAO and VBO
     glBindVertexArray(0);  // Unbind VAO
@@ -84,6 +134,17 @@ void Mainview::loadParticlesData(std::vector<float>& particlesPos) {
     glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
     glBufferData(GL_ARRAY_BUFFER, particlesPos.size() * sizeof(float), particlesPos.data(), GL_STREAM_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The GPU free list no longer matches a newly loaded particle set
+    if (mode == Mode::computeShaders && particlesPos.size() != particleBufferSize) {
+        resetFreeList(particlesPos.size() / PARTICLE_STRIDE);
+        resetDispatchArgs(particlesPos.size() / PARTICLE_STRIDE);
+        if (inertialModel && particleStateSSBO != 0) {
+            glDeleteBuffers(1, &particleStateSSBO);
+            particleStateSSBO = createScratchStateBuffer(particlesPos.size() / PARTICLE_STRIDE);
+        }
+    }
+    particleBufferSize = particlesPos.size();
 }
 
 void Mainview::drawParticles(int size) {
@@ -94,12 +155,17 @@ void Mainview::drawParticles(int size) {
 
     // Load uniforms
     glUniform1f(pointSize, 15.0f);
-    glUniformMatrix4fv(modelLocationPoints, 1, GL_TRUE, &(transforms->modelTransform)[0][0]);
-    glUniformMatrix4fv(projectionLocationPoints, 1, GL_TRUE, &(transforms->projectionTransform)[0][0]);
-    glUniformMatrix4fv(viewLocationPoints, 1, GL_TRUE, &(transforms->viewTransform)[0][0]);
-
-    // Draw
-    glDrawArrays(GL_POINTS, 0, size / 3);
+    if (renderPath == RenderPath::vertexTransform) {
+        glUniformMatrix4fv(mvpLocationPoints, 1, GL_TRUE, &(transforms->mvpTransform)[0][0]);
+    } else {
+        glUniformMatrix4fv(modelLocationPoints, 1, GL_TRUE, &(transforms->modelTransform)[0][0]);
+        glUniformMatrix4fv(projectionLocationPoints, 1, GL_TRUE, &(transforms->projectionTransform)[0][0]);
+        glUniformMatrix4fv(viewLocationPoints, 1, GL_TRUE, &(transforms->viewTransform)[0][0]);
+    }
+
+    // Draw, on the GPU the buffer may hold more slots than the CPU-side particles
+    size_t count = (mode == Mode::computeShaders ? particleBufferSize : size) / PARTICLE_STRIDE;
+    glDrawArrays(GL_POINTS, 0, std::min(count, activeParticles));
 
     // Unbind
     glBindVertexArray(0);
@@ -117,9 +183,19 @@ void Mainview::createVectorFieldBuffer(std::vector<float>& vertices) {
     glGenVertexArrays(1, &vectorFieldVAO);
     glBindVertexArray(vectorFieldVAO);
 
-    // Enable vertex attribute array
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    // Enable vertex attribute arrays
+    if (renderPath == RenderPath::vertexTransform) {
+        // One instance per vector, both end points are available to the vertex shader
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glVertexAttribDivisor(0, 1);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glVertexAttribDivisor(1, 1);
+    } else {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    }
 
     // Unbind VAO and VBO
     glBindVertexArray(0);
@@ -139,19 +215,26 @@ void Mainview::drawVectorField(int size) {
     glBindVertexArray(vectorFieldVAO);
 
     // Load uniforms
-    glUniformMatrix4fv(modelLocationLines, 1, GL_TRUE, &(transforms->modelTransform)[0][0]);
-    glUniformMatrix4fv(projectionLocationLines, 1, GL_TRUE, &transforms->projectionTransform[0][0]);
-    glUniformMatrix4fv(viewLocationLines, 1, GL_TRUE, &transforms->viewTransform[0][0]);
+    if (renderPath == RenderPath::vertexTransform) {
+        glUniformMatrix4fv(mvpLocationLines, 1, GL_TRUE, &(transforms->mvpTransform)[0][0]);
+
+        // Draw, two vertices per vector
+        glDrawArraysInstanced(GL_LINES, 0, 2, size / 6);
+    } else {
+        glUniformMatrix4fv(modelLocationLines, 1, GL_TRUE, &(transforms->modelTransform)[0][0]);
+        glUniformMatrix4fv(projectionLocationLines, 1, GL_TRUE, &transforms->projectionTransform[0][0]);
+        glUniformMatrix4fv(viewLocationLines, 1, GL_TRUE, &transforms->viewTransform[0][0]);
 
-    // Draw
-    glDrawArrays(GL_LINES, 0, size / 3);
+        // Draw
+        glDrawArrays(GL_LINES, 0, size / 3);
+    }
 
     // Unbind
     glBindVertexArray(0);
 }
 
 // Create Buffers
-void Mainview::createComputeBuffer(std::vector<float>& vector_field0, std::vector<float>& vector_field1, std::vector<float>& vector_field2) {
+void Mainview::createComputeBuffer(std::vector<float>& vector_field0, std::vector<float>& vector_field1, std::vector<float>& vector_field2, glm::ivec3 dims) {
     // Create SSBO for previous vector field
     glGenBuffers(1, &computeVectorField0SSBO);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, computeVectorField0SSBO);
@@ -169,19 +252,177 @@ void Mainview::createComputeBuffer(std::vector<float>& vector_field0, std::vecto
 
     // Unbind
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (fieldStorage != FieldStorage::textures) return;
+
+    // Full precision needs linear filtering of float textures, which is optional in GLES
+    fieldDims = dims;
+    fieldTextureFormat = hasExtension("GL_OES_texture_float_linear") ? GL_RGBA32F : GL_RGBA16F;
+    LOGI("mainview", "Vector field textures use %s", fieldTextureFormat == GL_RGBA32F ? "RGBA32F" : "RGBA16F");
+
+    // Create 3D textures for the previous, next, and to be loaded next vector field
+    for (GLuint* texture : {&fieldTexture0, &fieldTexture1, &fieldTexture2}) {
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_3D, *texture);
+        glTexStorage3D(GL_TEXTURE_3D, 1, fieldTextureFormat, dims.x, dims.y, dims.z);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // The texture units interpolate across the border of periodic axes
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, domainBoundaries.isPeriodic(0) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, domainBoundaries.isPeriodic(1) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, domainBoundaries.isPeriodic(2) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+    }
+    uploadFieldTexture(fieldTexture0, vector_field0);
+    uploadFieldTexture(fieldTexture1, vector_field1);
+    uploadFieldTexture(fieldTexture2, vector_field2);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void Mainview::uploadFieldTexture(GLuint texture, std::vector<float>& vector_field) {
+    size_t numCells = (size_t) fieldDims.x * fieldDims.y * fieldDims.z;
+    if (vector_field.size() < numCells * 6) return;
+
+    // Velocity is the difference of the end and start point of each field vertex
+    fieldTexels.resize(numCells * 4);
+    for (size_t i = 0; i < numCells; i++) {
+        fieldTexels[i * 4] = vector_field[i * 6 + 3] - vector_field[i * 6];
+        fieldTexels[i * 4 + 1] = vector_field[i * 6 + 4] - vector_field[i * 6 + 1];
+        fieldTexels[i * 4 + 2] = vector_field[i * 6 + 5] - vector_field[i * 6 + 2];
+        fieldTexels[i * 4 + 3] = 0.0f;
+    }
+
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, fieldDims.x, fieldDims.y, fieldDims.z, GL_RGBA, GL_FLOAT, fieldTexels.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void Mainview::bindFieldTextures() {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, fieldTexture0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, fieldTexture1);
+    glActiveTexture(GL_TEXTURE0);
 }
 
 void Mainview::loadConstUniforms(float dt, int width, int height, int depth) {
-    glUseProgram(shaderManager->shaderComputeProgram);
+    loadComputeConstUniforms(shaderManager->shaderComputeProgram, dt, width, height, depth);
+    // Only the simulation reclaims absorbed particles, the calibration and the cross-check leave them in place
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_absorbed"), GL_TRUE);
+
+    glUseProgram(shaderManager->shaderEmitProgram);
+    glUniform1ui(glGetUniformLocation(shaderManager->shaderEmitProgram, "advect_local_size"), localSize);
+}
+
+void Mainview::loadComputeConstUniforms(GLuint program, float dt, int width, int height, int depth) {
+    glUseProgram(program);
+
+    glUniform1i(glGetUniformLocation(program, "width"), width);
+    glUniform1i(glGetUniformLocation(program, "height"), height);
+    glUniform1i(glGetUniformLocation(program, "depth"), depth);
+    glUniform1f(glGetUniformLocation(program, "one_day_simulation_period"), (float) one_day_simulation_period);
+    glUniform1f(glGetUniformLocation(program, "dt"), dt);
+    glUniform1f(glGetUniformLocation(program, "max_width"), (float)FIELD_WIDTH);
+    glUniform1f(glGetUniformLocation(program, "max_height"), (float)FIELD_HEIGHT);
+    glUniform1f(glGetUniformLocation(program, "max_depth"), (float)FIELD_DEPTH);
+    // Without a window, the simulated volume spans the full grid
+    glm::vec3 extent = gridExtent.x > 0.0f ? gridExtent : glm::vec3(width, height, depth);
+    glUniform3fv(glGetUniformLocation(program, "grid_origin"), 1, &gridOrigin.x);
+    glUniform3fv(glGetUniformLocation(program, "grid_extent"), 1, &extent.x);
+    glUniform1i(glGetUniformLocation(program, "stretched_grid"), axisBins != glm::ivec3(0));
+    glUniform3iv(glGetUniformLocation(program, "axis_nodes"), 1, &axisNodes.x);
+    glUniform3iv(glGetUniformLocation(program, "axis_bins"), 1, &axisBins.x);
+    glUniform3iv(glGetUniformLocation(program, "axis_offset"), 1, &axisOffset.x);
+    glUniform3fv(glGetUniformLocation(program, "axis_low"), 1, &axisLow.x);
+    glUniform3fv(glGetUniformLocation(program, "axis_high"), 1, &axisHigh.x);
+    glm::ivec3 boundaries = domainBoundaries.toShader();
+    glUniform3iv(glGetUniformLocation(program, "domain_boundary"), 1, &boundaries.x);
+    if (fieldStorage == FieldStorage::textures) {
+        glUniform1i(glGetUniformLocation(program, "field0"), 0);
+        glUniform1i(glGetUniformLocation(program, "field1"), 1);
+    }
+}
+
+void Mainview::calibrateWorkgroupSize(float dt, glm::ivec3 dims) {
+    const int numRuns = 5;
+    GLint maxInvocations = 128;
+    GLint maxSizeX = 128;
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSizeX);
+    size_t numSlots = particleBufferSize / PARTICLE_STRIDE;
+
+    // Scratch copy of the particles, so that the calibration does not advance the simulation
+    GLuint scratchSSBO;
+    glGenBuffers(1, &scratchSSBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, scratchSSBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, particleBufferSize * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_READ_BUFFER, particleVBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, particleBufferSize * sizeof(float));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // Recycling and the land mask are disabled in fresh programs
+    GLuint scratchStateSSBO = createScratchStateBuffer(numSlots);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scratchSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, computeVectorField0SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, computeVectorField1SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, freeListSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, scratchStateSSBO);
+    if (fieldStorage == FieldStorage::textures) {
+        bindFieldTextures();
+    } else if (fieldStorage == FieldStorage::bricks) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, brickTableSSBO);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, gridAxesSSBO);
+
+    GLuint bestProgram = 0;
+    int bestSize = localSize;
+    float bestTime = 0.0f;
+    for (int candidate : {64, 128, 256, 512}) {
+        if (candidate > maxInvocations || candidate > maxSizeX) continue;
+
+        GLuint program = shaderManager->createComputeProgramVariant(candidate);
+        loadComputeConstUniforms(program, dt, dims.x, dims.y, dims.z);
+        glUniform1f(glGetUniformLocation(program, "global_time_in_step"), global_time_in_step);
+        GLuint numGroups = (numSlots + candidate - 1) / candidate;
+
+        // Warm up, then time a few dispatches
+        glDispatchCompute(numGroups, 1, 1);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numRuns; i++) {
+            glDispatchCompute(numGroups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        glFinish();
+        float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() / numRuns;
+        LOGI("mainview", "Workgroup size %d: %f ms per dispatch", candidate, time);
+
+        if (bestProgram == 0 || time < bestTime) {
+            if (bestProgram != 0) glDeleteProgram(bestProgram);
+            bestProgram = program;
+            bestSize = candidate;
+            bestTime = time;
+        } else {
+            glDeleteProgram(program);
+        }
+    }
+    glDeleteBuffers(1, &scratchSSBO);
+    glDeleteBuffers(1, &scratchStateSSBO);
+
+    // Replace the default program by the fastest one
+    if (bestProgram != 0) {
+        glDeleteProgram(shaderManager->shaderComputeProgram);
+        shaderManager->shaderComputeProgram = bestProgram;
+        localSize = bestSize;
+        loadUniforms();
+    }
+    resetDispatchArgs(numParticleSlots);
+    LOGI("mainview", "Calibrated particle dispatch: %s", getDispatchInfo().c_str());
+}
 
-    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "width"), width);
-    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "height"), height);
-    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "depth"), depth);
-    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "one_day_simulation_period"), (float) one_day_simulation_period);
-    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "dt"), dt);
-    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "max_width"), (float)FIELD_WIDTH);
-    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "max_height"), (float)FIELD_HEIGHT);
-    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "max_depth"), (float)FIELD_DEPTH);
+std::string Mainview::getDispatchInfo() {
+    return "workgroup size " + std::to_string(localSize) + ", " + std::to_string(numParticleSlots) + " particle slots of "
+        + std::to_string(particleBufferSize / PARTICLE_STRIDE) + ", indirect dispatch";
 }
 
 void Mainview::preloadComputeBuffer(std::vector<float>& vector_field, std::atomic<GLsync>& globalFence) {
@@ -189,6 +430,9 @@ void Mainview::preloadComputeBuffer(std::vector<float>& vector_field, std::atomi
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, computeVectorField2SSBO);
     glBufferData(GL_SHADER_STORAGE_BUFFER, vector_field.size() * sizeof(float), vector_field.data(), GL_DYNAMIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (fieldStorage == FieldStorage::textures) {
+        uploadFieldTexture(fieldTexture2, vector_field);
+    }
 
     // Setup fence to make sure the data is loaded and sync between threads before use
     GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
@@ -199,26 +443,428 @@ void Mainview::preloadComputeBuffer(std::vector<float>& vector_field, std::atomi
 void Mainview::loadComputeBuffer() {
     std::swap(computeVectorField0SSBO, computeVectorField1SSBO);
     std::swap(computeVectorField1SSBO, computeVectorField2SSBO);
+    std::swap(fieldTexture0, fieldTexture1);
+    std::swap(fieldTexture1, fieldTexture2);
 }
 
 void Mainview::dispatchComputeShader() {
     glUseProgram(shaderManager->shaderComputeProgram);
 
-    // Load uniforms
+    // Load uniforms, 0 active particles means all slots
     glUniform1f(globalTimeInStepLocation, global_time_in_step);
+    glUniform1ui(activeParticlesLocation, activeParticles < particleBufferSize / PARTICLE_STRIDE ? (GLuint) activeParticles : 0u);
 
     // Bind SSBOs
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleVBO); // Bind VBO as SSBO
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, computeVectorField0SSBO);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, computeVectorField1SSBO);
-
-    // Dispatch
-    glDispatchCompute((NUM_PARTICLES+255) / 256, 1, 1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, freeListSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, landMaskSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, particleStateSSBO);
+    if (fieldStorage == FieldStorage::textures) {
+        bindFieldTextures();
+    } else if (fieldStorage == FieldStorage::bricks) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, brickTableSSBO);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, gridAxesSSBO);
+
+    // Dispatch over the used slots, the emission grows the GPU-side group count when appending particles
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, dispatchArgsSSBO);
+    glDispatchComputeIndirect(0);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
 
     // Ensure vertex shader sees the updates
     glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 }
 
+void Mainview::computeFTLE(std::vector<float>& latticePos, std::vector<float>& ftleField, glm::ivec3 dims, glm::vec3 spacing, int steps, float horizon) {
+    GLuint latticeSSBO, ftleSSBO;
+    size_t numPoints = latticePos.size() / 3;
+
+    // The particle compute shader works on the vec4 particle layout
+    std::vector<float> latticeParticles(numPoints * PARTICLE_STRIDE, 0.0f);
+    for (size_t i = 0; i < numPoints; i++) {
+        std::copy_n(&latticePos[3 * i], 3, &latticeParticles[PARTICLE_STRIDE * i]);
+    }
+
+    // Create SSBO for the lattice (advected in place into the flow map)
+    glGenBuffers(1, &latticeSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, latticeSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, latticeParticles.size() * sizeof(float), latticeParticles.data(), GL_DYNAMIC_COPY);
+
+    // Create SSBO for the FTLE values
+    glGenBuffers(1, &ftleSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ftleSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, numPoints * sizeof(float), nullptr, GL_DYNAMIC_READ);
+
+    // Advect the lattice with the particle compute shader, lattice points are never reclaimed
+    GLuint latticeStateSSBO = createScratchStateBuffer(numPoints);
+    advectScratch(latticeSSBO, latticeStateSSBO, numPoints, steps, horizon / (float) steps);
+    glDeleteBuffers(1, &latticeStateSSBO);
+
+    // Derive the FTLE from the flow map
+    glUseProgram(shaderManager->shaderFTLEProgram);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderFTLEProgram, "lattice_width"), dims.x);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderFTLEProgram, "lattice_height"), dims.y);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderFTLEProgram, "lattice_depth"), dims.z);
+    glUniform3f(glGetUniformLocation(shaderManager->shaderFTLEProgram, "spacing"), spacing.x, spacing.y, spacing.z);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderFTLEProgram, "horizon"), horizon);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ftleSSBO);
+    glDispatchCompute((numPoints + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Read back the result
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ftleSSBO);
+    void* data = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, numPoints * sizeof(float), GL_MAP_READ_BIT);
+    if (data) {
+        std::memcpy(ftleField.data(), data, numPoints * sizeof(float));
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    } else {
+        LOGE("mainview", "Failed to map FTLE buffer");
+    }
+
+    // Cleanup
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteBuffers(1, &latticeSSBO);
+    glDeleteBuffers(1, &ftleSSBO);
+}
+
+void Mainview::stepParticles(std::vector<float>& particlesPos, std::vector<float>& state, int steps) {
+    GLuint particlesSSBO, stateSSBO;
+    size_t numParticles = particlesPos.size() / PARTICLE_STRIDE;
+
+    glGenBuffers(1, &particlesSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particlesSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, particlesPos.size() * sizeof(float), particlesPos.data(), GL_DYNAMIC_READ);
+    glGenBuffers(1, &stateSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, state.size() * sizeof(float), state.data(), GL_DYNAMIC_READ);
+
+    advectScratch(particlesSSBO, stateSSBO, numParticles, steps, 0.0f);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Read back the positions and the states
+    for (auto [ssbo, data] : {std::make_pair(particlesSSBO, &particlesPos), std::make_pair(stateSSBO, &state)}) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        void* mapped = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, data->size() * sizeof(float), GL_MAP_READ_BIT);
+        if (mapped) {
+            std::memcpy(data->data(), mapped, data->size() * sizeof(float));
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        } else {
+            LOGE("mainview", "Failed to map particle buffer");
+        }
+    }
+
+    // Cleanup
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteBuffers(1, &particlesSSBO);
+    glDeleteBuffers(1, &stateSSBO);
+}
+
+void Mainview::advectScratch(GLuint particlesSSBO, GLuint stateSSBO, size_t numParticles, int steps, float timeStep) {
+    glUseProgram(shaderManager->shaderComputeProgram);
+    glUniform1ui(activeParticlesLocation, 0u);
+    glUniform1i(recycleClampedLocation, GL_FALSE);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_region"), GL_FALSE);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "max_age"), 0.0f);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_absorbed"), GL_FALSE);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particlesSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, computeVectorField0SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, computeVectorField1SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, freeListSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, landMaskSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, stateSSBO);
+    if (fieldStorage == FieldStorage::textures) {
+        bindFieldTextures();
+    } else if (fieldStorage == FieldStorage::bricks) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, brickTableSSBO);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, gridAxesSSBO);
+    for (int i = 0; i < steps; i++) {
+        glUniform1f(globalTimeInStepLocation, std::min(global_time_in_step + i * timeStep, one_day_simulation_period));
+        glDispatchCompute((numParticles + localSize - 1) / localSize, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Restore the particle recycling
+    glUniform1i(recycleClampedLocation, recycleClamped);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_region"), recycleRegion);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "max_age"), recycleMaxAge);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_absorbed"), GL_TRUE);
+}
+
+GLuint Mainview::createScratchStateBuffer(size_t numParticles) {
+    // The advection model never reads the state, a single zeroed particle keeps the binding valid
+    std::vector<float> state((inertialModel ? std::max(numParticles, (size_t) 1) : 1) * PARTICLE_STATE_STRIDE, 0.0f);
+    GLuint stateSSBO;
+    glGenBuffers(1, &stateSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, state.size() * sizeof(float), state.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return stateSSBO;
+}
+
+void Mainview::seedParticles(uint32_t seed) {
+    glUseProgram(shaderManager->shaderSeedProgram);
+    glUniform1ui(glGetUniformLocation(shaderManager->shaderSeedProgram, "seed"), seed);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderSeedProgram, "max_width"), (float)FIELD_WIDTH);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderSeedProgram, "max_height"), (float)FIELD_HEIGHT);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderSeedProgram, "max_depth"), (float)FIELD_DEPTH);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleVBO);
+    glDispatchCompute((numParticleSlots + 255) / 256, 1, 1);
+
+    // Ensure vertex shader and the particle update see the seeded positions
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Mainview::resetFreeList(size_t numParticles) {
+    // Layout: int freeCount, uint freeIndices[numParticles]
+    std::vector<GLuint> freeList(numParticles + 1, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, freeListSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, freeList.size() * sizeof(GLuint), freeList.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::resetDispatchArgs(size_t numSlots) {
+    numParticleSlots = numSlots;
+
+    // Layout: uint numGroupsX, numGroupsY, numGroupsZ, numSlots
+    GLuint args[4] = {(GLuint) ((numSlots + localSize - 1) / localSize), 1, 1, (GLuint) numSlots};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, dispatchArgsSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(args), args, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::loadRecyclePolicy(const RecyclePolicy& policy) {
+    recycleClamped = policy.clamped;
+    recycleRegion = policy.region;
+    recycleMaxAge = policy.maxAge;
+
+    glUseProgram(shaderManager->shaderComputeProgram);
+    glUniform1i(recycleClampedLocation, recycleClamped);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "recycle_region"), recycleRegion);
+    glUniform3f(glGetUniformLocation(shaderManager->shaderComputeProgram, "region_min"), policy.regionMin.x, policy.regionMin.y, policy.regionMin.z);
+    glUniform3f(glGetUniformLocation(shaderManager->shaderComputeProgram, "region_max"), policy.regionMax.x, policy.regionMax.y, policy.regionMax.z);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "max_age"), recycleMaxAge);
+}
+
+void Mainview::createLandMaskBuffer(const LandMask& mask) {
+    glUseProgram(shaderManager->shaderComputeProgram);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderComputeProgram, "use_land_mask"), mask.hasLand());
+    glUniform1f(glGetUniformLocation(shaderManager->shaderComputeProgram, "land_stop"), mask.getBoundaryMode() == LandMask::BoundaryMode::stop ? 1.0f : 0.0f);
+
+    // The shader reads the buffer only when there is land, keep a valid binding otherwise
+    glGenBuffers(1, &landMaskSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, landMaskSSBO);
+    if (mask.hasLand()) {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, mask.getDistanceField().size() * sizeof(float), mask.getDistanceField().data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(float), nullptr, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::createBrickTableBuffer(const std::vector<int32_t>& table) {
+    glGenBuffers(1, &brickTableSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, brickTableSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, table.size() * sizeof(int32_t), table.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::createGridAxesBuffer(const std::array<GridAxis, 3>& axes) {
+    std::vector<float> data;
+    for (int axis = 0; axis < 3; axis++) {
+        axisOffset[axis] = axes[axis].pack(data);
+        axisNodes[axis] = axes[axis].getNumNodes();
+        axisBins[axis] = axes[axis].getNumBins();
+        axisLow[axis] = axes[axis].getLow();
+        axisHigh[axis] = axes[axis].getHigh();
+    }
+
+    // A uniform grid is mapped linearly by the shader, the buffer is a placeholder
+    glGenBuffers(1, &gridAxesSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridAxesSSBO);
+    if (!data.empty()) {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(float), nullptr, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::loadPhysicsConstants(const PhysicsConstants& constants) {
+    inertialModel = constants.isInertial();
+
+    if (physicsUBO == 0) {
+        glGenBuffers(1, &physicsUBO);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, physicsUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(PhysicsConstants), &constants, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, physicsUBO);
+}
+
+void Mainview::createParticleStateBuffer(std::vector<float>& state) {
+    glGenBuffers(1, &particleStateSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleStateSSBO);
+    if (inertialModel) {
+        // Cover every slot of the particle buffer, the free slots start at rest
+        size_t size = particleBufferSize / PARTICLE_STRIDE * PARTICLE_STATE_STRIDE;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+        std::vector<float> zeros(size - std::min(state.size(), size), 0.0f);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, std::min(state.size(), size) * sizeof(float), state.data());
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, std::min(state.size(), size) * sizeof(float), zeros.size() * sizeof(float), zeros.data());
+    } else {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, PARTICLE_STATE_STRIDE * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::uploadParticleSlots(std::vector<float>& particlesPos, std::vector<float>& state, const std::vector<size_t>& freeSlots) {
+    loadParticlesData(particlesPos);
+
+    // Layout: int freeCount, uint freeIndices[numParticles]
+    std::vector<GLuint> freeList(particlesPos.size() / PARTICLE_STRIDE + 1, 0);
+    freeList[0] = (GLuint) freeSlots.size();
+    std::copy(freeSlots.begin(), freeSlots.end(), freeList.begin() + 1);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, freeListSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, freeList.size() * sizeof(GLuint), freeList.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    resetDispatchArgs(particlesPos.size() / PARTICLE_STRIDE);
+
+    if (inertialModel) {
+        glDeleteBuffers(1, &particleStateSSBO);
+        createParticleStateBuffer(state);
+    }
+}
+
+void Mainview::readParticleSlots(std::vector<float>& particlesPos, std::vector<float>& state) {
+    // Make sure the compute shader writes are visible to the read back
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    particlesPos.resize(particleBufferSize);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleVBO);
+    void* data = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, particleBufferSize * sizeof(float), GL_MAP_READ_BIT);
+    if (data) {
+        std::memcpy(particlesPos.data(), data, particleBufferSize * sizeof(float));
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    } else {
+        LOGE("mainview", "Failed to map particle buffer");
+    }
+
+    if (inertialModel) {
+        state.resize(particleBufferSize / PARTICLE_STRIDE * PARTICLE_STATE_STRIDE);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleStateSSBO);
+        data = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, state.size() * sizeof(float), GL_MAP_READ_BIT);
+        if (data) {
+            std::memcpy(state.data(), data, state.size() * sizeof(float));
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        } else {
+            LOGE("mainview", "Failed to map particle state buffer");
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Mainview::emitParticles(std::vector<float>& emittedPos) {
+    if (emittedPos.empty()) return;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, emittedSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, emittedPos.size() * sizeof(float), emittedPos.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Free list must be complete before popping from it
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUseProgram(shaderManager->shaderEmitProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleVBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, freeListSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, emittedSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, dispatchArgsSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, particleStateSSBO);
+    glDispatchCompute((emittedPos.size() / 3 + 255) / 256, 1, 1);
+
+    // Ensure vertex shader and the next update see the new particles and dispatch size
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+size_t Mainview::computeDensity(std::vector<uint32_t>& counts, glm::ivec3 dims) {
+    GLuint countsSSBO;
+    counts.assign((size_t) dims.x * dims.y * dims.z, 0);
+
+    // Create zeroed SSBO for the counts
+    glGenBuffers(1, &countsSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, counts.size() * sizeof(uint32_t), counts.data(), GL_DYNAMIC_READ);
+
+    // Make sure the particle update is visible to the binning
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUseProgram(shaderManager->shaderDensityProgram);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderDensityProgram, "grid_width"), dims.x);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderDensityProgram, "grid_height"), dims.y);
+    glUniform1i(glGetUniformLocation(shaderManager->shaderDensityProgram, "grid_depth"), dims.z);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderDensityProgram, "max_width"), (float)FIELD_WIDTH);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderDensityProgram, "max_height"), (float)FIELD_HEIGHT);
+    glUniform1f(glGetUniformLocation(shaderManager->shaderDensityProgram, "max_depth"), (float)FIELD_DEPTH);
+
+    size_t numSlots = particleBufferSize / PARTICLE_STRIDE;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleVBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countsSSBO);
+    glDispatchCompute((numSlots + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Read back the result
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsSSBO);
+    void* data = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, counts.size() * sizeof(uint32_t), GL_MAP_READ_BIT);
+    if (data) {
+        std::memcpy(counts.data(), data, counts.size() * sizeof(uint32_t));
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    } else {
+        LOGE("mainview", "Failed to map density buffer");
+    }
+
+    // Cleanup
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteBuffers(1, &countsSSBO);
+
+    // The free slots are skipped by the shader, so only the binned particles count
+    return std::accumulate(counts.begin(), counts.end(), (size_t) 0);
+}
+
+void Mainview::beginDrawTiming() {
+    if (!drawTimingSupported) return;
+
+    glBeginQuery(GL_TIME_ELAPSED_EXT, drawTimeQueries[drawTimeQueryIndex]);
+}
+
+bool Mainview::endDrawTiming(float& drawTime) {
+    if (!drawTimingSupported) return false;
+
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    drawTimeQueryIssued[drawTimeQueryIndex] = true;
+    drawTimeQueryIndex = 1 - drawTimeQueryIndex;
+
+    // In the first frame the query of the previous frame was never issued, polling it is an invalid operation
+    if (!drawTimeQueryIssued[drawTimeQueryIndex]) return false;
+
+    // Read the query of the previous frame without stalling, the results are invalid after a disjoint event
+    GLuint available = 0;
+    GLint disjoint = 0;
+    glGetQueryObjectuiv(drawTimeQueries[drawTimeQueryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (!available || disjoint) return false;
+
+    GLuint elapsed = 0;
+    glGetQueryObjectuiv(drawTimeQueries[drawTimeQueryIndex], GL_QUERY_RESULT, &elapsed);
+    drawTime = elapsed / 1.0e6f;  // ns to ms
+    return true;
+}
+
+std::string Mainview::getRenderInfo() {
+    return renderPath == RenderPath::vertexTransform ? "vertex-stage MVP" : "geometry-stage MVP";
+}
+
 void Mainview::drawUI() {
     glm::vec3 rot = transforms->getRotation();
 
@@ -12,6 +12,7 @@
 #include <atomic>
 #include <functional>
 #include <regex>
+#include <future>
 
 #include "include/android_logging.h"
 #include "include/netcdf_reader.h"
@@ -21,8 +22,13 @@
 #include "include/vector_field_handler.h"
 #include "include/touch_handler.h"
 #include "include/timer.h"
-#include "include/ThreadPool.h"
+#include "include/executor.h"
 #include "include/EGLContextManager.h"
+#include "include/ftle_handler.h"
+#include "include/density_handler.h"
+#include "include/alloc_counter.h"
+#include "include/frame_governor.h"
+#include "include/app_config.h"
 
 struct appState {
     std::vector<int> fileDescriptors;
@@ -33,14 +39,33 @@ struct appState {
     TouchHandler* touchHandler;
     Physics* physics;
     Timer<std::chrono::steady_clock>* timer;
-    ThreadPool *readerThreadPool;
+    Executor *executor;  // Runs the CPU particle updates and, in the background, the time step loading
     EGLContextManager *eglContextManager;
     NetCDFReader *reader;
+    FTLEHandler *ftleHandler;
+    DensityHandler *densityHandler;
+    FrameGovernor *governor = nullptr;  // Only with ADAPTIVE_FRAME_BUDGET
+    AppConfig config;  // Startup settings, see `AppConfig`
 
+    // Runtime mode switching
+    std::atomic<int> requestedMode{-1};  // Mode requested from Java, -1 if none
+    std::chrono::steady_clock::time_point lastModeSwitch;
+    std::chrono::steady_clock::time_point lastFrameStart;
+
+    std::string filesPath;
     int currentFrame ;
     int numFrames;
     float aspectRatio;
 
+    // Progressive startup, the first frame is drawn as soon as its dependencies are ready
+    Timer<std::chrono::steady_clock>* startupTimer;
+    std::shared_future<void> particlesInit;  // Initialization of the particles
+    std::shared_future<void> fieldsInit;  // Decoding of the first two time steps
+    std::atomic<bool> positionsLoaded{true};  // Initial positions read from file (only with LOAD_POSITIONS_FROM_FILE)
+    bool buffersRequested = false;
+    bool buffersCreated = false;
+    bool firstFrameDrawn = false;
+
 };
 appState *globalAppState = new appState();
 
@@ -48,10 +73,28 @@ appState *globalAppState = new appState();
 float global_time_in_step = 0.0f;
 float one_day_simulation_period = 0.0f;
 Mode mode;
+#if USE_FIELD_TEXTURES
+FieldStorage fieldStorage = FieldStorage::textures;
+#elif USE_SPARSE_FIELD
+FieldStorage fieldStorage = FieldStorage::bricks;
+#else
+FieldStorage fieldStorage = FieldStorage::buffers;
+#endif
+#if USE_GEOMETRY_SHADERS
+RenderPath renderPath = RenderPath::geometryShaders;
+#else
+RenderPath renderPath = RenderPath::vertexTransform;
+#endif
 
 
 inline void loadStep(int frame) {
+    size_t allocations = AllocationCounter::count();
+    size_t bytes = AllocationCounter::bytes();
     globalAppState->vectorFieldHandler->loadTimeStep(*(globalAppState->reader), (globalAppState->fileDescriptors)[frame], (globalAppState->fileDescriptors)[globalAppState->numFrames + frame], (globalAppState->fileDescriptors)[2 * globalAppState->numFrames + frame]);
+    if (AllocationCounter::enabled()) {
+        // Counts all threads, so other work running in the meantime is included
+        LOGI("native-lib", "Loading step %d made %zu allocations (%zu bytes)", frame, AllocationCounter::count() - allocations, AllocationCounter::bytes() - bytes);
+    }
 }
 
 void loadInitStep() {
@@ -60,129 +103,389 @@ void loadInitStep() {
         return;
     } else if (globalAppState->numFrames == 1) {
         loadStep(0);
-    } else if (globalAppState->numFrames == 2) {
-        loadStep(0);
-        loadStep(1);
-        globalAppState->currentFrame = 1;
     } else {
+        // The third step arrives through the regular prefetch, see `prefetchInitStep`
         loadStep(0);
         loadStep(1);
-        loadStep(2);
-        globalAppState->currentFrame = 2;
+        globalAppState->currentFrame = 1;
     }
 }
 
+void prefetchInitStep() {
+    if (globalAppState->numFrames < 3) return;
+
+    // Same path as the prefetch in `check_update`, the background lane needs the shared context first
+    (globalAppState->eglContextManager)->makeCurrentOnThread(globalAppState->executor);
+    globalAppState->currentFrame = 2;
+    (globalAppState->executor)->submit(Executor::Priority::background, [appState = globalAppState]() {
+        loadStep(2);
+        (appState->mainview)->preloadComputeBuffer((appState->vectorFieldHandler)->getFutureVertices(), (appState->eglContextManager)->globalFence);
+    });
+}
+
+// Helper function to poll a startup task without blocking
+static bool isReady(const std::shared_future<void>& task) {
+    return task.valid() && task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool startupReady() {
+    return isReady(globalAppState->particlesInit) && isReady(globalAppState->fieldsInit) && globalAppState->positionsLoaded.load();
+}
+
 
 void check_update() {
     global_time_in_step += (globalAppState->physics)->dt;
     if (global_time_in_step >= one_day_simulation_period) {
         global_time_in_step = 0.0f;
 
-        (globalAppState->eglContextManager)->syncEGLContext(globalAppState->readerThreadPool);
+        (globalAppState->eglContextManager)->syncEGLContext(globalAppState->executor);
 
         (globalAppState->vectorFieldHandler)->updateTimeStep();
         (globalAppState->mainview)->loadComputeBuffer();
         globalAppState->currentFrame = (globalAppState->currentFrame + 1) % globalAppState->numFrames;
 
         LOGI("native-lib", "Loading step %d", globalAppState->currentFrame);
-        (globalAppState->readerThreadPool)->enqueue([appState = globalAppState]() {
+        (globalAppState->executor)->submit(Executor::Priority::background, [appState = globalAppState]() {
             loadStep(appState->currentFrame);
             (appState->mainview)->preloadComputeBuffer((appState->vectorFieldHandler)->getFutureVertices(), (appState->eglContextManager)->globalFence);
         });
     }
+}
+
+// Helper function to get the milliseconds between two time points
+static float millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void applyFrameBudget(std::chrono::steady_clock::time_point frameStart, std::chrono::steady_clock::time_point simulateEnd, float drawTime) {
+    FrameGovernor* governor = globalAppState->governor;
+    if (governor == nullptr) return;
+
+    // The first frame has no previous frame to measure against
+    if (globalAppState->lastFrameStart.time_since_epoch().count() != 0) {
+        governor->recordFrame(millisecondsBetween(globalAppState->lastFrameStart, frameStart), millisecondsBetween(frameStart, simulateEnd), drawTime);
+    }
+    globalAppState->lastFrameStart = frameStart;
 
-    (globalAppState->timer)->measure();
+    (globalAppState->particlesHandler)->setActiveCount(governor->getActiveParticles());
+    (globalAppState->vectorFieldHandler)->setDisplayStride(governor->getFieldStride());
 }
 
 
 void init(std::string packageName) {
-    // Choose the mode of operation
-#if USE_GPU
-    LOGI("native-lib", "Using GPU");
-    mode = Mode::computeShaders;
-#elif USE_CPU_PARALLELISM
-    LOGI("native-lib", "Using CPU parallelism");
-    mode = Mode::parallel;
+    // All CPU work shares one set of workers, the time step loading runs on its single background lane
+    CpuTopology topology = CpuTopology::discover();
+    LOGI("native-lib", "CPU topology: %s", topology.describe().c_str());
+#if PIN_WORKERS
+    globalAppState->executor = new Executor(topology, 1, true);
 #else
-    LOGI("native-lib", "Using CPU sequential");
-    mode = Mode::sequential;
+    globalAppState->executor = new Executor(topology);
 #endif
 
+    // Choose the mode of operation, all modes are compiled in and can be switched at runtime
+    AppConfig& config = globalAppState->config;
+    config = AppConfig::load(globalAppState->filesPath + "/runtime_config.txt");
+    mode = config.mode;
+    LOGI("native-lib", "Using mode %s", AppConfig::modeName(mode));
+
     // Start initialization on frame 0
     globalAppState->currentFrame = 0;
     globalAppState->touchHandler = new TouchHandler((globalAppState->mainview)->getTransforms());
     globalAppState->reader = new NetCDFReader(packageName);
 
+    // Initialize vector field handler, i.e., graphics, before the physics referencing it
+    if (config.reduceFieldGraphics) {
+        LOGI("native-lib", "Reduced field graphics");
+        globalAppState->vectorFieldHandler = new VectorFieldHandler(15, 15, 5, true);  // reduced
+    } else {
+        LOGI("native-lib", "Full field graphics");
+        globalAppState->vectorFieldHandler = new VectorFieldHandler();  // full
+    }
+
     // Choose physics preset
-#if DOUBLE_GYRE_DEFAULT_SETTINGS
-    //////////////////////// Double gyre regular scaling ////////////////////////
-    LOGI("native-lib", "Double gyre default settings");
-    one_day_simulation_period = 50.0f;
-    globalAppState->physics = new Physics(*(globalAppState->vectorFieldHandler), Physics::Model::particles_advection, 0.05f);
-    /////////////////////////////////////////////////////////////
-#elif PERLIN_DEFAULT_SETTINGS
-    //////////////////////// Perlin noise ////////////////////////
-    LOGI("native-lib", "Perlin noise default settings");
-    one_day_simulation_period = 50.0f;
-    globalAppState->physics = new Physics(*globalAppState->vectorFieldHandler, Physics::Model::particles_advection, 0.02f);
-    /////////////////////////////////////////////////////////////
-#else
-    //////////////////////// Double gyre alternative scaling ////////////////////////
-    LOGI("native-lib", "Double gyre alternative settings");
-    one_day_simulation_period = 10.0f;
-    globalAppState->physics = new Physics(*(globalAppState->vectorFieldHandler), Physics::Model::particles_advection, 0.02f);
-    /////////////////////////////////////////////////////////////
-#endif
+    switch (config.preset) {
+        case AppConfig::Preset::doubleGyre:
+            //////////////////////// Double gyre regular scaling ////////////////////////
+            LOGI("native-lib", "Double gyre default settings");
+            one_day_simulation_period = 50.0f;
+            globalAppState->physics = new Physics(*(globalAppState->vectorFieldHandler), Physics::Model::particles_advection, 0.05f);
+            /////////////////////////////////////////////////////////////
+            break;
+        case AppConfig::Preset::perlin:
+            //////////////////////// Perlin noise ////////////////////////
+            LOGI("native-lib", "Perlin noise default settings");
+            one_day_simulation_period = 50.0f;
+            globalAppState->physics = new Physics(*globalAppState->vectorFieldHandler, Physics::Model::particles_advection, 0.02f);
+            /////////////////////////////////////////////////////////////
+            break;
+        case AppConfig::Preset::doubleGyreAlt:
+            //////////////////////// Double gyre alternative scaling ////////////////////////
+            LOGI("native-lib", "Double gyre alternative settings");
+            one_day_simulation_period = 10.0f;
+            globalAppState->physics = new Physics(*(globalAppState->vectorFieldHandler), Physics::Model::particles_advection, 0.02f);
+            /////////////////////////////////////////////////////////////
+            break;
+    }
 
-    // Initialize vector field handler, i.e., graphics
-#if REDUCE_FIELD_GRAPHICS
-    LOGI("native-lib", "Reduced field graphics");
-    globalAppState->vectorFieldHandler = new VectorFieldHandler(15, 15, 5, true);  // reduced
-#else
-    LOGI("native-lib", "Full field graphics");
-    globalAppState->vectorFieldHandler = new VectorFieldHandler();  // full
+    // Restrict the loading to the region of interest, if any
+    if (!config.window.isFull()) {
+        (globalAppState->vectorFieldHandler)->setWindow(config.window);
+    }
+
+    // Skip the land-only bricks of the field, in all modes
+    if (fieldStorage == FieldStorage::bricks) {
+        (globalAppState->vectorFieldHandler)->setSparse(true);
+    }
+
+    // Sample far from the focus on the coarser levels of the pyramid, if any. The compute shaders only sample the
+    // full resolution, so the focus is ignored in that mode to keep the trajectories the same in all modes
+    if (!config.focus.isFull()) {
+        (globalAppState->vectorFieldHandler)->setFocus(config.focus);
+        if (mode == Mode::computeShaders) {
+            LOGI("native-lib", "FOCUS only applies to the CPU modes, the compute shaders sample the full resolution");
+        }
+    }
+    (globalAppState->vectorFieldHandler)->setFocusSampling(mode != Mode::computeShaders);
+
+    // Load a coarser field for previews or to fit the memory of the device, if asked
+    if (config.fieldStride > 1 || config.averageField) {
+        (globalAppState->vectorFieldHandler)->setDecimation(config.averageField ? VectorFieldHandler::Decimation::average : VectorFieldHandler::Decimation::stride, config.fieldStride);
+    }
+    if (config.fieldMemoryBudget > 0) {
+        (globalAppState->vectorFieldHandler)->setMemoryBudget(config.fieldMemoryBudget);
+    }
+
+    // Stretched grids are sampled in their coordinates unless turned off
+    if (!config.gridCoordinates) {
+        (globalAppState->vectorFieldHandler)->setGridCoordinates(false);
+    }
+
+    // Wrap the sampling around periodic axes, e.g., for global longitudes
+    (globalAppState->vectorFieldHandler)->setDomainBoundaries(config.domainBoundaries);
+
+    // Choose what happens to particles advected onto land
+#if REFLECT_AT_COAST
+    LOGI("native-lib", "Reflecting particles at the coast");
+    (globalAppState->vectorFieldHandler)->getLandMask().setBoundaryMode(LandMask::BoundaryMode::reflect);
 #endif
 
 
-    // Choose particle initialization method
+    // Particle initialization runs concurrently with the shader compilation and the field decoding
 #if LOAD_POSITIONS_FROM_FILE
-    LOGI("native-lib", "Loading particles from file");
-    globalAppState->particlesHandler = new ParticlesHandler(*globalAppState->physics, NUM_PARTICLES);  // Initialization from file
+    globalAppState->positionsLoaded = false;
+#endif
+    globalAppState->particlesInit = std::async(std::launch::async, []() {
+        // Choose particle initialization method
+#if LOAD_POSITIONS_FROM_FILE
+        LOGI("native-lib", "Loading particles from file");
+        globalAppState->particlesHandler = new ParticlesHandler(*globalAppState->physics, *globalAppState->executor, NUM_PARTICLES);  // Initialization from file
 #else
-    LOGI("native-lib", "Loading particles from code");
-    globalAppState->particlesHandler = new ParticlesHandler(ParticlesHandler::InitType::line , *(globalAppState->physics), NUM_PARTICLES);  // Diagonal line code-wise initialization
-//    globalAppState->particlesHandler = new ParticlesHandler(ParticlesHandler::InitType::uniform ,*(globalAppState->physics), NUM_PARTICLES);  // Random uniform code-wise initialization
+        LOGI("native-lib", "Loading particles from code");
+        globalAppState->particlesHandler = new ParticlesHandler(ParticlesHandler::InitType::line , *(globalAppState->physics), *(globalAppState->executor), NUM_PARTICLES);  // Diagonal line code-wise initialization
+//        globalAppState->particlesHandler = new ParticlesHandler(ParticlesHandler::InitType::uniform ,*(globalAppState->physics), *(globalAppState->executor), NUM_PARTICLES);  // Random uniform code-wise initialization
 #endif
+        (globalAppState->particlesHandler)->setLandMask(&(globalAppState->vectorFieldHandler)->getLandMask());
+        (globalAppState->particlesHandler)->setDomainBoundaries(globalAppState->config.domainBoundaries);
+
+#if RECYCLE_PARTICLES
+        // Continuously re-emit particles stuck on the walls uniformly over the domain
+        LOGI("native-lib", "Recycling particles");
+        RecyclePolicy recyclePolicy;
+        recyclePolicy.clamped = true;
+        (globalAppState->particlesHandler)->setRecyclePolicy(recyclePolicy);
+        (globalAppState->particlesHandler)->addEmitter(Emitter(Emitter::Type::box, glm::vec3(-FIELD_WIDTH, -FIELD_HEIGHT, -FIELD_DEPTH), glm::vec3(FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH), 500));
+#endif
+        (globalAppState->startupTimer)->logMilestone("particles initialized");
+    }).share();
 
-
+    globalAppState->ftleHandler = new FTLEHandler(*(globalAppState->physics));
+    globalAppState->densityHandler = new DensityHandler(64, 64, 8, 50, 1);
     globalAppState->timer = new Timer<std::chrono::steady_clock>();
-    globalAppState->readerThreadPool = new ThreadPool(1);
+    (globalAppState->timer)->setReport([executor = globalAppState->executor]() {
+        // Busy time of every worker over the logged interval, from the fastest to the slowest core
+        std::string report = "Worker busy time:";
+        for (float busyTime : executor->takeBusyTimes()) {
+            report += " " + std::to_string((int) busyTime) + " ms";
+        }
+        return report;
+    });
     globalAppState->eglContextManager = new EGLContextManager();
     LOGI("native-lib", "init complete");
 }
 
+void setTimerInfo() {
+    std::string info = std::string("mode ") + AppConfig::modeName(mode) + ", ";
+    if (mode == Mode::computeShaders) {
+        info += (globalAppState->mainview)->getDispatchInfo() + ", ";
+    }
+    (globalAppState->timer)->setInfo(info + (globalAppState->mainview)->getRenderInfo());
+}
+
+void switchMode(Mode newMode) {
+    if (newMode == mode) return;
+    LOGI("native-lib", "Switching mode from %s to %s", AppConfig::modeName(mode), AppConfig::modeName(newMode));
+
+    // The particles continue where the previous mode left them
+    (globalAppState->particlesHandler)->migrate(*(globalAppState->mainview), mode, newMode);
+    (globalAppState->vectorFieldHandler)->setFocusSampling(newMode != Mode::computeShaders);
+    mode = newMode;
+    setTimerInfo();
+    (globalAppState->timer)->start();  // Do not average the elapsed time over both modes
+    globalAppState->lastModeSwitch = std::chrono::steady_clock::now();
+}
+
+void checkModeSwitch() {
+    int requested = globalAppState->requestedMode.exchange(-1);
+    if (requested >= 0 && requested <= (int) Mode::computeShaders) {
+        switchMode((Mode) requested);
+        return;
+    }
+
+    // Cycle through the modes for back-to-back comparisons, see `AppConfig`
+    float interval = globalAppState->config.modeSwitchInterval;
+    if (interval > 0.0f && millisecondsBetween(globalAppState->lastModeSwitch, std::chrono::steady_clock::now()) >= interval * 1000.0f) {
+        switchMode((Mode) (((int) mode + 1) % ((int) Mode::computeShaders + 1)));
+    }
+}
+
+void createBuffers() {
+    // Rethrows failures of the startup tasks
+    globalAppState->particlesInit.get();
+    globalAppState->fieldsInit.get();
+
+    // The simulated volume spans the window of the field, the seeds from file are given relative to the dataset
+    VectorFieldHandler* vectorFieldHandler = globalAppState->vectorFieldHandler;
+    (globalAppState->mainview)->setGridMapping(vectorFieldHandler->getGridOrigin(), vectorFieldHandler->getGridExtent());
+    (globalAppState->mainview)->setDomainBoundaries(globalAppState->config.domainBoundaries);
+#if LOAD_POSITIONS_FROM_FILE
+    if (!globalAppState->config.window.isFull()) {
+        FieldWindow dataset = FieldWindow().resolve(vectorFieldHandler->getDatasetSize());
+        FieldWindow window = vectorFieldHandler->getWindow();
+        (globalAppState->particlesHandler)->remapPositions([&](const glm::vec3& position) {
+            return window.fromCells(dataset.toCells(position));
+        });
+    }
+#endif
+
+    (globalAppState->mainview)->createVectorFieldBuffer((globalAppState->vectorFieldHandler)->getOldVertices());
+    (globalAppState->mainview)->createParticlesBuffer((globalAppState->particlesHandler)->getParticlesPositions());
+    if ((globalAppState->particlesHandler)->isSeededOnGPU()) {
+        (globalAppState->mainview)->seedParticles((globalAppState->particlesHandler)->getSeed());
+    }
+    // The third compute buffer is a placeholder until `prefetchInitStep` preloads the third step
+    (globalAppState->mainview)->createComputeBuffer((globalAppState->vectorFieldHandler)->getOldVertices(), (globalAppState->vectorFieldHandler)->getNewVertices(), (globalAppState->vectorFieldHandler)->getNewVertices(), glm::ivec3((globalAppState->vectorFieldHandler)->getWidth(), (globalAppState->vectorFieldHandler)->getHeight(), (globalAppState->vectorFieldHandler)->getDepth()));
+    if (fieldStorage == FieldStorage::bricks) {
+        (globalAppState->mainview)->createBrickTableBuffer((globalAppState->vectorFieldHandler)->getBrickTable());
+    }
+    (globalAppState->mainview)->createGridAxesBuffer((globalAppState->vectorFieldHandler)->getGridAxes());
+    (globalAppState->mainview)->loadPhysicsConstants((globalAppState->physics)->getConstants());
+    std::vector<float> particlesState = (globalAppState->particlesHandler)->getParticlesState();
+    (globalAppState->mainview)->createParticleStateBuffer(particlesState);
+    // Calibrated in every mode, the compute shaders can be switched to at runtime
+    (globalAppState->mainview)->calibrateWorkgroupSize((globalAppState->physics)->dt, glm::ivec3((globalAppState->vectorFieldHandler)->getWidth(), (globalAppState->vectorFieldHandler)->getHeight(), (globalAppState->vectorFieldHandler)->getDepth()));
+    setTimerInfo();
+    (globalAppState->mainview)->loadConstUniforms((globalAppState->physics)->dt, (globalAppState->vectorFieldHandler)->getWidth(), (globalAppState->vectorFieldHandler)->getHeight(), (globalAppState->vectorFieldHandler)->getDepth());
+    (globalAppState->mainview)->loadRecyclePolicy((globalAppState->particlesHandler)->getRecyclePolicy());
+    (globalAppState->mainview)->createLandMaskBuffer((globalAppState->vectorFieldHandler)->getLandMask());
+    LOGI("native-lib", "Buffers created");
+
+#if CHECK_GPU_PHYSICS
+    if (mode == Mode::computeShaders) {
+        (globalAppState->particlesHandler)->crossCheckPhysics(*(globalAppState->mainview));
+    }
+#endif
+
+#if COMPUTE_FTLE
+    if (mode == Mode::computeShaders) {
+        (globalAppState->ftleHandler)->computeFTLE(*(globalAppState->mainview));
+    } else {
+        (globalAppState->ftleHandler)->computeFTLE(*(globalAppState->executor), (globalAppState->particlesHandler)->getThreadCount());
+    }
+    (globalAppState->ftleHandler)->exportToFile(globalAppState->filesPath + "/ftle.nc");
+#endif
+
+#if ADAPTIVE_FRAME_BUDGET
+    globalAppState->governor = new FrameGovernor(TARGET_FRAME_TIME, (globalAppState->particlesHandler)->getParticlesPositions().size() / PARTICLE_STRIDE);
+#endif
+
+    prefetchInitStep();
+    globalAppState->lastModeSwitch = std::chrono::steady_clock::now();
+    globalAppState->buffersCreated = true;
+    (globalAppState->startupTimer)->logMilestone("buffers created");
+}
+
 extern "C" {
     JNIEXPORT void JNICALL Java_com_rug_lagrangianfluidsimulation_MainActivity_drawFrame(JNIEnv* env, jobject /* this */) {
-        check_update();
-        (globalAppState->particlesHandler)->simulateParticles(*(globalAppState->mainview));
+        if (!globalAppState->buffersCreated) {
+            // Wait for the dependencies of the first frame without blocking the render thread
+            if (!globalAppState->buffersRequested || !startupReady()) {
+                glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                return;
+            }
+            createBuffers();
+        }
+
+        checkModeSwitch();
+
+        // Several steps per frame only if the frame budget allows it, see `FrameGovernor`
+        auto frameStart = std::chrono::steady_clock::now();
+        int subSteps = globalAppState->governor ? (globalAppState->governor)->getSubSteps() : 1;
+        for (int step = 0; step < subSteps; step++) {
+            check_update();
+            (globalAppState->particlesHandler)->simulateParticles(*(globalAppState->mainview));
+        }
+        (globalAppState->timer)->measure();
+        auto simulateEnd = std::chrono::steady_clock::now();
+#if COMPUTE_DENSITY
+        if ((globalAppState->densityHandler)->isDue()) {
+            ParticlesHandler* particlesHandler = globalAppState->particlesHandler;
+            if (mode == Mode::computeShaders) {
+                (globalAppState->densityHandler)->computeDensity(*(globalAppState->mainview), *(globalAppState->executor), particlesHandler->getThreadCount());
+            } else {
+                (globalAppState->densityHandler)->computeDensity(particlesHandler->getParticlesPositions(), *(globalAppState->executor), particlesHandler->getThreadCount());
+            }
+            (globalAppState->densityHandler)->exportToFile(globalAppState->filesPath + "/density.nc", *(globalAppState->executor));
+        }
+#endif
         (globalAppState->mainview)->setFrame();
 
+        auto drawStart = std::chrono::steady_clock::now();
+        (globalAppState->mainview)->beginDrawTiming();
         (globalAppState->vectorFieldHandler)->draw(*(globalAppState->mainview));
         (globalAppState->particlesHandler)->draw(*(globalAppState->mainview));
+        float drawTime = millisecondsBetween(drawStart, std::chrono::steady_clock::now());
+        float gpuDrawTime;
+        if ((globalAppState->mainview)->endDrawTiming(gpuDrawTime)) {
+            (globalAppState->timer)->addDrawTime(gpuDrawTime);
+            drawTime = std::max(drawTime, gpuDrawTime);
+        }
         (globalAppState->mainview)->drawUI();
+        applyFrameBudget(frameStart, simulateEnd, drawTime);
+
+        if (!globalAppState->firstFrameDrawn) {
+            globalAppState->firstFrameDrawn = true;
+            (globalAppState->startupTimer)->logMilestone("time to first frame");
+        }
     }
 
     JNIEXPORT void JNICALL Java_com_rug_lagrangianfluidsimulation_MainActivity_setupNative(JNIEnv* env, jobject obj, jobject assetManager, jstring path) {  // TODO: Rename
-        globalAppState->mainview = new Mainview(AAssetManager_fromJava(env, assetManager));
-        (globalAppState->mainview)->setupGraphics();
+        globalAppState->startupTimer = new Timer<std::chrono::steady_clock>();
+        (globalAppState->startupTimer)->start();
 
         std::string folderPath = env->GetStringUTFChars(path, nullptr);
+        globalAppState->filesPath = folderPath;
         std::regex regexPattern("/data/user/0/([^/]+)/files");
         std::smatch match;
         std::regex_search(folderPath, match, regexPattern);
         std::string packageName = match[1].str();
 
+        // Starts the particle initialization, the shaders compile meanwhile
+        globalAppState->mainview = new Mainview(AAssetManager_fromJava(env, assetManager), folderPath + "/shader_cache");
         init(packageName);
+        (globalAppState->mainview)->setupGraphics();
+        (globalAppState->startupTimer)->logMilestone("shaders ready");
+
         (globalAppState->mainview)->getTransforms().setAspectRatio(globalAppState->aspectRatio);
         (globalAppState->eglContextManager)->initContext();
         LOGI("native-lib", "Graphics setup complete");
@@ -205,17 +508,18 @@ extern "C" {
 
         env->ReleaseIntArrayElements(jfds, fds, 0);
         LOGI("native-lib", "File descriptors loaded");
-        loadInitStep();
-        LOGI("native-lib", "Initial step loaded");
+
+        // Decode the first steps in the background instead of blocking the caller
+        globalAppState->fieldsInit = (globalAppState->executor)->submit(Executor::Priority::background, []() {
+            loadInitStep();
+            (globalAppState->startupTimer)->logMilestone("initial steps decoded");
+        }).share();
     }
 
     JNIEXPORT void JNICALL
     Java_com_rug_lagrangianfluidsimulation_MainActivity_createBuffers(JNIEnv *env, jobject thiz) {
-        (globalAppState->mainview)->createVectorFieldBuffer((globalAppState->vectorFieldHandler)->getOldVertices());
-        (globalAppState->mainview)->createParticlesBuffer((globalAppState->particlesHandler)->getParticlesPositions());
-        (globalAppState->mainview)->createComputeBuffer((globalAppState->vectorFieldHandler)->getOldVertices(), (globalAppState->vectorFieldHandler)->getNewVertices(), (globalAppState->vectorFieldHandler)->getFutureVertices());
-        (globalAppState->mainview)->loadConstUniforms((globalAppState->physics)->dt, (globalAppState->vectorFieldHandler)->getWidth(), (globalAppState->vectorFieldHandler)->getHeight(), (globalAppState->vectorFieldHandler)->getDepth());
-        LOGI("native-lib", "Buffers created");
+        // Deferred to the first frame whose dependencies are ready, see `drawFrame`
+        globalAppState->buffersRequested = true;
     }
 
     JNIEXPORT void JNICALL
@@ -237,19 +541,33 @@ extern "C" {
 
     JNIEXPORT void JNICALL
     Java_com_rug_lagrangianfluidsimulation_MainActivity_onDestroyNative(JNIEnv *env, jobject thiz) {
+        // Startup tasks still running use the objects below
+        for (auto* task : {&globalAppState->particlesInit, &globalAppState->fieldsInit}) {
+            if (task->valid()) task->wait();
+        }
+        delete globalAppState->executor;  // Finishes the queued loading before the objects it uses are deleted
         delete globalAppState->mainview;
         delete globalAppState->particlesHandler;
         delete globalAppState->vectorFieldHandler;
         delete globalAppState->physics;
         delete globalAppState->touchHandler;
         delete globalAppState->timer;
-        delete globalAppState->readerThreadPool;
+        delete globalAppState->startupTimer;
         delete globalAppState->eglContextManager;
         delete globalAppState->reader;
+        delete globalAppState->ftleHandler;
+        delete globalAppState->densityHandler;
+        delete globalAppState->governor;
 
         delete globalAppState;
     }
 
+    JNIEXPORT void JNICALL
+    Java_com_rug_lagrangianfluidsimulation_MainActivity_setMode(JNIEnv *env, jobject thiz, jint newMode) {
+        // Applied by the render thread at the start of the next frame, see `checkModeSwitch`
+        globalAppState->requestedMode = newMode;
+    }
+
     JNIEXPORT void JNICALL
     Java_com_rug_lagrangianfluidsimulation_MainActivity_loadDeviceInfo(JNIEnv *env, jobject thiz, jdouble jaspectRatio) {
         globalAppState->aspectRatio = (float) jaspectRatio;
@@ -257,6 +575,8 @@ extern "C" {
 
     JNIEXPORT void JNICALL
     Java_com_rug_lagrangianfluidsimulation_FileAccessHelper_loadInitialPositions(JNIEnv *env, jobject thiz, jint fd) {
+        // The particles handler is created asynchronously during the startup
+        (globalAppState->particlesInit).wait();
         if ((globalAppState->particlesHandler)->areParticlesInitialized()) {
             return;
         }
@@ -265,11 +585,14 @@ extern "C" {
 
         if (tempFile.empty()) {
             LOGE("native-lib", "Failed to create temporary file.");
+            globalAppState->positionsLoaded = true;  // Do not hold back the first frame
             return;
         }
 
+        // The particle buffer is created from these positions once the first frame is due
         (globalAppState->particlesHandler)->loadPositionsFromFile(tempFile);
-        (globalAppState->mainview)->loadParticlesData((globalAppState->particlesHandler)->getParticlesPositions());
+        globalAppState->positionsLoaded = true;
+        (globalAppState->startupTimer)->logMilestone("initial positions loaded");
         LOGI("native-lib", "Particles initialized");
     }
 } // extern "C"
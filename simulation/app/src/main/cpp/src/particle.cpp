@@ -5,7 +5,7 @@
 #include "include/particle.h"
 
 Particle::Particle(glm::vec3 initialPosition, glm::vec3 initialVelocity, glm::vec3 initialAcceleration)
-    : position(initialPosition), velocity(initialVelocity), acceleration(initialAcceleration)  {}
+    : position(initialPosition), velocity(initialVelocity), acceleration(initialAcceleration), age(0.0f)  {}
 
 
 
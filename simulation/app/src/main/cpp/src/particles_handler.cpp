@@ -5,140 +5,245 @@
 #include "include/particles_handler.h"
 
 
-ParticlesHandler::ParticlesHandler(InitType type, Physics& physics, int num) :
-        physics(physics), num(num), pool(std::thread::hardware_concurrency()), thread_count(std::thread::hardware_concurrency()) {
+ParticlesHandler::ParticlesHandler(InitType type, Physics& physics, Executor& executor, int num, uint32_t seed) :
+        physics(physics), num(num), executor(executor), thread_count(executor.getChunkCount()), seed(seed) {
     initParticles(type);
     isInitialized = true;
-    srand(112358);  // Set rand() seed for reproducibility
 }
 
-ParticlesHandler::ParticlesHandler(Physics& physics, int num) :
-        physics(physics), num(num), pool(std::thread::hardware_concurrency()), thread_count(std::thread::hardware_concurrency()) {
+ParticlesHandler::ParticlesHandler(Physics& physics, Executor& executor, int num) :
+        physics(physics), num(num), executor(executor), thread_count(executor.getChunkCount()) {
     isInitialized = false;
 }
 
 
-void ParticlesHandler::initParticles(InitType type) {
-    particles.clear();
-    particles.reserve(num);
-    particlesPos.clear();
-    particlesPos.reserve(num * 3);
+Particle ParticlesHandler::seedParticle(InitType type, size_t i) {
     switch (type) {
-        case InitType::line:
-            for (int i = 0; i < num; i++) {
-                // Zero initial velocity, diagonal initial position
-                glm::vec3 initialVel(0.0f, 0.0f, 0.0f);
-                float xPos = FIELD_WIDTH * (2 * (i / (float) num) - 1);
-                float yPos = FIELD_HEIGHT * (2 * (i / (float) num) - 1);
-                float zPos = FIELD_DEPTH * (2 * (i / (float) num) - 1);
-                glm::vec3 initialPos(xPos, yPos, zPos);
-                particles.push_back(Particle(initialPos, initialVel));
-            }
-            break;
-        case InitType::two_lines:
-            for (int i = 0; i < num; i++) {
-                // Zero initial velocity, half-diagonal position
-                glm::vec3 initialVel(0.0f, 0.0f, 0.0f);
-                float xPos = FIELD_WIDTH * (i % 2 ? (i / (float) num) - 1 : 1 - (i / (float) num));
-                float yPos = FIELD_HEIGHT * (2 * (i / (float) num) - 1);
-                float zPos = FIELD_DEPTH * (2 * (i / (float) num) - 1);
-                glm::vec3 initialPos(xPos, yPos, zPos);
-                particles.push_back(Particle(initialPos, initialVel));
-            }
-            break;
-        case InitType::explosion:
-            for (int i = 0; i < num; i++) {
-                // Randomly generate initial velocity
-                float aspectRatio = 19.3f / 9.0f;
-                float angle = 2.0f * M_PI * rand() / (float)RAND_MAX;
-                float magnitude = 0.6f * rand() / (float)RAND_MAX;
-                float xVel = FIELD_WIDTH * (magnitude * cos(angle) / aspectRatio);
-                float yVel = FIELD_HEIGHT * (magnitude * sin(angle));
-                float zVel = FIELD_DEPTH * (2 * (i / (float) num) - 1);
-                glm::vec3 initialVel(xVel, yVel, zVel);
-                glm::vec3 initialPos(-0.25f, 0.25f, 0.0f);
-                particles.push_back(Particle(initialPos, initialVel));
-            }
-            break;
-        case InitType::uniform:
-            for (int i = 0; i < num; i++) {
-                // Randomly distribute particles uniformly over the 3D space
-
-                float xPos = FIELD_WIDTH * (2 * (rand() / (float)RAND_MAX) - 1);
-                float yPos = FIELD_HEIGHT * (2 * (rand() / (float)RAND_MAX) - 1);
-                float zPos = FIELD_DEPTH * (2 * (rand() / (float)RAND_MAX) - 1);
-
-                glm::vec3 initialPos(xPos, yPos, zPos);
-                particles.push_back(Particle(initialPos, glm::vec3(0.0f, 0.0f, 0.0f)));
-            }
-            break;
+        case InitType::line: {
+            // Zero initial velocity, diagonal initial position
+            float xPos = FIELD_WIDTH * (2 * (i / (float) num) - 1);
+            float yPos = FIELD_HEIGHT * (2 * (i / (float) num) - 1);
+            float zPos = FIELD_DEPTH * (2 * (i / (float) num) - 1);
+            return Particle(glm::vec3(xPos, yPos, zPos), glm::vec3(0.0f, 0.0f, 0.0f));
+        }
+        case InitType::two_lines: {
+            // Zero initial velocity, half-diagonal position
+            float xPos = FIELD_WIDTH * (i % 2 ? (i / (float) num) - 1 : 1 - (i / (float) num));
+            float yPos = FIELD_HEIGHT * (2 * (i / (float) num) - 1);
+            float zPos = FIELD_DEPTH * (2 * (i / (float) num) - 1);
+            return Particle(glm::vec3(xPos, yPos, zPos), glm::vec3(0.0f, 0.0f, 0.0f));
+        }
+        case InitType::explosion: {
+            // Randomly generate initial velocity, the random stream depends only on the index and seed
+            glm::vec4 r = counterRandom(i, seed);
+            float aspectRatio = 19.3f / 9.0f;
+            float angle = 2.0f * M_PI * r.x;
+            float magnitude = 0.6f * r.y;
+            float xVel = FIELD_WIDTH * (magnitude * cos(angle) / aspectRatio);
+            float yVel = FIELD_HEIGHT * (magnitude * sin(angle));
+            float zVel = FIELD_DEPTH * (2 * (i / (float) num) - 1);
+            return Particle(glm::vec3(-0.25f, 0.25f, 0.0f), glm::vec3(xVel, yVel, zVel));
+        }
+        case InitType::uniform: {
+            // Randomly distribute particles uniformly over the 3D space (mirrored in seed_compute_shader.glsl)
+            glm::vec4 r = counterRandom(i, seed);
+            float xPos = FIELD_WIDTH * (2.0f * r.x - 1.0f);
+            float yPos = FIELD_HEIGHT * (2.0f * r.y - 1.0f);
+            float zPos = FIELD_DEPTH * (2.0f * r.z - 1.0f);
+            return Particle(glm::vec3(xPos, yPos, zPos), glm::vec3(0.0f, 0.0f, 0.0f));
+        }
     }
+    return Particle();
+}
 
-    // Populate particlesPos used for rendering
-    particlesPos.clear();
-    for (auto& particle : particles) {
-        particlesPos.push_back(particle.position.x);
-        particlesPos.push_back(particle.position.y);
-        particlesPos.push_back(particle.position.z);
+void ParticlesHandler::initParticles(InitType type) {
+    initType = type;
+    particles.resize(num);
+    particlesPos.resize(num * PARTICLE_STRIDE);
+
+    // Uniform positions are generated by the seed compute shader directly into the particle buffer
+    seedOnGPU = mode == Mode::computeShaders && type == InitType::uniform;
+    if (!seedOnGPU) {
+        // Every particle only depends on its index, so the seeding is split over the executor
+        size_t num_active_threads = std::max((size_t) 1, std::min((size_t) num, thread_count));
+        size_t batch_size = num / num_active_threads;
+        size_t remainder = num % num_active_threads;
+        for (size_t t = 0; t < num_active_threads; t++) {
+            size_t start = t * batch_size + std::min(t, remainder);
+            size_t end = start + batch_size + (t < remainder ? 1 : 0);
+
+            executor.enqueue([this, type, start, end]() {
+                for (size_t j = start; j < end; j++) {
+                    particles[j] = seedParticle(type, j);
+                    storeParticle(j);  // Populate particlesPos used for rendering
+                }
+            });
+        }
+        executor.waitForAll();
     }
+    resetSlots();
+}
+
+void ParticlesHandler::resetSlots() {
+    alive.assign(particles.size(), 1);
+    freeList.clear();
+    freeList.reserve(particles.size());
+    recycledPerThread.resize(std::max(thread_count, (size_t) 1));
 }
 
-inline void ParticlesHandler::bindPosition(Particle& particle) {
-    particle.position.x = std::clamp(particle.position.x, -FIELD_WIDTH, FIELD_WIDTH);
-    particle.position.y = std::clamp(particle.position.y, -FIELD_HEIGHT, FIELD_HEIGHT);
-    particle.position.z = std::clamp(particle.position.z, -FIELD_DEPTH, FIELD_DEPTH);
+inline bool ParticlesHandler::bindPosition(Particle& particle, bool* absorbed) {
+    bool clamped;
+    bool leftVolume;
+    domainBoundaries.bind(particle.position, clamped, leftVolume);
+    if (absorbed) *absorbed = leftVolume;
+    return clamped;
 }
 
+inline bool ParticlesHandler::stepParticle(size_t j) {
+    if (!alive[j]) return false;
 
-void ParticlesHandler::updateParticles() {
-    int i = 0;
-    for (auto& particle : particles) {
-        physics.doStep(particle);
-        bindPosition(particle);
-        particlesPos[i++] = particle.position.x;
-        particlesPos[i++] = particle.position.y;
-        particlesPos[i++] = particle.position.z;
+    Particle& particle = particles[j];
+    glm::vec3 previous = particle.position;
+    physics.doStep(particle);
+    if (landMask && landMask->hasLand()) {
+        landMask->resolve(particle.position, previous);
+    }
+    bool absorbed;
+    bool clamped = bindPosition(particle, &absorbed);
+    particle.age += physics.dt;
+
+    if (absorbed || recyclePolicy.shouldRecycle(particle, clamped)) {
+        alive[j] = 0;
+        size_t index = j * PARTICLE_STRIDE;
+        particlesPos[index] = PARKED_POSITION;
+        particlesPos[index + 1] = PARKED_POSITION;
+        particlesPos[index + 2] = PARKED_POSITION;
+        particlesPos[index + 3] = 0.0f;
+        return true;
     }
+
+    storeParticle(j);
+    return false;
 }
 
-void ParticlesHandler::updateParticlesParallel() {
-    // setup threads
-    int num_threads = std::thread::hardware_concurrency();
-    std::vector<std::thread> threads(num_threads);
-    auto chunk_size = particles.size() / num_threads;
-
-    // worker function
-    auto worker = [this](auto begin, auto end, size_t start_index) {
-        size_t i = start_index;
-        for (auto it = begin; it != end; ++it) {
-            physics.doStep(*it);
-            bindPosition(*it);
-            particlesPos[i++] = it->position.x;
-            particlesPos[i++] = it->position.y;
-            particlesPos[i++] = it->position.z;
+inline void ParticlesHandler::storeParticle(size_t j) {
+    size_t index = j * PARTICLE_STRIDE;
+    particlesPos[index] = particles[j].position.x;
+    particlesPos[index + 1] = particles[j].position.y;
+    particlesPos[index + 2] = particles[j].position.z;
+    particlesPos[index + 3] = particles[j].age;
+}
+
+std::vector<float> ParticlesHandler::getParticlesState() {
+    std::vector<float> state(particles.size() * PARTICLE_STATE_STRIDE, 0.0f);
+    for (size_t j = 0; j < particles.size(); j++) {
+        size_t index = j * PARTICLE_STATE_STRIDE;
+        state[index] = particles[j].velocity.x;
+        state[index + 1] = particles[j].velocity.y;
+        state[index + 2] = particles[j].velocity.z;
+        state[index + 4] = particles[j].acceleration.x;
+        state[index + 5] = particles[j].acceleration.y;
+        state[index + 6] = particles[j].acceleration.z;
+    }
+    return state;
+}
+
+#if !HEADLESS
+float ParticlesHandler::crossCheckPhysics(Mainview& mainview, size_t numSamples, int steps) {
+    // Sample particles spread over the whole field
+    std::vector<Particle> samples(numSamples);
+    std::vector<float> samplesPos(numSamples * PARTICLE_STRIDE, 0.0f);
+    std::vector<float> samplesState(numSamples * PARTICLE_STATE_STRIDE, 0.0f);
+    for (size_t i = 0; i < numSamples; i++) {
+        samples[i] = seedParticle(InitType::uniform, i);
+        samplesPos[i * PARTICLE_STRIDE] = samples[i].position.x;
+        samplesPos[i * PARTICLE_STRIDE + 1] = samples[i].position.y;
+        samplesPos[i * PARTICLE_STRIDE + 2] = samples[i].position.z;
+        std::copy_n(&samples[i].velocity.x, 3, &samplesState[i * PARTICLE_STATE_STRIDE]);
+        std::copy_n(&samples[i].acceleration.x, 3, &samplesState[i * PARTICLE_STATE_STRIDE + 4]);
+    }
+
+    mainview.stepParticles(samplesPos, samplesState, steps);
+
+    // Same steps on the CPU, without recycling
+    float maxPosError = 0.0f;
+    float maxVelError = 0.0f;
+    for (size_t i = 0; i < numSamples; i++) {
+        Particle& particle = samples[i];
+        for (int step = 0; step < steps; step++) {
+            glm::vec3 previous = particle.position;
+            physics.doStep(particle);
+            if (landMask && landMask->hasLand()) {
+                landMask->resolve(particle.position, previous);
+            }
+            bindPosition(particle);
         }
-    };
+        glm::vec3 gpuPos(samplesPos[i * PARTICLE_STRIDE], samplesPos[i * PARTICLE_STRIDE + 1], samplesPos[i * PARTICLE_STRIDE + 2]);
+        glm::vec3 gpuVel(samplesState[i * PARTICLE_STATE_STRIDE], samplesState[i * PARTICLE_STATE_STRIDE + 1], samplesState[i * PARTICLE_STATE_STRIDE + 2]);
+        maxPosError = std::max(maxPosError, glm::length(gpuPos - particle.position));
+        if (physics.getModel() != Physics::Model::particles_advection) {
+            maxVelError = std::max(maxVelError, glm::length(gpuVel - particle.velocity));
+        }
+    }
+    LOGI("particles_handler", "GPU physics cross-check (%zu particles, %d steps): max position error %f, max velocity error %f",
+         numSamples, steps, maxPosError, maxVelError);
+    return maxPosError;
+}
+
+void ParticlesHandler::migrate(Mainview& mainview, Mode from, Mode to) {
+    bool fromGPU = from == Mode::computeShaders;
+    bool toGPU = to == Mode::computeShaders;
+    if (fromGPU == toGPU) return;  // Both CPU modes share the particle arrays
 
-    // Distribute work among threads
-    size_t start_index = 0;
-    auto begin = particles.begin();
-    for (unsigned int i = 0; i < num_threads; i++) {
-        auto end = (i == num_threads - 1) ? particles.end() : begin + chunk_size;
-        threads[i] = std::thread(worker, begin, end, start_index);
-        begin = end;
-        start_index += chunk_size * 3;
+    if (toGPU) {
+        std::vector<float> state = getParticlesState();
+        mainview.uploadParticleSlots(particlesPos, state, freeList);
+        return;
     }
 
-    // Join threads
-    for (auto& thread : threads) {
-        thread.join();
+    // Rebuild the particles from the GPU slots, free slots are parked outside of the volume
+    std::vector<float> state;
+    mainview.readParticleSlots(particlesPos, state);
+    size_t numSlots = particlesPos.size() / PARTICLE_STRIDE;
+    particles.resize(numSlots);
+    alive.assign(numSlots, 1);
+    freeList.clear();
+    for (size_t j = 0; j < numSlots; j++) {
+        size_t index = j * PARTICLE_STRIDE;
+        if (particlesPos[index] >= PARKED_POSITION) {
+            alive[j] = 0;
+            freeList.push_back(j);
+            continue;
+        }
+        Particle& particle = particles[j];
+        particle.position = glm::vec3(particlesPos[index], particlesPos[index + 1], particlesPos[index + 2]);
+        particle.age = particlesPos[index + 3];
+        if (!state.empty()) {
+            std::copy_n(&state[j * PARTICLE_STATE_STRIDE], 3, &particle.velocity.x);
+            std::copy_n(&state[j * PARTICLE_STATE_STRIDE + 4], 3, &particle.acceleration.x);
+        } else {
+            particle.velocity = glm::vec3(0.0f);
+            particle.acceleration = glm::vec3(0.0f);
+        }
     }
+    num = (int) numSlots;
+    seedOnGPU = false;
 }
+#endif
 
+void ParticlesHandler::updateParticles() {
+    size_t num_particles = getActiveCount();
+    for (size_t j = 0; j < num_particles; j++) {
+        if (stepParticle(j)) {
+            freeList.push_back(j);
+        }
+    }
+}
 
-void ParticlesHandler::updateParticlesPool() {
-    size_t num_particles = particles.size();
+void ParticlesHandler::updateParticlesParallel() {
+    size_t num_particles = getActiveCount();
     size_t num_active_threads = std::min(num_particles, thread_count);
+    if (num_active_threads == 0) return;
     size_t batch_size = num_particles / num_active_threads;
     size_t remainder = num_particles % num_active_threads;
 
@@ -146,37 +251,77 @@ void ParticlesHandler::updateParticlesPool() {
         size_t start = t * batch_size + std::min(t, remainder);
         size_t end = start + batch_size + (t < remainder ? 1 : 0);
 
-        pool.enqueue([this, start, end]() {
+        executor.enqueue([this, t, start, end]() {
+            std::vector<size_t>& recycled = recycledPerThread[t];
             for (size_t j = start; j < end; j++) {
-                physics.doStep(particles[j]);
-                bindPosition(particles[j]);
-                size_t index = j * 3;
-                particlesPos[index] = particles[j].position.x;
-                particlesPos[index + 1] = particles[j].position.y;
-                particlesPos[index + 2] = particles[j].position.z;
+                if (stepParticle(j)) {
+                    recycled.push_back(j);
+                }
             }
         });
     }
 
     // Make sure all jobs are done
-    pool.waitForAll();
+    executor.waitForAll();
+
+    // Merge the reclaimed slots into the free list
+    for (auto& recycled : recycledPerThread) {
+        freeList.insert(freeList.end(), recycled.begin(), recycled.end());
+        recycled.clear();
+    }
+}
+
+#if !HEADLESS
+void ParticlesHandler::emitParticles(Mainview& mainview) {
+    if (emitters.empty()) return;
+
+    if (mode == Mode::computeShaders) {
+        // Free slots live on the GPU, the emit shader appends as many as there are free
+        emittedPos.clear();
+        for (auto& emitter : emitters) {
+            for (int k = 0; k < emitter.getRate(); k++) {
+                glm::vec3 pos = emitter.sample();
+                emittedPos.push_back(pos.x);
+                emittedPos.push_back(pos.y);
+                emittedPos.push_back(pos.z);
+            }
+        }
+        mainview.emitParticles(emittedPos);
+        return;
+    }
+
+    for (auto& emitter : emitters) {
+        for (int k = 0; k < emitter.getRate() && !freeList.empty(); k++) {
+            size_t j = freeList.back();
+            freeList.pop_back();
+
+            particles[j] = Particle(emitter.sample());
+            alive[j] = 1;
+            storeParticle(j);
+        }
+    }
 }
 
 void ParticlesHandler::simulateParticles(Mainview& mainview) {
     if (mode == Mode::sequential) {
         updateParticles();
+        emitParticles(mainview);
         mainview.loadParticlesData(particlesPos);
     } else if (mode == Mode::parallel) {
-        updateParticlesPool();
+        updateParticlesParallel();
+        emitParticles(mainview);
         mainview.loadParticlesData(particlesPos);
     } else if (mode == Mode::computeShaders) {
+        mainview.setActiveParticles(numActive);
         mainview.dispatchComputeShader();
+        emitParticles(mainview);
     }
 }
 
 void ParticlesHandler::draw(Mainview& mainview) {
-    mainview.drawParticles(particlesPos.size());
+    mainview.drawParticles(getActiveCount() * PARTICLE_STRIDE);
 }
+#endif
 
 void ParticlesHandler::bindParticlesPositions() {
     for (auto& particle : particles) {
@@ -190,35 +335,30 @@ void ParticlesHandler::loadPositionsFromFile(const std::string &filePath) {
         std::remove(filePath.c_str());
         return;
     }
-    netCDF::NcFile file(filePath, netCDF::NcFile::read);
-
-    size_t numParticles = file.getDim("particle").getSize();
-
-    // Read latitude, longitude, and depth
-    std::vector<float> lats(numParticles), lons(numParticles), depths(numParticles);
-
-    // Get the variables
-    file.getVar("lat").getVar(lats.data());
-    file.getVar("lon").getVar(lons.data());
-    file.getVar("depth").getVar(depths.data());
-
+    setPositions(Emitter::readPositionsFile(filePath));
 
-    // Get the max values
-    float maxLat, maxLon, maxDepth;
-    file.getAtt("max_lat").getValues(&maxLat);
-    file.getAtt("max_lon").getValues(&maxLon);
-    file.getAtt("max_depth").getValues(&maxDepth);
+    // Cleanup
+    std::remove(filePath.c_str());
+}
 
+void ParticlesHandler::setPositions(const std::vector<glm::vec3>& positions) {
     // Populate
-    particlesPos.resize(numParticles * 3);
-    for (size_t i = 0; i < numParticles; i++) {
-        particlesPos[3 * i] = FIELD_WIDTH * ((lons[i] / maxLon) * 2 - 1);       // X (longitude)
-        particlesPos[3 * i + 1] = FIELD_HEIGHT *  ((lats[i] / maxLat) * 2 - 1);   // Y (latitude)
-        particlesPos[3 * i + 2] = FIELD_DEPTH *  ((depths[i] / maxDepth) * 2 - 1); // Z (depth)
+    particles.clear();
+    particles.reserve(positions.size());
+    particlesPos.resize(positions.size() * PARTICLE_STRIDE);
+    for (size_t i = 0; i < positions.size(); i++) {
+        particles.push_back(Particle(positions[i]));
+        storeParticle(i);  // X (longitude), Y (latitude), Z (depth), age
     }
+    num = (int) positions.size();
+    resetSlots();
+}
 
-    // Cleanup
-    file.close();
-    std::remove(filePath.c_str());
+void ParticlesHandler::remapPositions(const std::function<glm::vec3(const glm::vec3&)>& map) {
+    for (size_t j = 0; j < particles.size(); j++) {
+        if (!alive[j]) continue;
+        particles[j].position = map(particles[j].position);
+        storeParticle(j);
+    }
 }
 
@@ -4,15 +4,21 @@
 
 #include "include/physics.h"
 
+static_assert((int32_t) Physics::Model::particles_advection == PhysicsConstants::advectionModel, "Model values are shared with the compute shader");
+static_assert(sizeof(PhysicsConstants) == 8 * sizeof(float), "PhysicsConstants must match the std140 uniform block");
 
 Physics::Physics(VectorFieldHandler& vectorFieldHandler, Physics::Model model, float dt): vectorFieldHandler(vectorFieldHandler), model(model), dt(dt) {}
 
 // args can contain any arguments, but at least the position
 glm::vec3 Physics::dvdt(const ParticleState& state) {
+    return dvdt(state, global_time_in_step);
+}
+
+glm::vec3 Physics::dvdt(const ParticleState& state, float time) {
     glm::vec3 velField;
 
     glm::vec3 pos = state.pos;
-    vectorFieldHandler.velocityField(pos, velField); // Fluid velocity at particle's position
+    vectorFieldHandler.velocityField(pos, velField, time); // Fluid velocity at particle's position
     switch (model) {
         case Model::particles_simple: {
             // Drag force
@@ -81,13 +87,18 @@ void Physics::rk4Step(Particle& particle) {
 
 
 void Physics::advectionStep(Particle &particle) {
-    glm::vec3 v1 = dvdt({particle.position});
+    advectionStep(particle, global_time_in_step);
+}
+
+void Physics::advectionStep(Particle &particle, float time) {
+    // The stages sample the field at the start of the step, like the compute shader
+    glm::vec3 v1 = dvdt({particle.position}, time);
     glm::vec3 pos1 = particle.position + 0.5f * v1 * dt;
-    glm::vec3 v2 = dvdt({pos1});
+    glm::vec3 v2 = dvdt({pos1}, time);
     glm::vec3 pos2 = particle.position + 0.5f * v2 * dt;
-    glm::vec3 v3 = dvdt({pos2});
+    glm::vec3 v3 = dvdt({pos2}, time);
     glm::vec3 pos3 = particle.position + v3 * dt;
-    glm::vec3 v4 = dvdt({pos3});
+    glm::vec3 v4 = dvdt({pos3}, time);
 
     particle.position += dt * (v1 + 2.0f * v2 + 2.0f * v3 + v4) / 6.0f;
 }
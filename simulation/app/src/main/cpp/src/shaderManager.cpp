@@ -4,13 +4,22 @@
 
 #include "include/shaderManager.h"
 
-ShaderManager::ShaderManager(AAssetManager *assetManager): assetManager(assetManager) {}
+#include <sys/stat.h>
+
+// Identifies the files of the program binary cache
+static const uint32_t CACHE_MAGIC = 0x4c465342;  // "LFSB"
+
+ShaderManager::ShaderManager(AAssetManager *assetManager, const std::string& cacheDir): assetManager(assetManager), cacheDir(cacheDir) {}
 
 ShaderManager::~ShaderManager() {
     glDeleteProgram(shaderLinesProgram);
     glDeleteProgram(shaderPointsProgram);
     glDeleteProgram(shaderComputeProgram);
     glDeleteProgram(shaderUIProgram);
+    glDeleteProgram(shaderFTLEProgram);
+    glDeleteProgram(shaderDensityProgram);
+    glDeleteProgram(shaderEmitProgram);
+    glDeleteProgram(shaderSeedProgram);
 }
 
 
@@ -26,6 +35,22 @@ std::string ShaderManager::loadShaderFile(const char* fileName) {
     return buffer;
 }
 
+void ShaderManager::injectDefines(std::string& source, const std::string& defines) {
+    size_t versionEnd = source.find('\n');
+    if (versionEnd == std::string::npos) return;
+    source.insert(versionEnd + 1, defines);
+}
+
+std::string ShaderManager::computeShaderDefines(int localSizeX) {
+    std::string defines = "#define LOCAL_SIZE_X " + std::to_string(localSizeX) + "\n";
+    if (fieldStorage == FieldStorage::textures) {
+        defines += "#define USE_FIELD_TEXTURE\n";
+    } else if (fieldStorage == FieldStorage::bricks) {
+        defines += "#define USE_SPARSE_FIELD\n";
+    }
+    return defines;
+}
+
 // Helper function to compile a shader from a `.glsl` file
 void compileShaderHelper(GLuint& shader, const std::string& shaderSource, GLenum type) {
     GLint compileSuccess = 0;
@@ -42,7 +67,12 @@ void compileShaderHelper(GLuint& shader, const std::string& shaderSource, GLenum
 }
 
 void ShaderManager::compileVertexShaders() {
-    compileShaderHelper(vertexShader, vertexShaderSource, GL_VERTEX_SHADER);
+    if (renderPath == RenderPath::geometryShaders) {
+        compileShaderHelper(vertexShader, vertexShaderSource, GL_VERTEX_SHADER);
+    } else {
+        compileShaderHelper(vertexShaderPoints, vertexShaderPointsSource, GL_VERTEX_SHADER);
+        compileShaderHelper(vertexShaderLines, vertexShaderLinesSource, GL_VERTEX_SHADER);
+    }
     compileShaderHelper(uiVertexShader, uiVertexShaderSource, GL_VERTEX_SHADER);
 }
 
@@ -60,6 +90,10 @@ void ShaderManager::compileGeometryShaders() {
 
 void ShaderManager::compileComputeShaders() {
     compileShaderHelper(computeShader, computeShaderSource, GL_COMPUTE_SHADER);
+    compileShaderHelper(ftleComputeShader, ftleComputeShaderSource, GL_COMPUTE_SHADER);
+    compileShaderHelper(densityComputeShader, densityComputeShaderSource, GL_COMPUTE_SHADER);
+    compileShaderHelper(emitComputeShader, emitComputeShaderSource, GL_COMPUTE_SHADER);
+    compileShaderHelper(seedComputeShader, seedComputeShaderSource, GL_COMPUTE_SHADER);
 }
 
 // Helper function to create a shader program
@@ -76,6 +110,7 @@ void createProgramHelper(GLuint& program, GLuint shaders[]) {
 
     // Link the program
     glBindAttribLocation(program, 0, "vPosition");
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(program);
     glGetProgramiv(program, GL_LINK_STATUS, &linkSuccess);
 
@@ -87,31 +122,81 @@ void createProgramHelper(GLuint& program, GLuint shaders[]) {
 }
 
 void ShaderManager::createLinesProgram() {
-    createProgramHelper(shaderLinesProgram, (GLuint[]) {vertexShader, geometryLinesShader, fragmentShaderLines, 0});
+    if (renderPath == RenderPath::geometryShaders) {
+        createProgramHelper(shaderLinesProgram, (GLuint[]) {vertexShader, geometryLinesShader, fragmentShaderLines, 0});
+    } else {
+        createProgramHelper(shaderLinesProgram, (GLuint[]) {vertexShaderLines, fragmentShaderLines, 0});
+    }
 }
 
 void ShaderManager::createPointsProgram() {
-    createProgramHelper(shaderPointsProgram, (GLuint[]) {vertexShader, geometryPointsShader, fragmentShaderPoints, 0});
+    if (renderPath == RenderPath::geometryShaders) {
+        createProgramHelper(shaderPointsProgram, (GLuint[]) {vertexShader, geometryPointsShader, fragmentShaderPoints, 0});
+    } else {
+        createProgramHelper(shaderPointsProgram, (GLuint[]) {vertexShaderPoints, fragmentShaderPoints, 0});
+    }
 }
 
 void ShaderManager::createComputeProgram() {
     createProgramHelper(shaderComputeProgram, (GLuint[]) {computeShader, 0});
 }
 
+GLuint ShaderManager::createComputeProgramVariant(int localSizeX) {
+    std::string source = loadShaderFile("compute_shader.glsl");
+    injectDefines(source, computeShaderDefines(localSizeX));
+
+    GLuint shader, program;
+    std::string name = "compute_" + std::to_string(localSizeX) + ".bin";
+    uint64_t key = cacheKey({&source});
+    if (loadProgramBinary(program, name, key)) {
+        return program;
+    }
+    compileShaderHelper(shader, source, GL_COMPUTE_SHADER);
+    createProgramHelper(program, (GLuint[]) {shader, 0});
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+    saveProgramBinary(program, name, key);
+    return program;
+}
+
+void ShaderManager::createFTLEProgram() {
+    createProgramHelper(shaderFTLEProgram, (GLuint[]) {ftleComputeShader, 0});
+}
+
+void ShaderManager::createDensityProgram() {
+    createProgramHelper(shaderDensityProgram, (GLuint[]) {densityComputeShader, 0});
+}
+
+void ShaderManager::createEmitProgram() {
+    createProgramHelper(shaderEmitProgram, (GLuint[]) {emitComputeShader, 0});
+}
+
+void ShaderManager::createSeedProgram() {
+    createProgramHelper(shaderSeedProgram, (GLuint[]) {seedComputeShader, 0});
+}
+
 void ShaderManager::createUIProgram() {
     createProgramHelper(shaderUIProgram, (GLuint[]) {uiVertexShader, uiFragmentShader, 0});
 }
 
 void ShaderManager::detachShaders() {
-    glDetachShader(shaderLinesProgram, vertexShader);
-    glDetachShader(shaderLinesProgram, geometryLinesShader);
+    if (renderPath == RenderPath::geometryShaders) {
+        glDetachShader(shaderLinesProgram, vertexShader);
+        glDetachShader(shaderLinesProgram, geometryLinesShader);
+        glDetachShader(shaderPointsProgram, vertexShader);
+        glDetachShader(shaderPointsProgram, geometryPointsShader);
+    } else {
+        glDetachShader(shaderLinesProgram, vertexShaderLines);
+        glDetachShader(shaderPointsProgram, vertexShaderPoints);
+    }
     glDetachShader(shaderLinesProgram, fragmentShaderLines);
-
-    glDetachShader(shaderPointsProgram, vertexShader);
-    glDetachShader(shaderPointsProgram, geometryPointsShader);
     glDetachShader(shaderPointsProgram, fragmentShaderPoints);
 
     glDetachShader(shaderComputeProgram, computeShader);
+    glDetachShader(shaderFTLEProgram, ftleComputeShader);
+    glDetachShader(shaderDensityProgram, densityComputeShader);
+    glDetachShader(shaderEmitProgram, emitComputeShader);
+    glDetachShader(shaderSeedProgram, seedComputeShader);
 
     glDetachShader(shaderUIProgram, uiVertexShader);
     glDetachShader(shaderUIProgram, uiFragmentShader);
@@ -120,11 +205,17 @@ void ShaderManager::detachShaders() {
 
 void ShaderManager::deleteShaders() {
     glDeleteShader(vertexShader);
+    glDeleteShader(vertexShaderPoints);
+    glDeleteShader(vertexShaderLines);
     glDeleteShader(geometryPointsShader);
     glDeleteShader(geometryLinesShader);
     glDeleteShader(fragmentShaderLines);
     glDeleteShader(fragmentShaderPoints);
     glDeleteShader(computeShader);
+    glDeleteShader(ftleComputeShader);
+    glDeleteShader(densityComputeShader);
+    glDeleteShader(emitComputeShader);
+    glDeleteShader(seedComputeShader);
     glDeleteShader(uiVertexShader);
     glDeleteShader(uiFragmentShader);
 }
@@ -133,12 +224,18 @@ void ShaderManager::deleteShaders() {
 void ShaderManager::compileAndLinkShaders() {
     compileVertexShaders();
     compileFragmentShaders();
-    compileGeometryShaders();
+    if (renderPath == RenderPath::geometryShaders) {
+        compileGeometryShaders();
+    }
     compileComputeShaders();
 
     createLinesProgram();
     createPointsProgram();
     createComputeProgram();
+    createFTLEProgram();
+    createDensityProgram();
+    createEmitProgram();
+    createSeedProgram();
     createUIProgram();
 
     detachShaders();
@@ -147,12 +244,22 @@ void ShaderManager::compileAndLinkShaders() {
 
 
 void ShaderManager::loadShaderSources() {
-    vertexShaderSource = loadShaderFile("vertex_shader.glsl");
+    if (renderPath == RenderPath::geometryShaders) {
+        vertexShaderSource = loadShaderFile("vertex_shader.glsl");
+        geometryLinesShaderSource = loadShaderFile("geometry_lines_shader.glsl");
+        geometryPointsShaderSource = loadShaderFile("geometry_points_shader.glsl");
+    } else {
+        vertexShaderPointsSource = loadShaderFile("vertex_shader_points.glsl");
+        vertexShaderLinesSource = loadShaderFile("vertex_shader_lines.glsl");
+    }
     fragmentShaderLinesSource = loadShaderFile("fragment_shader_lines.glsl");
     fragmentShaderPointsSource = loadShaderFile("fragment_shader_points.glsl");
-    geometryLinesShaderSource = loadShaderFile("geometry_lines_shader.glsl");
-    geometryPointsShaderSource = loadShaderFile("geometry_points_shader.glsl");
     computeShaderSource = loadShaderFile("compute_shader.glsl");
+    injectDefines(computeShaderSource, computeShaderDefines(DEFAULT_LOCAL_SIZE));
+    ftleComputeShaderSource = loadShaderFile("ftle_compute_shader.glsl");
+    densityComputeShaderSource = loadShaderFile("density_compute_shader.glsl");
+    emitComputeShaderSource = loadShaderFile("emit_compute_shader.glsl");
+    seedComputeShaderSource = loadShaderFile("seed_compute_shader.glsl");
     uiVertexShaderSource = loadShaderFile("vertex_shader_ui.glsl");
     uiFragmentShaderSource = loadShaderFile("fragment_shader_ui.glsl");
 }
@@ -185,18 +292,160 @@ void ShaderManager::checkShaderProgramLinkStatus() {
 
 void ShaderManager::cleanShaderSources() {
     vertexShaderSource.clear();
+    vertexShaderPointsSource.clear();
+    vertexShaderLinesSource.clear();
     fragmentShaderLinesSource.clear();
     fragmentShaderPointsSource.clear();
     geometryLinesShaderSource.clear();
     geometryPointsShaderSource.clear();
     computeShaderSource.clear();
+    ftleComputeShaderSource.clear();
+    densityComputeShaderSource.clear();
+    emitComputeShaderSource.clear();
+    seedComputeShaderSource.clear();
     uiVertexShaderSource.clear();
     uiFragmentShaderSource.clear();
 }
 
+std::vector<ShaderManager::CachedProgram> ShaderManager::cachedPrograms() {
+    std::vector<const std::string*> linesSources = {&vertexShaderLinesSource, &fragmentShaderLinesSource};
+    std::vector<const std::string*> pointsSources = {&vertexShaderPointsSource, &fragmentShaderPointsSource};
+    if (renderPath == RenderPath::geometryShaders) {
+        linesSources = {&vertexShaderSource, &geometryLinesShaderSource, &fragmentShaderLinesSource};
+        pointsSources = {&vertexShaderSource, &geometryPointsShaderSource, &fragmentShaderPointsSource};
+    }
+    return {
+        {"lines.bin", &shaderLinesProgram, linesSources},
+        {"points.bin", &shaderPointsProgram, pointsSources},
+        {"compute.bin", &shaderComputeProgram, {&computeShaderSource}},
+        {"ftle.bin", &shaderFTLEProgram, {&ftleComputeShaderSource}},
+        {"density.bin", &shaderDensityProgram, {&densityComputeShaderSource}},
+        {"emit.bin", &shaderEmitProgram, {&emitComputeShaderSource}},
+        {"seed.bin", &shaderSeedProgram, {&seedComputeShaderSource}},
+        {"ui.bin", &shaderUIProgram, {&uiVertexShaderSource, &uiFragmentShaderSource}},
+    };
+}
+
+uint64_t ShaderManager::cacheKey(const std::vector<const std::string*>& sources) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xff;  // Separator, so that moving text between sources changes the key
+        hash *= 1099511628211ull;
+    };
+    mix(driverVersion);
+    for (const std::string* source : sources) {
+        mix(*source);
+    }
+    return hash;
+}
+
+bool ShaderManager::loadProgramBinary(GLuint& program, const std::string& name, uint64_t key) {
+    if (cacheDir.empty()) return false;
+
+    std::ifstream file(cacheDir + "/" + name, std::ios::binary);
+    if (!file) return false;
+
+    // Layout: magic, key, binary format, binary length, binary
+    uint32_t magic = 0;
+    uint64_t fileKey = 0;
+    GLenum format = 0;
+    GLint length = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    file.read(reinterpret_cast<char*>(&length), sizeof(length));
+    if (!file || magic != CACHE_MAGIC || fileKey != key || length <= 0) return false;
+
+    std::vector<char> binary(length);
+    file.read(binary.data(), length);
+    if (!file) return false;
+
+    // The driver may still reject the binary, e.g., after an update that kept the version string
+    GLint linkSuccess = 0;
+    program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), length);
+    glGetProgramiv(program, GL_LINK_STATUS, &linkSuccess);
+    if (!linkSuccess) {
+        LOGI("shaderManager", "Cached program %s rejected by the driver", name.c_str());
+        glDeleteProgram(program);
+        program = 0;
+        while (glGetError() != GL_NO_ERROR) {}
+        return false;
+    }
+    return true;
+}
+
+void ShaderManager::saveProgramBinary(GLuint program, const std::string& name, uint64_t key) {
+    if (cacheDir.empty()) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    std::ofstream file(cacheDir + "/" + name, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        LOGE("shaderManager", "Failed to write cached program %s", name.c_str());
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(binary.data(), length);
+}
+
+bool ShaderManager::loadCachedPrograms() {
+    std::vector<CachedProgram> programs = cachedPrograms();
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (!loadProgramBinary(*programs[i].program, programs[i].name, cacheKey(programs[i].sources))) {
+            for (size_t j = 0; j < i; j++) {
+                glDeleteProgram(*programs[j].program);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShaderManager::saveCachedPrograms() {
+    for (const CachedProgram& cached : cachedPrograms()) {
+        saveProgramBinary(*cached.program, cached.name, cacheKey(cached.sources));
+    }
+}
+
 void ShaderManager::createShaderPrograms() {
     loadShaderSources();
-    compileAndLinkShaders();
+
+    // The binary cache needs at least one program binary format
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    if (numFormats == 0) {
+        cacheDir.clear();
+    } else if (!cacheDir.empty()) {
+        mkdir(cacheDir.c_str(), 0700);  // Fails harmlessly if it already exists
+    }
+    // Binaries are only valid for the driver that produced them
+    auto glString = [](GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? std::string((const char*) value) : std::string();
+    };
+    driverVersion = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+    // Compile from source only when any cached program is missing or invalid
+    if (loadCachedPrograms()) {
+        LOGI("shaderManager", "Shader programs loaded from the binary cache");
+    } else {
+        compileAndLinkShaders();
+        saveCachedPrograms();
+    }
     checkShaderProgramLinkStatus();
     cleanShaderSources();
 }
@@ -18,6 +18,7 @@ Transforms::Transforms() : scale(1.0f), rotation(glm::vec3(0.0f, 0.0f, 0.0f)) {
     setAspectRatio(0.5f);
 
     updateTransformations();
+    updateMVP();
 }
 
 
@@ -37,6 +38,12 @@ void Transforms::setAspectRatio(float aspectRatio) {
 }
 
 
+void Transforms::updateMVP() {
+    // The matrices are uploaded transposed, so the shaders' projection * view * model is the transpose of this product
+    std::lock_guard<std::mutex> lock(mtx);
+    mvpTransform = modelTransform * viewTransform * projectionTransform;
+}
+
 void Transforms::updateTransformations() {
     // Update model matrix
     glm::mat4 modelTransform = glm::identity<glm::mat4>();
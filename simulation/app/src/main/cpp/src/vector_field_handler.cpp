@@ -3,50 +3,75 @@
 //
 
 #include "include/vector_field_handler.h"
+#include "include/executor.h"
 
-VectorFieldHandler::VectorFieldHandler(int finenessX, int finenessY, int finenessZ, bool alt): finenessX(finenessX), finenessY(finenessY), finenessZ(finenessZ), alt(alt) {}
+#include <cmath>
+
+// Cells loaded around a window at either side, so that the sampler interpolates real data up to its border
+static const int WINDOW_HALO = 1;
+
+// Levels of the pyramid of every time step: the loaded grid, and 1/2 and 1/4 of its resolution along x and y
+static const int PYRAMID_LEVELS = 3;
+
+// Zoom at and above which the overlay is drawn from the loaded grid, every halving of it draws from the next level
+static const float PYRAMID_DETAIL_SCALE = 1.0f;
+
+// Cells of the loaded grid around the focus sampled at the full resolution, as many again are sampled at half of it
+static const float FOCUS_MARGIN = 8.0f;
+
+// Cells over which two adjacent levels are blended, centered on the distances `FOCUS_MARGIN` and `2 * FOCUS_MARGIN`
+static const float FOCUS_BLEND = 4.0f;
+
+VectorFieldHandler::VectorFieldHandler(int finenessX, int finenessY, int finenessZ, bool alt): finenessX(finenessX), finenessY(finenessY), finenessZ(finenessZ), alt(alt) {
+    // The third step is appended by the prefetch while the first two are in use, it must not reallocate them
+    allVertices.reserve(3);
+    displayVertices.reserve(3);
+    levelVelocities.reserve(3);
+    levelDisplayVertices.reserve(3);
+}
 
 void VectorFieldHandler::velocityField(const glm::vec3 &position, glm::vec3 &velocity) {
-    // Transform position [-1, 1] range to [0, adjWidth/adjHeight] grid indices as floating point
-    float fGridX = ((position.x / (float)FIELD_WIDTH + 1.0) / 2 * width);
-    float fGridY = ((position.y / (float)FIELD_HEIGHT + 1.0) / 2 * height);
-    float fGridZ = ((position.z / (float)FIELD_DEPTH + 1.0) / 2 * depth);
-
-    // Calculate base indices by casting to int
-    int baseGridX = (int)fGridX;
-    int baseGridY = (int)fGridY;
-    int baseGridZ = (int)fGridZ;
-
-    // Ensure base indices are within bounds
-    baseGridX = std::max(0, std::min(baseGridX, width - 2));
-    baseGridY = std::max(0, std::min(baseGridY, height - 2));
-    baseGridZ = std::max(0, std::min(baseGridZ, depth - 2));
-
-    // Compute interpolation weights
-    float w_x = fGridX - baseGridX;
-    float w_y = fGridY - baseGridY;
-    float w_z = fGridZ - baseGridZ;
+    velocityField(position, velocity, global_time_in_step);
+}
+
+void VectorFieldHandler::velocityField(const glm::vec3 &position, glm::vec3 &velocity, float time) {
+    // Transform position [-1, 1] range to grid indices of the window as floating point
+    glm::vec3 fGrid = toGrid(position);
+
+    // Blend into the next coarser level over the transition band, so that the velocity is continuous around the focus
+    float level = samplingLevel(fGrid);
+    int coarse = (int) level;
+    float blend = level - (float) coarse;
+    velocity = sampleLevel(fGrid, coarse, time);
+    if (blend > 0.0f) {
+        velocity = glm::mix(velocity, sampleLevel(fGrid, coarse + 1, time), blend);
+    }
+}
+
+glm::vec3 VectorFieldHandler::sampleGrid(const glm::vec3& fGrid, float time) {
+    // Corner indices within bounds (wrapped on periodic axes) and interpolation weights
+    int baseGridX, baseGridY, baseGridZ;
+    int nextGridX, nextGridY, nextGridZ;
+    float w_x = cornerCells(0, fGrid.x, width, baseGridX, nextGridX);
+    float w_y = cornerCells(1, fGrid.y, height, baseGridY, nextGridY);
+    float w_z = cornerCells(2, fGrid.z, depth, baseGridZ, nextGridZ);
 
     // Helper function to calculate velocity vector at a given index
     auto getVelocity = [&](int x, int y, int z, int timeIndex) {
-        int idx = z * width * height + y * width + x;
-        float dx = allVertices[timeIndex][idx * 6 + 3] - allVertices[timeIndex][idx * 6];
-        float dy = allVertices[timeIndex][idx * 6 + 4] - allVertices[timeIndex][idx * 6 + 1];
-        float dz = allVertices[timeIndex][idx * 6 + 5] - allVertices[timeIndex][idx * 6 + 2];
-        return glm::vec3(dx, dy, dz);
+        return cellVelocity(timeIndex, x, y, z);
     };
 
     // Interpolate for each time index and then across time
     glm::vec3 interpolatedVelocity[2];
     for (int t = 0; t < 2; t++) {
-        glm::vec3 c000 = getVelocity(baseGridX,     baseGridY,     baseGridZ, t);
-        glm::vec3 c100 = getVelocity(baseGridX + 1, baseGridY,     baseGridZ, t);
-        glm::vec3 c010 = getVelocity(baseGridX,     baseGridY + 1, baseGridZ, t);
-        glm::vec3 c110 = getVelocity(baseGridX + 1, baseGridY + 1, baseGridZ, t);
-        glm::vec3 c001 = getVelocity(baseGridX,     baseGridY,     baseGridZ + 1, t);
-        glm::vec3 c101 = getVelocity(baseGridX + 1, baseGridY,     baseGridZ + 1, t);
-        glm::vec3 c011 = getVelocity(baseGridX,     baseGridY + 1, baseGridZ + 1, t);
-        glm::vec3 c111 = getVelocity(baseGridX + 1, baseGridY + 1, baseGridZ + 1, t);
+        glm::vec3 c000 = getVelocity(baseGridX, baseGridY, baseGridZ, t);
+        glm::vec3 c100 = getVelocity(nextGridX, baseGridY, baseGridZ, t);
+        glm::vec3 c010 = getVelocity(baseGridX, nextGridY, baseGridZ, t);
+        glm::vec3 c110 = getVelocity(nextGridX, nextGridY, baseGridZ, t);
+        glm::vec3 c001 = getVelocity(baseGridX, baseGridY, nextGridZ, t);
+        glm::vec3 c101 = getVelocity(nextGridX, baseGridY, nextGridZ, t);
+        glm::vec3 c011 = getVelocity(baseGridX, nextGridY, nextGridZ, t);
+        glm::vec3 c111 = getVelocity(nextGridX, nextGridY, nextGridZ, t);
 
         glm::vec3 c00 = glm::mix(c000, c100, w_x);
         glm::vec3 c01 = glm::mix(c001, c101, w_x);
@@ -59,15 +84,62 @@ void VectorFieldHandler::velocityField(const glm::vec3 &position, glm::vec3 &vel
         interpolatedVelocity[t] = glm::mix(c0, c1, w_z);
     }
 
-    velocity = glm::mix(interpolatedVelocity[0], interpolatedVelocity[1], global_time_in_step / (float)one_day_simulation_period);
+    return glm::mix(interpolatedVelocity[0], interpolatedVelocity[1], time / (float)one_day_simulation_period);
+}
+
+float VectorFieldHandler::samplingLevel(const glm::vec3& grid) {
+    if (!hasFocus || !focusSampling || numLevels < 2) return 0.0f;
+
+    // Distance along x and y from the focus, 0 inside of it
+    glm::vec2 position(grid);
+    float distance = glm::length(glm::max(focusLow - position, glm::vec2(0.0f)) + glm::max(position - focusHigh, glm::vec2(0.0f)));
+
+    // Every boundary adds one level, ramping linearly over the band around it
+    float level = 0.0f;
+    for (int boundary = 1; boundary < PYRAMID_LEVELS; boundary++) {
+        level += glm::clamp((distance - boundary * FOCUS_MARGIN) / FOCUS_BLEND + 0.5f, 0.0f, 1.0f);
+    }
+    return std::min(level, (float) (numLevels - 1));
+}
+
+glm::vec3 VectorFieldHandler::sampleLevel(const glm::vec3& grid, int level, float time) {
+    if (level == 0) return sampleGrid(grid, time);
+
+    // Cell i of the level averages the cells [i * factor, (i + 1) * factor) of the loaded grid, and lies at their center
+    float factor = (float) (1 << level);
+    glm::ivec3 size = levelSize(level);
+    glm::vec3 fGrid((grid.x - (factor - 1.0f) / 2.0f) / factor, (grid.y - (factor - 1.0f) / 2.0f) / factor, grid.z);
+
+    int baseGridX, baseGridY, baseGridZ;
+    int nextGridX, nextGridY, nextGridZ;
+    float w_x = cornerCells(0, fGrid.x, size.x, baseGridX, nextGridX);
+    float w_y = cornerCells(1, fGrid.y, size.y, baseGridY, nextGridY);
+    float w_z = cornerCells(2, fGrid.z, size.z, baseGridZ, nextGridZ);
+
+    auto getVelocity = [&](int x, int y, int z, int timeIndex) {
+        const float* velocity = &levelVelocities[timeIndex][level - 1][((size_t) (z * size.y + y) * size.x + x) * 3];
+        return glm::vec3(velocity[0], velocity[1], velocity[2]);
+    };
+
+    glm::vec3 interpolatedVelocity[2];
+    for (int t = 0; t < 2; t++) {
+        glm::vec3 c00 = glm::mix(getVelocity(baseGridX, baseGridY, baseGridZ, t), getVelocity(nextGridX, baseGridY, baseGridZ, t), w_x);
+        glm::vec3 c01 = glm::mix(getVelocity(baseGridX, baseGridY, nextGridZ, t), getVelocity(nextGridX, baseGridY, nextGridZ, t), w_x);
+        glm::vec3 c10 = glm::mix(getVelocity(baseGridX, nextGridY, baseGridZ, t), getVelocity(nextGridX, nextGridY, baseGridZ, t), w_x);
+        glm::vec3 c11 = glm::mix(getVelocity(baseGridX, nextGridY, nextGridZ, t), getVelocity(nextGridX, nextGridY, nextGridZ, t), w_x);
+        interpolatedVelocity[t] = glm::mix(glm::mix(c00, c10, w_y), glm::mix(c01, c11, w_y), w_z);
+    }
+    return glm::mix(interpolatedVelocity[0], interpolatedVelocity[1], time / (float)one_day_simulation_period);
 }
 
 //////////////////////////////// Maintain vector field max. magnitude ratios ////////////////////////////////
 void VectorFieldHandler::prepareVertexDataHelper(const std::vector<float>& uData, const std::vector<float>& vData, const std::vector<float>& wData) {
-    std::vector<float> vertices;
-    vertices.reserve(width * height * depth * 6);
-    std::vector<float> tempDisplayVertices;
-    tempDisplayVertices.reserve(getWidth() * getHeight() * getDepth() * 6);
+    // Decode straight into the recycled slot buffers
+    size_t slot = nextSlot();
+    std::vector<float>& vertices = allVertices[slot];
+    std::vector<float>& tempDisplayVertices = displayVertices[slot];
+    size_t vertexIndex = 0;
+    size_t displayIndex = 0;
 
     const float maxU = *std::max_element(uData.begin(), uData.end());
     const float minU = *std::min_element(uData.begin(), uData.end());
@@ -79,62 +151,68 @@ void VectorFieldHandler::prepareVertexDataHelper(const std::vector<float>& uData
     const float min = std::min({minU, minV, minW});
 
     for (int z = 0; z < depth; z++) {
+        Executor::yield();  // Let the frame's particle update run between layers
         for (int y = 0; y < height; y++) {
             for (int x = 0; x < width; x++) {
 
                 int index = z * width * height + y * width + x;
 
-                float normalizedX = FIELD_WIDTH*((x / (float)(width)) * 2 - 1);
-                float normalizedY = FIELD_HEIGHT*((y / (float)(height)) * 2 - 1);
-                float normalizedZ = FIELD_DEPTH*((z / (float)(depth)) * 2 - 1);
+                // Relative to the window, the halo lies outside of the simulated volume
+                float normalizedX = nodePositions[0][x];
+                float normalizedY = nodePositions[1][y];
+                float normalizedZ = nodePositions[2][z];
 
                 // Min-max normalization ([-1, 1]) while keeping magnitude ratios between components
                 float normalizedU = 2 * ((uData[index] - min) / (max - min)) - 1;
                 float normalizedV = 2 * ((vData[index] - min) / (max - min)) - 1;
                 float normalizedW = 2 * ((wData[index] - min) / (max - min)) - 1;
 
-
-                // Start point
-                vertices.push_back(normalizedX);
-                vertices.push_back(normalizedY);
-                vertices.push_back(normalizedZ);
-
-                // End point
-                vertices.push_back(normalizedX + normalizedU);
-                vertices.push_back(normalizedY + normalizedV);
-                vertices.push_back(normalizedZ + normalizedW);
-
-                // Display vertices are reduced
-                if (z % finenessZ != 0 || y % finenessY != 0 || x % finenessX != 0) continue;
-                tempDisplayVertices.push_back(normalizedX);
-                tempDisplayVertices.push_back(normalizedY);
-                tempDisplayVertices.push_back(normalizedZ);
+                // No-slip: land cells have zero velocity
+                float seaFactor = landMask.seaFactor(index);
+                normalizedU *= seaFactor;
+                normalizedV *= seaFactor;
+                normalizedW *= seaFactor;
+
+
+                if (sparse) {
+                    // Only the velocity, in the brick of the cell
+                    storeBrickCell(vertices, x, y, z, glm::vec3(normalizedU, normalizedV, normalizedW));
+                } else {
+                    // Start point
+                    vertices[vertexIndex++] = normalizedX;
+                    vertices[vertexIndex++] = normalizedY;
+                    vertices[vertexIndex++] = normalizedZ;
+
+                    // End point
+                    vertices[vertexIndex++] = normalizedX + normalizedU;
+                    vertices[vertexIndex++] = normalizedY + normalizedV;
+                    vertices[vertexIndex++] = normalizedZ + normalizedW;
+                }
+
+                // Display vertices are reduced, and the halo is not displayed
+                if (!isDisplayed(x, y, z)) continue;
+                tempDisplayVertices[displayIndex++] = normalizedX;
+                tempDisplayVertices[displayIndex++] = normalizedY;
+                tempDisplayVertices[displayIndex++] = normalizedZ;
 
                 float scaleFactor = 10.0f;
-                tempDisplayVertices.push_back(normalizedX + normalizedU*scaleFactor);
-                tempDisplayVertices.push_back(normalizedY + normalizedV*scaleFactor);
-                tempDisplayVertices.push_back(normalizedZ + normalizedW*scaleFactor);
+                tempDisplayVertices[displayIndex++] = normalizedX + normalizedU*scaleFactor;
+                tempDisplayVertices[displayIndex++] = normalizedY + normalizedV*scaleFactor;
+                tempDisplayVertices[displayIndex++] = normalizedZ + normalizedW*scaleFactor;
             }
         }
     }
 
-    // Put the newly created vertices in the correct place
-    if (allVertices.size() == 3) {
-        allVertices[2] = vertices;
-        displayVertices[2] = tempDisplayVertices;
-    } else {
-        LOGI("vector_field_handler", "Vertices not yet filled, pushing");
-        allVertices.push_back(vertices);
-        displayVertices.push_back(tempDisplayVertices);
-    }
 }
 
 //////////////////////////////// Alternative vector field scaling ////////////////////////////////
 void VectorFieldHandler::prepareVertexDataHelperAlt(const std::vector<float>& uData, const std::vector<float>& vData, const std::vector<float>& wData) {
-    std::vector<float> vertices;
-    vertices.reserve(width * height * depth * 6);
-    std::vector<float> tempDisplayVertices;
-    tempDisplayVertices.reserve(getWidth() * getHeight() * getDepth() * 6);
+    // Decode straight into the recycled slot buffers
+    size_t slot = nextSlot();
+    std::vector<float>& vertices = allVertices[slot];
+    std::vector<float>& tempDisplayVertices = displayVertices[slot];
+    size_t vertexIndex = 0;
+    size_t displayIndex = 0;
 
     const float maxU = *std::max_element(uData.begin(), uData.end());
     const float minU = *std::min_element(uData.begin(), uData.end());
@@ -144,14 +222,16 @@ void VectorFieldHandler::prepareVertexDataHelperAlt(const std::vector<float>& uD
     const float minW = *std::min_element(wData.begin(), wData.end());
 
     for (int z = 0; z < depth; z++) {
+        Executor::yield();  // Let the frame's particle update run between layers
         for (int y = 0; y < height; y++) {
             for (int x = 0; x < width; x++) {
 
                 int index = z * width * height + y * width + x;
 
-                float normalizedX = FIELD_WIDTH*((x / (float)(width)) * 2 - 1);
-                float normalizedY = FIELD_HEIGHT*((y / (float)(height)) * 2 - 1);
-                float normalizedZ = FIELD_DEPTH*((z / (float)(depth)) * 2 - 1);
+                // Relative to the window, the halo lies outside of the simulated volume
+                float normalizedX = nodePositions[0][x];
+                float normalizedY = nodePositions[1][y];
+                float normalizedZ = nodePositions[2][z];
 
 
                 float scaleFactor = 10.0f;
@@ -162,96 +242,461 @@ void VectorFieldHandler::prepareVertexDataHelperAlt(const std::vector<float>& uD
                 float normalizedW = 2 * ((wData[index] - minW) / (maxW - minW)) - 1;
                 normalizedW *= scaleFactor;
 
+                // No-slip: land cells have zero velocity
+                float seaFactor = landMask.seaFactor(index);
+                normalizedU *= seaFactor;
+                normalizedV *= seaFactor;
+                normalizedW *= seaFactor;
+
                 float endX = normalizedX + normalizedU;
                 float endY = normalizedY + normalizedV;
                 float endZ = normalizedZ + normalizedW;
 
-                // Start point
-                vertices.push_back(normalizedX);
-                vertices.push_back(normalizedY);
-                vertices.push_back(normalizedZ);
-
-                // End point
-                vertices.push_back(endX);
-                vertices.push_back(endY);
-                vertices.push_back(endZ);
-
-                // Display vertices are reduced
-                if (z % finenessZ != 0 || y % finenessY != 0 || x % finenessX != 0) continue;
-                tempDisplayVertices.push_back(normalizedX);
-                tempDisplayVertices.push_back(normalizedY);
-                tempDisplayVertices.push_back(normalizedZ);
-
-                tempDisplayVertices.push_back(endX);
-                tempDisplayVertices.push_back(endY);
-                tempDisplayVertices.push_back(endZ);
+                if (sparse) {
+                    // Only the velocity, in the brick of the cell
+                    storeBrickCell(vertices, x, y, z, glm::vec3(normalizedU, normalizedV, normalizedW));
+                } else {
+                    // Start point
+                    vertices[vertexIndex++] = normalizedX;
+                    vertices[vertexIndex++] = normalizedY;
+                    vertices[vertexIndex++] = normalizedZ;
+
+                    // End point
+                    vertices[vertexIndex++] = endX;
+                    vertices[vertexIndex++] = endY;
+                    vertices[vertexIndex++] = endZ;
+                }
+
+                // Display vertices are reduced, and the halo is not displayed
+                if (!isDisplayed(x, y, z)) continue;
+                tempDisplayVertices[displayIndex++] = normalizedX;
+                tempDisplayVertices[displayIndex++] = normalizedY;
+                tempDisplayVertices[displayIndex++] = normalizedZ;
+
+                tempDisplayVertices[displayIndex++] = endX;
+                tempDisplayVertices[displayIndex++] = endY;
+                tempDisplayVertices[displayIndex++] = endZ;
             }
         }
     }
 
-    // Put the newly created vertices in the correct place
-    if (allVertices.size() == 3) {
-        allVertices[2] = vertices;
-        displayVertices[2] = tempDisplayVertices;
-    } else {
-        LOGI("vector_field_handler", "Vertices not yet filled, pushing");
-        allVertices.push_back(vertices);
-        displayVertices.push_back(tempDisplayVertices);
+}
+
+size_t VectorFieldHandler::nextSlot() {
+    // The third slot holds the expired time step after `updateTimeStep`, its buffers are reused
+    if (allVertices.size() < 3) {
+        LOGI("vector_field_handler", "Vertices not yet filled, adding slot");
+        allVertices.emplace_back();
+        displayVertices.emplace_back();
+        levelVelocities.emplace_back(PYRAMID_LEVELS - 1);
+        levelDisplayVertices.emplace_back(PYRAMID_LEVELS - 1);
+    }
+    size_t slot = allVertices.size() - 1;
+
+    // Sizes only change with the grid, resizing to the same size does not allocate
+    glm::ivec3 count = displayCount;
+    size_t numDisplay = (size_t) ((count.x + finenessX - 1) / finenessX) * ((count.y + finenessY - 1) / finenessY) * ((count.z + finenessZ - 1) / finenessZ);
+    allVertices[slot].resize(sparse ? numBricks * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE * 3 : (size_t) width * height * depth * 6);
+    displayVertices[slot].resize(numDisplay * 6);
+    return slot;
+}
+
+void VectorFieldHandler::buildPyramid(size_t slot) {
+    float displayScale = alt ? 1.0f : 10.0f;  // Like the display vertices of the loaded grid
+    for (int level = 1; level < numLevels; level++) {
+        glm::ivec3 below = levelSize(level - 1);
+        glm::ivec3 size = levelSize(level);
+        std::vector<float>& velocities = levelVelocities[slot][level - 1];
+        std::vector<float>& display = levelDisplayVertices[slot][level - 1];
+        velocities.resize((size_t) size.x * size.y * size.z * 3);
+        display.clear();  // Keeps its capacity, the number of lines only changes with the grid
+
+        int factor = 1 << level;
+        for (int z = 0; z < size.z; z++) {
+            Executor::yield();  // Let the frame's particle update run between layers
+            for (int y = 0; y < size.y; y++) {
+                for (int x = 0; x < size.x; x++) {
+                    // Reduce the 2 x 2 cells of the level below, fewer at the upper borders
+                    glm::vec3 sum(0.0f);
+                    int cells = 0;
+                    for (int belowY = 2 * y; belowY < std::min(2 * y + 2, below.y); belowY++) {
+                        for (int belowX = 2 * x; belowX < std::min(2 * x + 2, below.x); belowX++) {
+                            size_t index = (size_t) (z * below.y + belowY) * below.x + belowX;
+                            if (level == 1) {
+                                sum += cellVelocity(slot, belowX, belowY, z);
+                            } else {
+                                const float* velocity = &levelVelocities[slot][level - 2][index * 3];
+                                sum += glm::vec3(velocity[0], velocity[1], velocity[2]);
+                            }
+                            cells++;
+                        }
+                    }
+                    glm::vec3 velocity = sum / (float) cells;
+                    size_t index = ((size_t) (z * size.y + y) * size.x + x) * 3;
+                    velocities[index] = velocity.x;
+                    velocities[index + 1] = velocity.y;
+                    velocities[index + 2] = velocity.z;
+
+                    // Displayed where the center of the cell lies in the window, on the reduced display grid
+                    glm::vec3 center(x * factor + (factor - 1) / 2.0f, y * factor + (factor - 1) / 2.0f, (float) z);
+                    glm::vec3 relative(axes[0].toPosition(center.x), axes[1].toPosition(center.y), axes[2].toPosition(center.z));
+                    if (relative.x < 0.0f || relative.x >= 1.0f || relative.y < 0.0f || relative.y >= 1.0f ||
+                        z < displayFirst.z || z >= displayFirst.z + displayCount.z ||
+                        x % finenessX != 0 || y % finenessY != 0 || (z - displayFirst.z) % finenessZ != 0) {
+                        continue;
+                    }
+                    glm::vec3 start = (relative * 2.0f - 1.0f) * glm::vec3(FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH);
+                    glm::vec3 end = start + velocity * displayScale;
+                    display.insert(display.end(), {start.x, start.y, start.z, end.x, end.y, end.z});
+                }
+            }
+        }
     }
 }
 
+int VectorFieldHandler::displayLevel(float scale) {
+    int level = scale > 0.0f ? (int) std::floor(std::log2(PYRAMID_DETAIL_SCALE / scale)) : numLevels - 1;
+    return std::clamp(level, 0, numLevels - 1);
+}
+
 void VectorFieldHandler::prepareVertexData(const std::vector<float>& uData, const std::vector<float>& vData, const std::vector<float>& wData) {
     if (alt) {
         prepareVertexDataHelperAlt(uData, vData, wData);
     } else {
         prepareVertexDataHelper(uData, vData, wData);
     }
+    buildPyramid(allVertices.size() - 1);
+}
+
+void VectorFieldHandler::setWindow(const FieldWindow& window) {
+    requestedWindow = window;
+    landMask.reset();  // Rebuilt for the new window by the next load
+    LOGI("vector_field_handler", "Loading window %s", window.describe().c_str());
+}
+
+void VectorFieldHandler::setFocus(const FieldWindow& focus) {
+    requestedFocus = focus;
+    LOGI("vector_field_handler", "Sampling at the full resolution around %s", focus.describe().c_str());
+}
+
+void VectorFieldHandler::setFocusSampling(bool enabled) {
+    if (enabled == focusSampling) return;
+    focusSampling = enabled;
+    if (!requestedFocus.isFull()) {
+        LOGI("vector_field_handler", "%s", enabled ? "Sampling away from the focus on the coarser levels" : "Ignoring the focus, sampling at the full resolution everywhere");
+    }
+}
+
+void VectorFieldHandler::setSparse(bool sparse) {
+    this->sparse = sparse;
+    landMask.reset();  // The bricks are built with the mask by the next load
+    LOGI("vector_field_handler", "Storing the field %s", sparse ? "in bricks of sea cells" : "densely");
+}
+
+void VectorFieldHandler::buildBricks() {
+    brickCount = (glm::ivec3(width, height, depth) + BRICK_SIZE - 1) / BRICK_SIZE;
+    brickTable.assign((size_t) brickCount.x * brickCount.y * brickCount.z, -1);
+    numBricks = 0;
+
+    // A brick is stored if any of its cells is sea, the mask stays the same for all time steps
+    for (int brickZ = 0; brickZ < brickCount.z; brickZ++) {
+        for (int brickY = 0; brickY < brickCount.y; brickY++) {
+            for (int brickX = 0; brickX < brickCount.x; brickX++) {
+                bool sea = false;
+                for (int z = brickZ * BRICK_SIZE; z < std::min((brickZ + 1) * BRICK_SIZE, depth) && !sea; z++) {
+                    for (int y = brickY * BRICK_SIZE; y < std::min((brickY + 1) * BRICK_SIZE, height) && !sea; y++) {
+                        for (int x = brickX * BRICK_SIZE; x < std::min((brickX + 1) * BRICK_SIZE, width) && !sea; x++) {
+                            sea = landMask.seaFactor(z * width * height + y * width + x) > 0.0f;
+                        }
+                    }
+                }
+                if (sea) {
+                    brickTable[((size_t) brickZ * brickCount.y + brickY) * brickCount.x + brickX] = (int32_t) numBricks++;
+                }
+            }
+        }
+    }
+    size_t denseBytes = (size_t) width * height * depth * 6 * sizeof(float);
+    size_t sparseBytes = numBricks * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE * 3 * sizeof(float) + brickTable.size() * sizeof(int32_t);
+    LOGI("vector_field_handler", "%zu of %zu bricks hold sea, a time step takes %.1f MB instead of %.1f MB", numBricks, brickTable.size(),
+         sparseBytes / (1024.0f * 1024.0f), denseBytes / (1024.0f * 1024.0f));
+}
+
+void VectorFieldHandler::setDecimation(Decimation decimation, int stride) {
+    this->decimation = decimation;
+    requestedStride = std::max(stride, 1);
+    landMask.reset();  // Rebuilt for the new grid by the next load
+    LOGI("vector_field_handler", "Loading every %s of %d x %d cells", decimation == Decimation::average ? "mean" : "first", requestedStride, requestedStride);
+}
+
+void VectorFieldHandler::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    landMask.reset();
+    LOGI("vector_field_handler", "Memory budget of the time steps %.1f MB", bytes / (1024.0f * 1024.0f));
+}
+
+void VectorFieldHandler::setGridCoordinates(bool use) {
+    gridCoordinates = use;
+    landMask.reset();  // The axes are built with the mask by the next load
+    LOGI("vector_field_handler", "Mapping the grid %s", use ? "through the coordinates of the dataset" : "linearly");
+}
+
+void VectorFieldHandler::setDomainBoundaries(const DomainBoundaries& boundaries) {
+    wrap = glm::ivec3(boundaries.isPeriodic(0), boundaries.isPeriodic(1), boundaries.isPeriodic(2));
+    landMask.reset();  // The mask wraps like the sampling, rebuilt by the next load
+    LOGI("vector_field_handler", "Domain boundaries %s", boundaries.describe().c_str());
+}
+
+void VectorFieldHandler::buildAxes(const netCDF::NcFile& file, const glm::ivec3& readStart, const glm::ivec3& readCount) {
+    static const char* names[3] = {"lon", "lat", "depth"};
+    const float fieldExtent[3] = {FIELD_WIDTH, FIELD_HEIGHT, FIELD_DEPTH};
+    const int axisStride[3] = {stride, stride, 1};
+    const int gridSize[3] = {width, height, depth};
+    std::vector<float> coordinates;
+    for (int axis = 0; axis < 3; axis++) {
+        if (gridCoordinates && readCoordinates(file, names[axis], readStart[axis], readCount[axis], axisStride[axis], coordinates)) {
+            axes[axis].build(coordinates, gridOrigin[axis], gridExtent[axis]);
+        } else {
+            axes[axis].setUniform(gridOrigin[axis], gridExtent[axis]);
+        }
+        if (!axes[axis].isUniform()) {
+            LOGI("vector_field_handler", "Stretched %s axis, %d nodes looked up through %d bins", names[axis],
+                 axes[axis].getNumNodes(), axes[axis].getNumBins());
+        }
+
+        // The display vertices of all time steps start at the nodes
+        nodePositions[axis].resize(gridSize[axis]);
+        for (int i = 0; i < gridSize[axis]; i++) {
+            nodePositions[axis][i] = fieldExtent[axis] * (axes[axis].toPosition((float) i) * 2 - 1);
+        }
+    }
+}
+
+bool VectorFieldHandler::readCoordinates(const netCDF::NcFile& file, const std::string& name, int readStart, int readCount, int axisStride, std::vector<float>& coordinates) {
+    netCDF::NcVar variable = file.getVar(name);
+    if (variable.isNull() || variable.getDimCount() != 1) return false;
+
+    std::vector<float> values(readCount);
+    variable.getVar({(size_t) readStart}, {(size_t) readCount}, values.data());
+
+    // Like the data, every n-th node or the mean of every block
+    int numNodes = (readCount + axisStride - 1) / axisStride;
+    coordinates.resize(numNodes);
+    for (int node = 0; node < numNodes; node++) {
+        int first = node * axisStride;
+        if (decimation == Decimation::average) {
+            int end = std::min(first + axisStride, readCount);
+            float sum = 0.0f;
+            for (int i = first; i < end; i++) sum += values[i];
+            coordinates[node] = sum / (float) (end - first);
+        } else {
+            coordinates[node] = values[first];
+        }
+    }
+    return true;
+}
+
+size_t VectorFieldHandler::residentBytes(const glm::ivec3& readCount, int stride) {
+    size_t gridCells = (size_t) ((readCount.x + stride - 1) / stride) * ((readCount.y + stride - 1) / stride) * readCount.z;
+    size_t windowCells = (size_t) ((window.count.x + stride - 1) / stride) * ((window.count.y + stride - 1) / stride) * window.count.z;
+    size_t displayCells = windowCells / ((size_t) finenessX * finenessY * finenessZ);
+
+    // Three slots of all and display vertices, the interpolated display vertices, and the u, v, and w buffers
+    size_t floats = 3 * gridCells * 6 + 4 * displayCells * 6 + 3 * gridCells;
+
+    // The coarser levels of the pyramid of every slot
+    floats += 3 * (gridCells / 4 + gridCells / 16) * 3 + 3 * (displayCells / 4 + displayCells / 16) * 6;
+    if (decimation == Decimation::average) floats += (size_t) stride * readCount.x;
+    return floats * sizeof(float) + gridCells;  // One byte per cell of the land mask
+}
+
+int VectorFieldHandler::chooseStride(const glm::ivec3& readCount) {
+    if (memoryBudget == 0) return requestedStride;
+
+    // Coarsen until the budget fits, but keep two cells per axis for the sampler
+    int maxStride = std::max(std::max(readCount.x, readCount.y) / 2, 1);
+    int chosen = requestedStride;
+    while (chosen < maxStride && residentBytes(readCount, chosen) > memoryBudget) {
+        chosen++;
+    }
+    if (residentBytes(readCount, chosen) > memoryBudget) {
+        LOGE("vector_field_handler", "No stride fits the memory budget of %zu bytes, loading the coarsest", memoryBudget);
+    }
+    return chosen;
+}
+
+void VectorFieldHandler::readAveraged(const netCDF::NcVar& variable, const glm::ivec3& readStart, const glm::ivec3& readCount, float fillValue, std::vector<float>& data) {
+    int gridWidth = (readCount.x + stride - 1) / stride;
+    int gridHeight = (readCount.y + stride - 1) / stride;
+    for (int z = 0; z < readCount.z; z++) {
+        Executor::yield();  // Let the frame's particle update run between layers
+        for (int blockY = 0; blockY < gridHeight; blockY++) {
+            int rows = std::min(stride, readCount.y - blockY * stride);
+            std::vector<size_t> startp = {0, (size_t) (readStart.z + z), (size_t) (readStart.y + blockY * stride), (size_t) readStart.x};
+            std::vector<size_t> countp = {1, 1, (size_t) rows, (size_t) readCount.x};
+            blockBuffer.resize((size_t) rows * readCount.x);
+            variable.getVar(startp, countp, blockBuffer.data());
+
+            for (int blockX = 0; blockX < gridWidth; blockX++) {
+                int columns = std::min(stride, readCount.x - blockX * stride);
+                float sum = 0.0f;
+                int sea = 0;
+                for (int row = 0; row < rows; row++) {
+                    for (int column = 0; column < columns; column++) {
+                        float value = blockBuffer[(size_t) row * readCount.x + blockX * stride + column];
+                        if (LandMask::isFill(value, fillValue)) continue;
+                        sum += value;
+                        sea++;
+                    }
+                }
+                data[((size_t) z * gridHeight + blockY) * gridWidth + blockX] = sea > 0 ? sum / sea : fillValue;
+            }
+        }
+    }
+}
+
+void VectorFieldHandler::clearTimeSteps() {
+    // The outer vectors keep their capacity of three slots, so that the prefetch never reallocates them
+    allVertices.clear();
+    displayVertices.clear();
+    levelVelocities.clear();
+    levelDisplayVertices.clear();
 }
 
 void VectorFieldHandler::updateTimeStep() {
     if (allVertices.size() > 2) {
         std::swap(allVertices[0], allVertices[1]);
         std::swap(displayVertices[0], displayVertices[1]);
+        std::swap(levelVelocities[0], levelVelocities[1]);
+        std::swap(levelDisplayVertices[0], levelDisplayVertices[1]);
         std::swap(allVertices[1], allVertices[2]);
         std::swap(displayVertices[1], displayVertices[2]);
+        std::swap(levelVelocities[1], levelVelocities[2]);
+        std::swap(levelDisplayVertices[1], levelDisplayVertices[2]);
     } else if (allVertices.size() > 1) {
         std::swap(allVertices[0], allVertices[1]);
         std::swap(displayVertices[0], displayVertices[1]);
+        std::swap(levelVelocities[0], levelVelocities[1]);
+        std::swap(levelDisplayVertices[0], levelDisplayVertices[1]);
 
     }
 }
 
-void VectorFieldHandler::loadTimeStepHelper(const std::string& fileUPath, const std::string& fileVPath, const std::string& fileWPath) {
+void VectorFieldHandler::loadTimeStepHelper(const std::string& fileUPath, const std::string& fileVPath, const std::string& fileWPath, bool removeFiles) {
     netCDF::NcFile dataFileU(fileUPath, netCDF::NcFile::read);
     netCDF::NcFile dataFileV(fileVPath, netCDF::NcFile::read);
     netCDF::NcFile dataFileW(fileWPath, netCDF::NcFile::read);
 
-    // Define the start and count vectors for the data in the file
-    std::vector<size_t> startp = {0, 0, 0, 0};  // Start index for time, depth, y, x
-    std::vector<size_t> countp = {1, dataFileU.getDim("depth").getSize(), dataFileU.getDim("lat").getSize(), dataFileU.getDim("lon").getSize()};  // Read one time step, all depths, all y, all x
-    std::vector<float> uData( countp[1] * countp[2] * countp[3]), vData(countp[1] * countp[2] * countp[3]), wData(countp[1] * countp[2] * countp[3]);
+    // Read the window of one time step and its halo
+    datasetSize = glm::ivec3(dataFileU.getDim("lon").getSize(), dataFileU.getDim("lat").getSize(), dataFileU.getDim("depth").getSize());
+    window = requestedWindow.resolve(datasetSize);
+    for (int axis = 0; axis < 3; axis++) {
+        if (wrap[axis] && window.count[axis] < datasetSize[axis]) {
+            LOGE("vector_field_handler", "Periodic axis %d is windowed, the sampling wraps the window instead of the dataset", axis);
+        }
+    }
+    glm::ivec3 haloLow = glm::ivec3(std::min(WINDOW_HALO, window.start.x), std::min(WINDOW_HALO, window.start.y), std::min(WINDOW_HALO, window.start.z));
+    glm::ivec3 haloHigh = glm::min(glm::ivec3(WINDOW_HALO), datasetSize - window.start - window.count);
+    int previousStride = stride;
+    stride = chooseStride(window.count + haloLow + haloHigh);
+
+    // The halo is one cell of the decimated grid, where the dataset has it
+    glm::ivec3 cellStride(stride, stride, 1);
+    haloLow = glm::min(haloLow * cellStride, window.start);
+    haloHigh = glm::min(haloHigh * cellStride, datasetSize - window.start - window.count);
+    glm::ivec3 readStart = window.start - haloLow;
+    glm::ivec3 readCount = window.count + haloLow + haloHigh;
 
     // Prepare vertex data for OpenGL from uData and vData, and store in allVertices[i]
-    width = countp[3];
-    height = countp[2];
-    depth = countp[1];
+    int previousWidth = width;
+    int previousHeight = height;
+    width = (readCount.x + stride - 1) / stride;
+    height = (readCount.y + stride - 1) / stride;
+    depth = readCount.z;
+    size_t numCells = (size_t) width * height * depth;
+    uBuffer.resize(numCells);
+    vBuffer.resize(numCells);
+    wBuffer.resize(numCells);
+
+    // Cell c of the dataset lies at (c - readStart - offset) / stride of the loaded grid, the mean of a block lies at its center
+    glm::vec3 offset = decimation == Decimation::average ? glm::vec3(cellStride - 1) / 2.0f : glm::vec3(0.0f);
+    gridOrigin = (glm::vec3(window.start - readStart) - offset) / glm::vec3(cellStride);
+    gridExtent = glm::vec3(window.count) / glm::vec3(cellStride);
+    glm::ivec3 gridSize(width, height, depth);
+    for (int axis = 0; axis < 3; axis++) {
+        int first = std::clamp((int) std::ceil(gridOrigin[axis] - 1.0e-4f), 0, gridSize[axis]);
+        int end = std::clamp((int) std::ceil(gridOrigin[axis] + gridExtent[axis] - 1.0e-4f), first, gridSize[axis]);
+        displayFirst[axis] = first;
+        displayCount[axis] = end - first;
+    }
+    numLevels = 1;
+    while (numLevels < PYRAMID_LEVELS && levelSize(numLevels).x >= 2 && levelSize(numLevels).y >= 2) {
+        numLevels++;
+    }
+
+    // The focus in cells of the loaded grid
+    hasFocus = !requestedFocus.isFull();
+    if (hasFocus) {
+        FieldWindow focus = requestedFocus.resolve(datasetSize);
+        focusLow = glm::vec2((glm::vec3(focus.start - readStart) - offset) / glm::vec3(cellStride));
+        focusHigh = glm::vec2((glm::vec3(focus.start + focus.count - readStart) - offset) / glm::vec3(cellStride));
+    }
+    if (stride != previousStride || width != previousWidth || height != previousHeight) {
+        LOGI("vector_field_handler", "Field resolution %d x %d x %d (stride %d, %.1f MB resident)", width, height, depth, stride,
+             residentBytes(readCount, stride) / (1024.0f * 1024.0f));
+    }
+
+    // Land cells hold fill values
+    float fillValue = NC_FILL_FLOAT;
+    auto attributes = dataFileU.getVar("u").getAtts();
+    if (attributes.count("_FillValue")) {
+        attributes.at("_FillValue").getValues(&fillValue);
+    }
 
     // Read the data
-    dataFileU.getVar("u").getVar(startp, countp, uData.data());
-    dataFileV.getVar("v").getVar(startp, countp, vData.data());
-    dataFileW.getVar("w").getVar(startp, countp, wData.data());
+    if (decimation == Decimation::average && stride > 1) {
+        readAveraged(dataFileU.getVar("u"), readStart, readCount, fillValue, uBuffer);
+        readAveraged(dataFileV.getVar("v"), readStart, readCount, fillValue, vBuffer);
+        readAveraged(dataFileW.getVar("w"), readStart, readCount, fillValue, wBuffer);
+    } else {
+        // Define the start, count, and stride vectors for the data in the file
+        std::vector<size_t> startp = {0, (size_t) readStart.z, (size_t) readStart.y, (size_t) readStart.x};  // Start index for time, depth, y, x
+        std::vector<size_t> countp = {1, (size_t) depth, (size_t) height, (size_t) width};  // Read one time step
+        std::vector<ptrdiff_t> stridep = {1, 1, stride, stride};
+        dataFileU.getVar("u").getVar(startp, countp, stridep, uBuffer.data());
+        Executor::yield();
+        dataFileV.getVar("v").getVar(startp, countp, stridep, vBuffer.data());
+        Executor::yield();
+        dataFileW.getVar("w").getVar(startp, countp, stridep, wBuffer.data());
+        Executor::yield();
+    }
+
+    // Build the axes and the mask once and zero the land cells so they do not skew the normalization
+    if (!landMask.isBuilt()) {
+        buildAxes(dataFileU, readStart, readCount);
+        landMask.build(uBuffer, fillValue, width, height, depth, axes, wrap);
+        if (sparse) buildBricks();
+    }
+    for (auto* data : {&uBuffer, &vBuffer, &wBuffer}) {
+        for (auto& value : *data) {
+            if (LandMask::isFill(value, fillValue)) value = 0.0f;
+        }
+    }
 
-    prepareVertexData(uData, vData, wData);
+    prepareVertexData(uBuffer, vBuffer, wBuffer);
 
     // close the files
     dataFileU.close();
     dataFileV.close();
     dataFileW.close();
-    std::remove(fileUPath.c_str());
-    std::remove(fileVPath.c_str());
-    std::remove(fileWPath.c_str());
+    if (removeFiles) {
+        std::remove(fileUPath.c_str());
+        std::remove(fileVPath.c_str());
+        std::remove(fileWPath.c_str());
+    }
 }
 
+#if !HEADLESS
 void VectorFieldHandler::loadTimeStep(NetCDFReader& reader, int fdU, int fdV, int fdW) {
     std::string tempFileU = reader.writeTempFileFromFD(fdU, "tempU.nc");
     std::string tempFileV = reader.writeTempFileFromFD(fdV, "tempV.nc");
@@ -265,14 +710,24 @@ void VectorFieldHandler::loadTimeStep(NetCDFReader& reader, int fdU, int fdV, in
 }
 
 void VectorFieldHandler::draw(Mainview& mainview) {
+    // Draw from the level of the pyramid matching the zoom
+    int level = displayLevel(mainview.getTransforms().getScale());
+    const std::vector<float>& previous = level == 0 ? displayVertices[0] : levelDisplayVertices[0][level - 1];
+    const std::vector<float>& next = level == 0 ? displayVertices[1] : levelDisplayVertices[1][level - 1];
+
     // Interpolate between the two time steps
-    // y = [0] + t / T * ([0]-[1])
-    std::vector<float> vertices(displayVertices[0].size());
-    for (int i = 0; i < displayVertices[0].size(); i++) {
-        vertices[i] = displayVertices[0][i] + global_time_in_step / (float) one_day_simulation_period * (displayVertices[1][i] - displayVertices[0][i]);
+    // y = [0] + t / T * ([0]-[1]), only for every `displayStride`-th line of 6 floats
+    size_t numLines = std::min(previous.size(), next.size()) / 6;
+    interpolatedVertices.resize((numLines + displayStride - 1) / displayStride * 6);
+    size_t k = 0;
+    for (size_t line = 0; line < numLines; line += displayStride) {
+        for (size_t i = line * 6; i < line * 6 + 6; i++) {
+            interpolatedVertices[k++] = previous[i] + global_time_in_step / (float) one_day_simulation_period * (next[i] - previous[i]);
+        }
     }
 
     // Load the data into the shader and draw
-    mainview.loadVectorFieldData(vertices);
-    mainview.drawVectorField(vertices.size());
-}
\ No newline at end of file
+    mainview.loadVectorFieldData(interpolatedVertices);
+    mainview.drawVectorField(interpolatedVertices.size());
+}
+#endif
@@ -0,0 +1,153 @@
+#include "include/cpu_topology.h"
+#include "include/executor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+// Tests `CpuTopology::discover` against faked sysfs CPU trees, and the chunking of the executor on top of it
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+// Helper class creating a faked sysfs CPU tree in a temporary directory, removed when it goes out of scope
+class FakeCpuTree {
+public:
+    FakeCpuTree() {
+        char pattern[] = "/tmp/cpu_topology_test_XXXXXX";
+        root = mkdtemp(pattern);
+    }
+
+    ~FakeCpuTree() {
+        std::filesystem::remove_all(root);
+    }
+
+    // Writes a file relative to the root, creating its directories
+    void write(const std::string& path, const std::string& content) {
+        std::filesystem::path file = std::filesystem::path(root) / path;
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file) << content << "\n";
+    }
+
+    // Adds a core with the given capacity, maximum frequency in kHz, and cluster, 0 leaves out a file
+    void addCore(int id, long capacity, long maxFrequency, int cluster) {
+        std::string cpu = "cpu" + std::to_string(id);
+        if (capacity > 0) write(cpu + "/cpu_capacity", std::to_string(capacity));
+        if (maxFrequency > 0) write(cpu + "/cpufreq/cpuinfo_max_freq", std::to_string(maxFrequency));
+        write(cpu + "/topology/cluster_id", std::to_string(cluster));
+    }
+
+    std::string root;
+};
+
+static bool near(float a, float b) {
+    return std::abs(a - b) < 1.0e-4f;
+}
+
+// big.LITTLE with capacities, the fast cores are listed last by the kernel
+static void testCapacities() {
+    FakeCpuTree tree;
+    tree.write("online", "0-7");
+    for (int id = 0; id < 4; id++) tree.addCore(id, 325, 1800000, 0);
+    for (int id = 4; id < 8; id++) tree.addCore(id, 1024, 2400000, 1);
+
+    CpuTopology topology = CpuTopology::discover(tree.root);
+    const std::vector<CpuTopology::Core>& cores = topology.getCores();
+    CHECK(cores.size() == 8);
+    if (cores.size() != 8) return;
+
+    // Fastest first, in the order of the ids within a speed
+    for (size_t i = 0; i < 4; i++) {
+        CHECK(cores[i].id == (int) i + 4);
+        CHECK(cores[i].capacity == 1024);
+        CHECK(cores[i].maxFrequency == 2400000);
+        CHECK(cores[i].cluster == 1);
+        CHECK(near(topology.getWeight(i), 1024.0f / 325.0f));
+    }
+    for (size_t i = 4; i < 8; i++) {
+        CHECK(cores[i].id == (int) i - 4);
+        CHECK(cores[i].cluster == 0);
+        CHECK(near(topology.getWeight(i), 1.0f));
+    }
+    CHECK(topology.isHeterogeneous());
+    CHECK(topology.describe() == "4x1024 (cluster 1), 4x325 (cluster 0)");
+
+    // Total capacity of 4 * 3.15 + 4 slow cores
+    Executor executor(topology);
+    CHECK(executor.getThreadCount() == 8);
+    CHECK(executor.getChunkCount() == 17);
+}
+
+// Older kernels without capacities, the maximum frequency decides, on a partially online CPU list
+static void testFrequencies() {
+    FakeCpuTree tree;
+    tree.write("online", "0-1,3");
+    tree.addCore(0, 0, 1000000, 0);
+    tree.addCore(1, 0, 1000000, 0);
+    tree.addCore(3, 0, 3000000, 1);
+
+    CpuTopology topology = CpuTopology::discover(tree.root);
+    const std::vector<CpuTopology::Core>& cores = topology.getCores();
+    CHECK(cores.size() == 3);
+    if (cores.size() != 3) return;
+
+    CHECK(cores[0].id == 3);
+    CHECK(cores[0].capacity == 0);
+    CHECK(near(topology.getWeight(0), 3.0f));
+    CHECK(near(topology.getWeight(2), 1.0f));
+
+    Executor executor(topology);
+    CHECK(executor.getChunkCount() == 5);
+}
+
+// Equal cores split into one chunk per worker, also when the speed is unknown
+static void testEqualCores() {
+    FakeCpuTree tree;
+    tree.write("online", "0-3");
+    for (int id = 0; id < 4; id++) tree.addCore(id, 0, 0, 0);
+
+    CpuTopology topology = CpuTopology::discover(tree.root);
+    CHECK(topology.getCores().size() == 4);
+    CHECK(!topology.isHeterogeneous());
+    for (size_t i = 0; i < topology.getCores().size(); i++) {
+        CHECK(near(topology.getWeight(i), 1.0f));
+    }
+
+    Executor executor(topology);
+    CHECK(executor.getChunkCount() == 4);
+}
+
+// A tree that cannot be read falls back to equal cores
+static void testMissingTree() {
+    FakeCpuTree tree;
+    CpuTopology topology = CpuTopology::discover(tree.root + "/missing");
+    size_t expected = std::max(std::thread::hardware_concurrency(), 1u);
+    CHECK(topology.getCores().size() == expected);
+    CHECK(!topology.isHeterogeneous());
+}
+
+int main() {
+    testCapacities();
+    testFrequencies();
+    testEqualCores();
+    testMissingTree();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All checks passed\n");
+    return EXIT_SUCCESS;
+}
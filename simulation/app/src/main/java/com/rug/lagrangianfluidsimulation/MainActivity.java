@@ -44,6 +44,7 @@ public class MainActivity extends Activity {
     public native void nativeSendTouchEvent(int pointerCount, float[] x, float[] y, int action);
     public native void onDestroyNative();
     public native void loadDeviceInfo(double aspectRatio);
+    public native void setMode(int mode);  // 0: sequential, 1: parallel, 2: compute shaders
 
     @Override
     protected void onCreate(Bundle savedInstanceState) {
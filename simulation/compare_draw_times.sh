@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Compares the draw times of the render paths in logs captured with capture_logs.sh, e.g., one run built with
+# USE_GEOMETRY_SHADERS=0 and one with USE_GEOMETRY_SHADERS=1. The Timer lines are grouped by the render path they name.
+
+if [[ $# -eq 0 ]]; then
+    echo "Usage: $0 <log file>..."
+    exit 1
+fi
+
+# Lines of the form "Timer : Elapsed time: 16.6 ms, draw time: 3.2 ms (vertex-stage MVP)"
+grep -hE 'Timer\s*: Elapsed time: [0-9.]+ ms, draw time: [0-9.]+ ms \(' "$@" | awk '
+{
+    match($0, /Elapsed time: [0-9.]+/)
+    elapsed = substr($0, RSTART + 14, RLENGTH - 14)
+    match($0, /draw time: [0-9.]+/)
+    draw = substr($0, RSTART + 11, RLENGTH - 11)
+    match($0, /\([^)]*\)$/)
+    path = substr($0, RSTART + 1, RLENGTH - 2)
+
+    if (!(path in count)) order[++numPaths] = path
+    count[path]++
+    elapsedSum[path] += elapsed
+    drawSum[path] += draw
+    drawSquaredSum[path] += draw * draw
+}
+END {
+    if (numPaths == 0) {
+        print "No draw times found, GL_EXT_disjoint_timer_query may not be supported by the device"
+        exit 1
+    }
+    printf "%-20s %8s %14s %14s %12s %10s\n", "render path", "samples", "elapsed (ms)", "draw (ms)", "stddev (ms)", "relative"
+    for (i = 1; i <= numPaths; i++) {
+        path = order[i]
+        mean = drawSum[path] / count[path]
+        variance = drawSquaredSum[path] / count[path] - mean * mean
+        stddev = variance > 0 ? sqrt(variance) : 0
+        if (i == 1) baseline = mean
+        relative = baseline > 0 ? mean / baseline : 0
+        printf "%-20s %8d %14.3f %14.3f %12.3f %9.2fx\n", path, count[path], elapsedSum[path] / count[path], mean, stddev, relative
+    }
+}'